@@ -1 +1 @@
-#include "buffer/buffer_pool_manager.h"namespace scudb {/* * BufferPoolManager Constructor * When log_manager is nullptr, logging is disabled (for test purpose) * WARNING: Do Not Edit This Function */    BufferPoolManager::BufferPoolManager(size_t pool_size,                                         DiskManager *disk_manager,                                         LogManager *log_manager)            : pool_size_(pool_size), disk_manager_(disk_manager),              log_manager_(log_manager) {        // a consecutive memory space for buffer pool        pages_ = new Page[pool_size_];        page_table_ = new ExtendibleHash<page_id_t, Page *>(BUCKET_SIZE);        replacer_ = new LRUReplacer<Page *>;        free_list_ = new std::list<Page *>;        // put all the pages into free list        for (size_t i = 0; i < pool_size_; ++i) {            free_list_->push_back(&pages_[i]);        }    }/* * BufferPoolManager Deconstructor * WARNING: Do Not Edit This Function */    BufferPoolManager::~BufferPoolManager() {        delete[] pages_;        delete page_table_;        delete replacer_;        delete free_list_;    }/* help function to get pointer of VictimPage * */    Page *BufferPoolManager::GetVictimPage() {        //获得VictimPage的Pointer，要么来自于free Page，要么来自于 lru换页后得到的        Page *target = nullptr;        if (free_list_->empty()) {            // to find a free page for replacement            //先考虑没有被            //那么如果            if (replacer_->Size() == 0) {                // to find an unpinned page for replacement                // LRU replacer也是空的                return nullptr;            } else {                //如果replacer中出来了，那么直接选出                replacer_->Victim(target);            }        } else {            //直接选空闲页            target = free_list_->front();            free_list_->pop_front();            assert(target->GetPageId() == INVALID_PAGE_ID);        }        assert(target->GetPinCount() == 0);        return target;    }/** * Fetch 取页 * 1. search hash table. *  1.1 if exist, pin the page and return immediately *  1.2 if no exist, find a replacement entry from either free list or lru *      replacer. (NOTE: always find from free list first) * 2. If the entry chosen for replacement is dirty, write it back to disk. * 3. Delete the entry for the old page from the hash table and insert an * entry for the new page. * 4. Update page metadata, read page content from disk file and return page * pointer */    Page *BufferPoolManager::FetchPage(page_id_t page_id) {        // 对整个buffer上锁        lock_guard<mutex> lck(latch_);        Page *targetPtr = nullptr;        //* 1. search hash table.        // *  1.1 if exist, pin the page and return immediately        if (page_table_->Find(page_id, targetPtr)) {            targetPtr->pin_count_++;            replacer_->Erase(targetPtr);            return targetPtr;        } else {            // *  1.2 if no exist, find a replacement entry from either free list or lru            // *      replacer. (NOTE: always find from free list first)            targetPtr = GetVictimPage();    //获得了avaliable frame page            if (targetPtr == nullptr) return targetPtr;            // * 2. If the entry chosen for replacement is dirty, write it back to disk.            if (targetPtr->is_dirty_) {                disk_manager_->WritePage(targetPtr->GetPageId(), targetPtr->data_);            }            // * 3. Delete the entry for the old page from the hash table and insert an            // * entry for the new page.            page_table_->Remove(targetPtr->GetPageId());            page_table_->Insert(page_id, targetPtr);            // * 4. Update page metadata, read page content from disk file and return page            // * pointer            disk_manager_->ReadPage(page_id, targetPtr->data_);            targetPtr->pin_count_ = 1;            targetPtr->is_dirty_ = false;            targetPtr->page_id_ = page_id;        }        return targetPtr;    }/* * Implementation of unpin page * if pin_count>0, decrement it and if it becomes zero, put it back to * replacer if pin_count<=0 before this call, return false. is_dirty: set the * dirty flag of this page */    bool BufferPoolManager::UnpinPage(page_id_t page_id, bool is_dirty) {        lock_guard<mutex> lck(latch_);        Page *targetPtr = nullptr;        page_table_->Find(page_id, targetPtr);        //是否找到        if (targetPtr == nullptr) {            return false;        } else {            targetPtr->is_dirty_ = is_dirty;            if (targetPtr->GetPinCount() <= 0) {                return false;            }            targetPtr->pin_count_--;            if (targetPtr->pin_count_ == 0) {                replacer_->Insert(targetPtr);            }            return true;        }    }/* * Used to flush a particular page of the buffer pool to disk. Should call the * write_page method of the disk manager * if page is not found in page table, return false * NOTE: make sure page_id != INVALID_PAGE_ID */    bool BufferPoolManager::FlushPage(page_id_t page_id) {        // * Used to flush a particular page of the buffer pool to disk. Should call the        lock_guard<mutex> lck(latch_);        Page *targetPtr = nullptr;        page_table_->Find(page_id, targetPtr);        if (targetPtr == nullptr || targetPtr->page_id_ == INVALID_PAGE_ID) {            // * if page is not found in page table, return false            // * NOTE: make sure page_id != INVALID_PAGE_ID            return false;        } else {            // * write_page method of the disk manager            if (targetPtr->is_dirty_) {                disk_manager_->WritePage(page_id, targetPtr->GetData());                targetPtr->is_dirty_ = false;            }        }        return true;    }/** * User should call this method for deleting a page. This routine will call * disk manager to deallocate the page. * First, if page is found within page table, * buffer pool manager should be reponsible for removing this entry out * of page table, reseting page metadata and adding back to free list. Second, * call disk manager's DeallocatePage() method to delete from disk file. If * the page is found within page table, but pin_count != 0, return false */    bool BufferPoolManager::DeletePage(page_id_t page_id) {        lock_guard<mutex> lck(latch_);        Page *targetPtr = nullptr;        page_table_->Find(page_id, targetPtr);        if (targetPtr != nullptr) {            //如果在页表中，removing this entry out of page table,            // reseting page metadata and adding back to free list.            if (targetPtr->GetPinCount() > 0) {                return false;            }            replacer_->Erase(targetPtr);            page_table_->Remove(page_id);            targetPtr->is_dirty_ = false;            targetPtr->ResetMemory();            free_list_->push_back(targetPtr);        }        disk_manager_->DeallocatePage(page_id);        return true;    }/** * User should call this method if needs to create a new page. This routine * will call disk manager to allocate a page. * Buffer pool manager should be responsible to choose a victim page either * from free list or lru replacer(NOTE: always choose from free list first), * update new page's metadata, zero out memory and add corresponding entry * into page table. return nullptr if all the pages in pool are pinned */    Page *BufferPoolManager::NewPage(page_id_t &page_id) {        lock_guard<mutex> lck(latch_);        Page *targetPtr = nullptr;        targetPtr = GetVictimPage();        if (targetPtr == nullptr) {            return nullptr;        }        page_id = disk_manager_->AllocatePage();        if (targetPtr->is_dirty_) {            disk_manager_->WritePage(targetPtr->GetPageId(), targetPtr->data_);        }        page_table_->Remove(targetPtr->GetPageId());        page_table_->Insert(page_id, targetPtr);        targetPtr->page_id_ = page_id;        targetPtr->ResetMemory();        targetPtr->is_dirty_ = false;        targetPtr->pin_count_ = 1;        return targetPtr;    }} // namespace scudb
\ No newline at end of file
+#include "buffer/buffer_pool_manager.h"#include "common/logger.h"namespace scudb {/* * BufferPoolManager Constructor * When log_manager is nullptr, logging is disabled (for test purpose) * Page memory lives in one zeroed array of frames that the pages point into, * and a read only database gets one lazily created descriptor per mapped page */    BufferPoolManager::BufferPoolManager(size_t pool_size,                                         DiskManager *disk_manager,                                         LogManager *log_manager)            : pool_size_(pool_size), disk_manager_(disk_manager),              log_manager_(log_manager) {        // a consecutive memory space for buffer pool        pages_ = new Page[pool_size_];        frames_ = new char[pool_size_ * PAGE_SIZE]();        page_table_ = new ExtendibleHash<page_id_t, Page *>(BUCKET_SIZE);        replacer_ = new LRUReplacer<Page *>;        free_list_ = new std::list<Page *>;        // put all the pages into free list        for (size_t i = 0; i < pool_size_; ++i) {            pages_[i].data_ = frames_ + i * PAGE_SIZE;            free_list_->push_back(&pages_[i]);        }        read_only_ = disk_manager_->IsReadOnly();        num_mapped_pages_ = read_only_ ? disk_manager_->GetNumMappedPages() : 0;        mapped_pages_ = new std::atomic<Page *>[num_mapped_pages_]();    }/* * BufferPoolManager Deconstructor */    BufferPoolManager::~BufferPoolManager() {        delete[] pages_;        delete[] frames_;        for (size_t i = 0; i < num_mapped_pages_; ++i) {            delete mapped_pages_[i].load();        }        delete[] mapped_pages_;        delete page_table_;        delete replacer_;        delete free_list_;    }/* help function to get pointer of VictimPage * The caller holds latch_ through lck, which is let go while the log is * flushed: the pool may have changed by the time a victim is returned */    Page *BufferPoolManager::GetVictimPage(unique_lock<mutex> &lck) {        //获得VictimPage的Pointer，要么来自于free Page，要么来自于 lru换页后得到的        Page *target = nullptr;        if (free_list_->empty()) {            // to find a free page for replacement            //先考虑没有被            //那么如果            if (replacer_->Size() == 0) {                // to find an unpinned page for replacement                // LRU replacer也是空的                return nullptr;            } else {                //如果replacer中出来了，那么直接选出                // write ahead logging: prefer a victim whose log records are                // already on disk. When there is none, flush the log without                // latch_, so that the rest of the pool is not held up by the                // log write, and look again                auto durable = [this](Page *const &page) {                    return IsLogDurable(page);                };                if (!replacer_->VictimIf(target, durable, VICTIM_SCAN_DEPTH)) {                    num_log_waits_++;                    lsn_t lsn = log_manager_->GetNextLSN() - 1;                    lck.unlock();                    log_manager_->ForceFlush(lsn);                    lck.lock();                    if (!free_list_->empty()) {                        target = free_list_->front();                        free_list_->pop_front();                        return target;                    }                    if (replacer_->Size() == 0) {                        return nullptr;                    }                    // dirtied again meanwhile, or the log failed: written                    // back below after a synchronous log flush                    if (!replacer_->VictimIf(target, durable,                                             VICTIM_SCAN_DEPTH)) {                        replacer_->Victim(target);                    }                }                num_evictions_++;            }        } else {            //直接选空闲页            target = free_list_->front();            free_list_->pop_front();            assert(target->GetPageId() == INVALID_PAGE_ID);        }        assert(target->GetPinCount() == 0);        return target;    }/** * Fetch 取页 * 1. search hash table. *  1.1 if exist, pin the page and return immediately *  1.2 if no exist, find a replacement entry from either free list or lru *      replacer. (NOTE: always find from free list first) * 2. If the entry chosen for replacement is dirty, write it back to disk. * 3. Delete the entry for the old page from the hash table and insert an * entry for the new page. * 4. Update page metadata, read page content from disk file and return page * pointer */    Page *BufferPoolManager::FetchPage(page_id_t page_id) {        if (read_only_) {            return FetchMappedPage(page_id);        }        // 对整个buffer上锁        unique_lock<mutex> lck(latch_);        Page *targetPtr = nullptr;        //* 1. search hash table.        // *  1.1 if exist, pin the page and return immediately        if (page_table_->Find(page_id, targetPtr)) {            targetPtr->pin_count_++;            replacer_->Erase(targetPtr);            TrackRecLSN(targetPtr);            return targetPtr;        } else {            // *  1.2 if no exist, find a replacement entry from either free list or lru            // *      replacer. (NOTE: always find from free list first)            targetPtr = GetVictimPage(lck);    //获得了avaliable frame page            if (targetPtr == nullptr) return targetPtr;            Page *loadedPtr = nullptr;            if (page_table_->Find(page_id, loadedPtr)) {                // fetched by someone else while the victim waited for the log                if (targetPtr->page_id_ == INVALID_PAGE_ID) {                    free_list_->push_front(targetPtr);                } else {                    replacer_->Insert(targetPtr);                }                loadedPtr->pin_count_++;                replacer_->Erase(loadedPtr);                TrackRecLSN(loadedPtr);                return loadedPtr;            }            // * 2. If the entry chosen for replacement is dirty, write it back to disk.            if (targetPtr->is_dirty_) {                if (!ForceLog(targetPtr)) {                    // its log can't be made durable, the page stays                    replacer_->Insert(targetPtr);                    return nullptr;                }                disk_manager_->WritePage(targetPtr->GetPageId(), targetPtr->data_);            }            // * 3. Delete the entry for the old page from the hash table and insert an            // * entry for the new page.            page_table_->Remove(targetPtr->GetPageId());            page_table_->Insert(page_id, targetPtr);            // * 4. Update page metadata, read page content from disk file and return page            // * pointer            disk_manager_->ReadPage(page_id, targetPtr->data_);            targetPtr->pin_count_ = 1;            targetPtr->is_dirty_ = false;            targetPtr->page_id_ = page_id;            targetPtr->rec_lsn_ = INVALID_LSN;            TrackRecLSN(targetPtr);        }        return targetPtr;    }/* * Fetch a page of a read only database. The page is served straight from the * mapping of the db file: no copy, no latch_ and no pinning, since a mapped * page is never evicted. Descriptors are created on first use and published * with a compare and swap, so concurrent readers never block each other. */    Page *BufferPoolManager::FetchMappedPage(page_id_t page_id) {        if (page_id < 0 || static_cast<size_t>(page_id) >= num_mapped_pages_) {            return nullptr;        }        Page *targetPtr = mapped_pages_[page_id].load(std::memory_order_acquire);        if (targetPtr != nullptr) {            return targetPtr;        }        Page *created = new Page();        created->data_ = disk_manager_->GetMappedPage(page_id);        created->page_id_ = page_id;        created->pin_count_ = 1;        if (!mapped_pages_[page_id].compare_exchange_strong(                targetPtr, created, std::memory_order_acq_rel)) {            // another reader won the race, use its descriptor            delete created;            return targetPtr;        }        return created;    }/* * Implementation of unpin page * if pin_count>0, decrement it and if it becomes zero, put it back to * replacer if pin_count<=0 before this call, return false. is_dirty: set the * dirty flag of this page */    bool BufferPoolManager::UnpinPage(page_id_t page_id, bool is_dirty) {        if (read_only_) {            // mapped pages are never pinned nor dirtied            return !is_dirty;        }        lock_guard<mutex> lck(latch_);        Page *targetPtr = nullptr;        page_table_->Find(page_id, targetPtr);        //是否找到        if (targetPtr == nullptr) {            return false;        } else {            // never clear a dirty flag set by another pinner            targetPtr->is_dirty_ = targetPtr->is_dirty_ || is_dirty;            if (targetPtr->GetPinCount() <= 0) {                return false;            }            targetPtr->pin_count_--;            if (targetPtr->pin_count_ == 0) {                replacer_->Insert(targetPtr);                if (!targetPtr->is_dirty_) {                    targetPtr->rec_lsn_ = INVALID_LSN;                }            }            return true;        }    }/* * Used to flush a particular page of the buffer pool to disk. Should call the * write_page method of the disk manager * if page is not found in page table, return false * NOTE: make sure page_id != INVALID_PAGE_ID */    bool BufferPoolManager::FlushPage(page_id_t page_id) {        // * Used to flush a particular page of the buffer pool to disk. Should call the        if (read_only_) {            return false;        }        lock_guard<mutex> lck(latch_);        Page *targetPtr = nullptr;        page_table_->Find(page_id, targetPtr);        if (targetPtr == nullptr || targetPtr->page_id_ == INVALID_PAGE_ID) {            // * if page is not found in page table, return false            // * NOTE: make sure page_id != INVALID_PAGE_ID            return false;        } else {            // * write_page method of the disk manager            if (targetPtr->is_dirty_) {                if (!ForceLog(targetPtr)) {                    return false;                }                disk_manager_->WritePage(page_id, targetPtr->GetData());                targetPtr->is_dirty_ = false;                ResetRecLSN(targetPtr);            }        }        return true;    }/* * Flush every dirty page of the buffer pool to disk. Dirty frames are handed * to disk manager as one batch so that adjacent pages are merged into a single * vectored write and the data file is synced only once. */    void BufferPoolManager::FlushAllPages() {        lock_guard<mutex> lck(latch_);        std::vector<Page *> batch;        for (size_t i = 0; i < pool_size_; ++i) {            if (pages_[i].page_id_ != INVALID_PAGE_ID && pages_[i].is_dirty_) {                batch.push_back(&pages_[i]);            }        }        FlushBatch(batch);    }/* * Flush the dirty pages among page_ids to disk with one batched write. * Pages that are not in buffer pool or are clean are skipped. */    bool BufferPoolManager::FlushPages(const std::vector<page_id_t> &page_ids) {        lock_guard<mutex> lck(latch_);        std::vector<Page *> batch;        for (page_id_t page_id : page_ids) {            Page *targetPtr = nullptr;            if (page_id != INVALID_PAGE_ID &&                page_table_->Find(page_id, targetPtr) && targetPtr->is_dirty_) {                batch.push_back(targetPtr);            }        }        return FlushBatch(batch);    }/* * help function to write back a batch of dirty pages, caller holds latch_. * A page that may not have reached the disk stays dirty, with its recLSN in * the dirty page table. * @return: false if some page stays dirty */    bool BufferPoolManager::FlushBatch(std::vector<Page *> &batch) {        if (batch.empty()) {            return true;        }        std::vector<std::pair<page_id_t, const char *>> writes;        writes.reserve(batch.size());        std::vector<page_id_t> failed;        for (Page *page : batch) {            if (!ForceLog(page)) {                failed.push_back(page->page_id_);                continue;            }            writes.emplace_back(page->page_id_, page->data_);        }        std::vector<page_id_t> unwritten = disk_manager_->WritePages(writes);        failed.insert(failed.end(), unwritten.begin(), unwritten.end());        for (Page *page : batch) {            if (std::find(failed.begin(), failed.end(), page->page_id_) !=                failed.end()) {                continue;            }            page->is_dirty_ = false;            ResetRecLSN(page);        }        return failed.empty();    }/* * help function for write ahead logging: the log records up to the LSN of a * page must be on disk before the page itself is written back. * The header page has no LSN field. * @return: false if the log can't be made durable, e.g. the log failed, the * page must not be written back then */    bool BufferPoolManager::ForceLog(Page *page) {        if (!ENABLE_LOGGING || log_manager_ == nullptr ||            page->page_id_ == HEADER_PAGE_ID) {            return true;        }        if (page->GetLSN() > log_manager_->GetPersistentLSN()) {            return log_manager_->ForceFlush(page->GetLSN());        }        return true;    }/* * help function for eviction: a page can be written back right away unless * some of its log records are not on disk yet */    bool BufferPoolManager::IsLogDurable(Page *page) {        return !page->is_dirty_ || !ENABLE_LOGGING || log_manager_ == nullptr ||               page->page_id_ == HEADER_PAGE_ID ||               page->GetLSN() <= log_manager_->GetPersistentLSN();    }/* * help functions for the dirty page table of checkpoints, caller holds latch_. * A page pinned while clean may be modified by any record appended from now * on, so its recLSN is the next lsn of the log. A page written back is clean * again, unless it is still pinned. */    void BufferPoolManager::TrackRecLSN(Page *page) {        if (log_manager_ != nullptr && !page->is_dirty_ &&            page->rec_lsn_ == INVALID_LSN) {            page->rec_lsn_ = log_manager_->GetNextLSN();        }    }    void BufferPoolManager::ResetRecLSN(Page *page) {        page->rec_lsn_ = INVALID_LSN;        if (page->pin_count_ > 0) {            TrackRecLSN(page);        }    }/* * Snapshot of the dirty page table for a fuzzy checkpoint: every page that * is dirty, or pinned and possibly being modified, with its recLSN */    std::vector<std::pair<page_id_t, lsn_t>> BufferPoolManager::GetDirtyPageTable() {        std::vector<std::pair<page_id_t, lsn_t>> dirty_pages;        if (read_only_) {            return dirty_pages;        }        lock_guard<mutex> lck(latch_);        for (size_t i = 0; i < pool_size_; ++i) {            if (pages_[i].page_id_ != INVALID_PAGE_ID &&                pages_[i].rec_lsn_ != INVALID_LSN) {                dirty_pages.emplace_back(pages_[i].page_id_, pages_[i].rec_lsn_);            }        }        return dirty_pages;    }/** * User should call this method for deleting a page. This routine will call * disk manager to deallocate the page. * First, if page is found within page table, * buffer pool manager should be reponsible for removing this entry out * of page table, reseting page metadata and adding back to free list. Second, * call disk manager's DeallocatePage() method to delete from disk file. If * the page is found within page table, but pin_count != 0, return false */    bool BufferPoolManager::DeletePage(page_id_t page_id) {        if (read_only_) {            LOG_DEBUG("delete page of read only database");            return false;        }        lock_guard<mutex> lck(latch_);        Page *targetPtr = nullptr;        page_table_->Find(page_id, targetPtr);        if (targetPtr != nullptr) {            //如果在页表中，removing this entry out of page table,            // reseting page metadata and adding back to free list.            if (targetPtr->GetPinCount() > 0) {                return false;            }            replacer_->Erase(targetPtr);            page_table_->Remove(page_id);            targetPtr->is_dirty_ = false;            targetPtr->rec_lsn_ = INVALID_LSN;            targetPtr->ResetMemory();            free_list_->push_back(targetPtr);        }        disk_manager_->DeallocatePage(page_id);        return true;    }/** * User should call this method if needs to create a new page. This routine * will call disk manager to allocate a page. * Buffer pool manager should be responsible to choose a victim page either * from free list or lru replacer(NOTE: always choose from free list first), * update new page's metadata, zero out memory and add corresponding entry * into page table. return nullptr if all the pages in pool are pinned */    Page *BufferPoolManager::NewPage(page_id_t &page_id) {        if (read_only_) {            LOG_DEBUG("new page in read only database");            return nullptr;        }        unique_lock<mutex> lck(latch_);        Page *targetPtr = nullptr;        targetPtr = GetVictimPage(lck);        if (targetPtr == nullptr) {            return nullptr;        }        if (targetPtr->is_dirty_) {            if (!ForceLog(targetPtr)) {                // its log can't be made durable, the page stays                replacer_->Insert(targetPtr);                return nullptr;            }            disk_manager_->WritePage(targetPtr->GetPageId(), targetPtr->data_);        }        page_id = disk_manager_->AllocatePage();        page_table_->Remove(targetPtr->GetPageId());        page_table_->Insert(page_id, targetPtr);        targetPtr->page_id_ = page_id;        targetPtr->ResetMemory();        targetPtr->is_dirty_ = false;        targetPtr->pin_count_ = 1;        targetPtr->rec_lsn_ = INVALID_LSN;        TrackRecLSN(targetPtr);        return targetPtr;    }} // namespace scudb
\ No newline at end of file
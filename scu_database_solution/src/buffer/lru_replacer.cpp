@@ -69,6 +69,27 @@ namespace scudb {
         return true;
     }
 
+/* Like Victim, but walk from the least recently used member and pop the first
+ * of at most depth members that satisfies pred. The rest keep their order.
+ */
+    template<typename T>
+    bool LRUReplacer<T>::VictimIf(T &value,
+                                  const std::function<bool(const T &)> &pred,
+                                  size_t depth) {
+        std::lock_guard<mutex> lck(latch);
+        std::shared_ptr<Node> cur = tail->prev;
+        for (size_t i = 0; i < depth && cur != head; ++i, cur = cur->prev) {
+            if (pred(cur->val)) {
+                cur->prev->next = cur->next;
+                cur->next->prev = cur->prev;
+                value = cur->val;
+                map.erase(cur->val);
+                return true;
+            }
+        }
+        return false;
+    }
+
 /*
  * Remove value from LRU. If removal is successful, return true, otherwise
  * return false
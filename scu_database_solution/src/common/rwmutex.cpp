@@ -0,0 +1,121 @@
+/**
+ * rwmutex.cpp
+ */
+
+#include <climits>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "common/rwmutex.h"
+
+namespace scudb {
+
+// the futex is the word inside the atomic
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "atomic word is not a plain word");
+
+// spins before a blocked thread goes to sleep
+static const int SPIN_LIMIT = 100;
+
+static inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+
+void RWMutex::WLockSlow() {
+  // enter, once no other writer is in
+  for (int spins = 0;; spins++) {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    if (!(state & WRITER)) {
+      if (state_.compare_exchange_weak(state, state | WRITER,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed))
+        break;
+    } else if (spins < SPIN_LIMIT) {
+      CpuRelax();
+    } else {
+      Park(state);
+    }
+  }
+  // new readers are held off, the ones before leave
+  for (int spins = 0;; spins++) {
+    uint32_t state = state_.load(std::memory_order_acquire);
+    if ((state & READERS) == 0)
+      return;
+    if (spins < SPIN_LIMIT)
+      CpuRelax();
+    else
+      Park(state);
+  }
+}
+
+void RWMutex::RLockSlow() {
+  for (int spins = 0;; spins++) {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    if (!(state & WRITER)) {
+      if (state_.compare_exchange_weak(state, state + 1,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed))
+        return;
+    } else if (spins < SPIN_LIMIT) {
+      CpuRelax();
+    } else {
+      Park(state);
+    }
+  }
+}
+
+/*
+ * The waiters bit is set before sleeping, so the unlock that changes the word
+ * afterwards wakes the sleepers. If the word changed in between, the futex
+ * returns right away.
+ */
+void RWMutex::Park(uint32_t state) {
+  if (!(state & WAITERS) &&
+      !state_.compare_exchange_strong(state, state | WAITERS))
+    return;
+#ifdef __linux__
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&state_), FUTEX_WAIT_PRIVATE,
+          state | WAITERS, nullptr, nullptr, 0);
+#else
+  std::this_thread::yield();
+#endif
+}
+
+// wake every sleeper, the ones that still cannot go sleep again
+void RWMutex::Wake() {
+#ifdef __linux__
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&state_), FUTEX_WAKE_PRIVATE,
+          INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+void DistributedRWMutex::WLock() {
+  writers_.WLock();
+  writer_.store(true);
+  for (ReaderSlot &slot : slots_) {
+    for (int spins = 0; slot.readers_.load() != 0; spins++) {
+      if (spins < SPIN_LIMIT)
+        CpuRelax();
+      else
+        std::this_thread::yield();
+    }
+  }
+}
+
+// threads take the counters round robin, in the order they first latch
+int DistributedRWMutex::SlotIndex() {
+  static std::atomic<int> next_slot(0);
+  thread_local int slot = next_slot++ % READER_SLOTS;
+  return slot;
+}
+
+} // namespace scudb
@@ -2,24 +2,627 @@
  * lock_manager.cpp
  */
 
+#include <algorithm>
+#include <cassert>
+#include <functional>
+
 #include "concurrency/lock_manager.h"
 
 namespace scudb {
 
-bool LockManager::LockShared(Transaction *txn, const RID &rid) {
-  return false;
+/*
+ * The number of shards is rounded up to a power of two, a shard is picked by
+ * the high bits of a multiplicative hash of the RID
+ */
+LockManager::LockManager(bool strict_2PL, int num_shards)
+    : strict_2PL_(strict_2PL), shard_shift_(64),
+      escalation_threshold_(LOCK_ESCALATION_THRESHOLD), detection_(false),
+      detector_running_(false), detector_thread_(nullptr), num_aborts_(0),
+      num_deadlocks_(0), num_escalations_(0), detection_latency_us_(0) {
+  int shards = 1;
+  while (shards < num_shards) {
+    shards <<= 1;
+    shard_shift_--;
+  }
+  for (int i = 0; i < shards; i++)
+    shards_.emplace_back(new Shard);
 }
 
-bool LockManager::LockExclusive(Transaction *txn, const RID &rid) {
-  return false;
+LockManager::~LockManager() { StopDeadlockDetection(); }
+
+bool LockManager::LockShared(Transaction *txn, const RID &rid,
+                             page_id_t table_id) {
+  return LockTuple(txn, rid, LockMode::SHARED, table_id);
+}
+
+bool LockManager::LockExclusive(Transaction *txn, const RID &rid,
+                                page_id_t table_id) {
+  return LockTuple(txn, rid, LockMode::EXCLUSIVE, table_id);
+}
+
+/*
+ * Turn the shared lock of txn into an exclusive one, the table is locked IX
+ * first unless its lock covers the exclusive lock
+ */
+bool LockManager::LockUpgrade(Transaction *txn, const RID &rid,
+                              page_id_t table_id) {
+  if (table_id != INVALID_PAGE_ID) {
+    auto table_lock = txn->GetTableLockSet()->find(table_id);
+    if (table_lock != txn->GetTableLockSet()->end() &&
+        table_lock->second == LockMode::EXCLUSIVE)
+      return CanLock(txn);
+    if (!LockTable(txn, table_id, LockMode::INTENTION_EXCLUSIVE))
+      return false;
+  }
+  if (!Convert(txn, rid, LockMode::EXCLUSIVE))
+    return false;
+  txn->GetSharedLockSet()->erase(rid);
+  txn->GetExclusiveLockSet()->emplace(rid);
+  return true;
+}
+
+/*
+ * Release the lock of txn on rid and grant the requests it was blocking
+ */
+bool LockManager::Unlock(Transaction *txn, const RID &rid,
+                         page_id_t table_id) {
+  if (!CanUnlock(txn))
+    return false;
+  txn->GetSharedLockSet()->erase(rid);
+  txn->GetExclusiveLockSet()->erase(rid);
+  if (table_id != INVALID_PAGE_ID) {
+    auto tuples = txn->GetTableTupleLockSet()->find(table_id);
+    if (tuples != txn->GetTableTupleLockSet()->end())
+      tuples->second.erase(rid);
+  }
+  return Release(txn, rid);
+}
+
+bool LockManager::LockTable(Transaction *txn, page_id_t table_id,
+                            LockMode mode) {
+  auto table_locks = txn->GetTableLockSet();
+  auto it = table_locks->find(table_id);
+  if (it == table_locks->end()) {
+    if (!Lock(txn, TableKey(table_id), mode))
+      return false;
+    table_locks->emplace(table_id, mode);
+    return true;
+  }
+  LockMode target = Combine(it->second, mode);
+  if (target == it->second)
+    return CanLock(txn);
+  if (!Convert(txn, TableKey(table_id), target))
+    return false;
+  it->second = target;
+  return true;
+}
+
+bool LockManager::UnlockTable(Transaction *txn, page_id_t table_id) {
+  if (!CanUnlock(txn))
+    return false;
+  txn->GetTableLockSet()->erase(table_id);
+  txn->GetTableTupleLockSet()->erase(table_id);
+  return Release(txn, TableKey(table_id));
+}
+
+/*
+ * Private helper: lock a tuple of table table_id, or of no table if it is
+ * INVALID_PAGE_ID. A tuple lock the table lock covers is not taken at all.
+ */
+bool LockManager::LockTuple(Transaction *txn, const RID &rid, LockMode mode,
+                            page_id_t table_id) {
+  if (table_id != INVALID_PAGE_ID) {
+    auto table_lock = txn->GetTableLockSet()->find(table_id);
+    if (table_lock != txn->GetTableLockSet()->end() &&
+        Combine(table_lock->second, mode) == table_lock->second)
+      return CanLock(txn);
+    LockMode intention = mode == LockMode::SHARED
+                             ? LockMode::INTENTION_SHARED
+                             : LockMode::INTENTION_EXCLUSIVE;
+    if (!LockTable(txn, table_id, intention))
+      return false;
+  }
+  if (!Lock(txn, rid, mode))
+    return false;
+  if (mode == LockMode::SHARED)
+    txn->GetSharedLockSet()->emplace(rid);
+  else
+    txn->GetExclusiveLockSet()->emplace(rid);
+  if (table_id != INVALID_PAGE_ID) {
+    auto &tuples = (*txn->GetTableTupleLockSet())[table_id];
+    tuples.insert(rid);
+    if (static_cast<int>(tuples.size()) >= escalation_threshold_)
+      Escalate(txn, table_id);
+  }
+  return true;
 }
 
-bool LockManager::LockUpgrade(Transaction *txn, const RID &rid) {
+/*
+ * Private helper: queue a request of mode at the tail and wait for it.
+ * Wait-die against every request ahead of it that conflicts, unless the
+ * deadlock detector is running.
+ */
+bool LockManager::Lock(Transaction *txn, const RID &rid, LockMode mode) {
+  if (!CanLock(txn))
+    return false;
+  Shard &shard = GetShard(rid);
+  std::unique_lock<std::mutex> lock(shard.latch_);
+  LockQueue &queue = shard.queues_[rid];
+  txn_id_t txn_id = txn->GetTransactionId();
+  for (LockRequest *r = queue.head_; r != nullptr && !detection_;
+       r = r->next_) {
+    if (!Compatible(mode, r->mode_) && r->txn_id_ < txn_id) {
+      num_aborts_++;
+      txn->SetState(TransactionState::ABORTED);
+      return false;
+    }
+  }
+  LockRequest *request = NewRequest(shard, txn, mode);
+  if (queue.head_ == nullptr) {
+    // first lock on the resource, nothing to check or to wait for
+    request->granted_ = true;
+    InsertAfter(queue, nullptr, request);
+    return true;
+  }
+  request->wait_start_ = std::chrono::steady_clock::now();
+  InsertAfter(queue, queue.tail_, request);
+  GrantWaiting(queue);
+  return WaitForGrant(shard, lock, rid, queue, request);
+}
+
+/*
+ * Private helper: convert the granted lock of txn on rid to the stronger
+ * mode. A request of that mode goes ahead of every waiting request, the
+ * younger ones it conflicts with die. Only one conversion may wait on a
+ * resource at a time. The lock held stays granted until the conversion is,
+ * so a conversion that dies leaves it as the lock sets of txn list it, and
+ * the queue outlives the wait.
+ */
+bool LockManager::Convert(Transaction *txn, const RID &rid, LockMode mode) {
+  if (!CanLock(txn))
+    return false;
+  Shard &shard = GetShard(rid);
+  std::unique_lock<std::mutex> lock(shard.latch_);
+  auto it = shard.queues_.find(rid);
+  if (it == shard.queues_.end())
+    return false;
+  LockQueue &queue = it->second;
+  txn_id_t txn_id = txn->GetTransactionId();
+  LockRequest *request = queue.head_;
+  while (request != nullptr && request->txn_id_ != txn_id)
+    request = request->next_;
+  if (request == nullptr || !request->granted_)
+    return false;
+
+  // wait for the other holders only if the conflicting ones are all younger,
+  // two conversions would always deadlock
+  bool die = queue.upgrading_;
+  LockRequest *last_granted = nullptr;
+  for (LockRequest *r = queue.head_; r != nullptr && r->granted_;
+       r = r->next_) {
+    if (r != request)
+      die = die || (!detection_ && !Compatible(mode, r->mode_) &&
+                    r->txn_id_ < txn_id);
+    last_granted = r;
+  }
+  if (die) {
+    num_aborts_++;
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+
+  LockRequest *conversion = NewRequest(shard, txn, mode);
+  InsertAfter(queue, last_granted, conversion);
+  queue.upgrading_ = true;
+  conversion->wait_start_ = std::chrono::steady_clock::now();
+  for (LockRequest *r = conversion->next_; r != nullptr && !detection_;
+       r = r->next_) {
+    if (r->txn_id_ > txn_id && !r->aborted_ && !Compatible(mode, r->mode_)) {
+      r->aborted_ = true;
+      r->cv_.notify_one();
+    }
+  }
+  GrantWaiting(queue);
+  bool granted = WaitForGrant(shard, lock, rid, queue, conversion);
+  queue.upgrading_ = false;
+  if (granted)
+    Remove(shard, rid, queue, request);
+  return granted;
+}
+
+/*
+ * Private helper: remove the granted request of txn on rid
+ */
+bool LockManager::Release(Transaction *txn, const RID &rid) {
+  Shard &shard = GetShard(rid);
+  std::lock_guard<std::mutex> guard(shard.latch_);
+  auto it = shard.queues_.find(rid);
+  if (it == shard.queues_.end())
+    return false;
+  LockRequest *request = it->second.head_;
+  while (request != nullptr &&
+         request->txn_id_ != txn->GetTransactionId())
+    request = request->next_;
+  if (request == nullptr || !request->granted_)
+    return false;
+  Remove(shard, rid, it->second, request);
+  return true;
+}
+
+/*
+ * Private helper: convert the table lock of txn so it covers its tuple locks
+ * in the table, X if one of them is exclusive, then release the covered ones.
+ * Gives up at once if another holder of the table lock conflicts.
+ */
+void LockManager::Escalate(Transaction *txn, page_id_t table_id) {
+  auto table_lock = txn->GetTableLockSet()->find(table_id);
+  if (table_lock == txn->GetTableLockSet()->end())
+    return;
+  auto &tuples = (*txn->GetTableTupleLockSet())[table_id];
+  auto exclusive_locks = txn->GetExclusiveLockSet();
+  LockMode target = Combine(table_lock->second, LockMode::SHARED);
+  for (const RID &rid : tuples) {
+    if (exclusive_locks->find(rid) != exclusive_locks->end()) {
+      target = LockMode::EXCLUSIVE;
+      break;
+    }
+  }
+  if (target == table_lock->second)
+    return;
+
+  RID key = TableKey(table_id);
+  {
+    Shard &shard = GetShard(key);
+    std::lock_guard<std::mutex> guard(shard.latch_);
+    auto it = shard.queues_.find(key);
+    if (it == shard.queues_.end())
+      return;
+    txn_id_t txn_id = txn->GetTransactionId();
+    LockRequest *request = nullptr;
+    for (LockRequest *r = it->second.head_; r != nullptr; r = r->next_) {
+      if (r->txn_id_ == txn_id)
+        request = r;
+      else if (r->granted_ && !Compatible(target, r->mode_))
+        return;
+    }
+    if (request == nullptr || !request->granted_)
+      return;
+    request->mode_ = target;
+    // younger waiters now wait for an older transaction, they die instead
+    for (LockRequest *r = request->next_; r != nullptr && !detection_;
+         r = r->next_) {
+      if (!r->granted_ && !r->aborted_ && r->txn_id_ > txn_id &&
+          !Compatible(target, r->mode_)) {
+        r->aborted_ = true;
+        r->cv_.notify_one();
+      }
+    }
+  }
+  table_lock->second = target;
+  num_escalations_++;
+
+  auto shared_locks = txn->GetSharedLockSet();
+  for (auto it = tuples.begin(); it != tuples.end();) {
+    if (target == LockMode::EXCLUSIVE ||
+        shared_locks->find(*it) != shared_locks->end()) {
+      shared_locks->erase(*it);
+      exclusive_locks->erase(*it);
+      Release(txn, *it);
+      it = tuples.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+/*
+ * Private helper: an aborted transaction holds on to its locks but takes no
+ * new ones, nor does a transaction that started releasing them
+ */
+bool LockManager::CanLock(Transaction *txn) {
+  if (txn->GetState() == TransactionState::ABORTED)
+    return false;
+  if (txn->GetState() == TransactionState::SHRINKING) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Private helper: under strict 2PL locks are only released once txn committed
+ * or aborted, otherwise the first unlock moves txn to its shrinking phase
+ */
+bool LockManager::CanUnlock(Transaction *txn) {
+  if (strict_2PL_) {
+    if (txn->GetState() != TransactionState::COMMITTED &&
+        txn->GetState() != TransactionState::ABORTED) {
+      txn->SetState(TransactionState::ABORTED);
+      return false;
+    }
+  } else if (txn->GetState() == TransactionState::GROWING) {
+    txn->SetState(TransactionState::SHRINKING);
+  }
+  return true;
+}
+
+/*
+ * Private helper: sleep on the condition variable of request until it is
+ * granted or killed. A killed request leaves the queue and its transaction
+ * aborts.
+ */
+bool LockManager::WaitForGrant(Shard &shard,
+                               std::unique_lock<std::mutex> &lock,
+                               const RID &rid, LockQueue &queue,
+                               LockRequest *request) {
+  request->cv_.wait(
+      lock, [request] { return request->granted_ || request->aborted_; });
+  if (request->granted_)
+    return true;
+  Transaction *txn = request->txn_;
+  Remove(shard, rid, queue, request);
+  num_aborts_++;
+  txn->SetState(TransactionState::ABORTED);
   return false;
 }
 
-bool LockManager::Unlock(Transaction *txn, const RID &rid) {
+/*
+ * Private helper: grant the waiting requests at the front of the queue, in
+ * FIFO order. A request is granted when everything ahead of it is granted
+ * and compatible with it, the lock a conversion replaces does not count.
+ */
+void LockManager::GrantWaiting(LockQueue &queue) {
+  for (LockRequest *r = queue.head_; r != nullptr; r = r->next_) {
+    if (r->granted_ || r->aborted_)
+      continue;
+    for (LockRequest *g = queue.head_; g != r; g = g->next_) {
+      if (g->granted_ && g->txn_id_ != r->txn_id_ &&
+          !Compatible(g->mode_, r->mode_))
+        return;
+    }
+    r->granted_ = true;
+    r->cv_.notify_one();
+  }
+}
+
+/*
+ * Private helper: take request out of the queue, return it to the pool and
+ * grant what it was blocking. The queue goes away with its last request.
+ */
+void LockManager::Remove(Shard &shard, const RID &rid, LockQueue &queue,
+                         LockRequest *request) {
+  Unlink(queue, request);
+  request->txn_ = nullptr;
+  shard.free_.push_back(request);
+  if (queue.head_ == nullptr) {
+    shard.queues_.erase(rid);
+    return;
+  }
+  GrantWaiting(queue);
+}
+
+/*
+ * Private helper: link request after pos, at the head if pos is nullptr
+ */
+void LockManager::InsertAfter(LockQueue &queue, LockRequest *pos,
+                              LockRequest *request) {
+  LockRequest *next = pos == nullptr ? queue.head_ : pos->next_;
+  request->prev_ = pos;
+  request->next_ = next;
+  if (pos == nullptr)
+    queue.head_ = request;
+  else
+    pos->next_ = request;
+  if (next == nullptr)
+    queue.tail_ = request;
+  else
+    next->prev_ = request;
+}
+
+void LockManager::Unlink(LockQueue &queue, LockRequest *request) {
+  if (request->prev_ == nullptr)
+    queue.head_ = request->next_;
+  else
+    request->prev_->next_ = request->next_;
+  if (request->next_ == nullptr)
+    queue.tail_ = request->prev_;
+  else
+    request->next_->prev_ = request->prev_;
+  request->prev_ = request->next_ = nullptr;
+}
+
+/*
+ * Private helper: a request from the pool of shard, the pool only grows when
+ * every request is in use
+ */
+LockManager::LockRequest *LockManager::NewRequest(Shard &shard,
+                                                  Transaction *txn,
+                                                  LockMode mode) {
+  LockRequest *request;
+  if (shard.free_.empty()) {
+    shard.pool_.emplace_back();
+    request = &shard.pool_.back();
+  } else {
+    request = shard.free_.back();
+    shard.free_.pop_back();
+  }
+  request->txn_ = txn;
+  request->txn_id_ = txn->GetTransactionId();
+  request->mode_ = mode;
+  request->granted_ = false;
+  request->aborted_ = false;
+  request->prev_ = request->next_ = nullptr;
+  return request;
+}
+
+void LockManager::StartDeadlockDetection(std::chrono::milliseconds interval) {
+  std::lock_guard<std::mutex> guard(detector_latch_);
+  if (detector_thread_ != nullptr)
+    return;
+  detection_ = true;
+  detector_running_ = true;
+  detector_thread_ =
+      new std::thread(&LockManager::DetectorThread, this, interval);
+}
+
+/*
+ * Stop the detector and go back to wait-die. Transactions that are already
+ * waiting are left to the lock holders.
+ */
+void LockManager::StopDeadlockDetection() {
+  std::thread *detector_thread;
+  {
+    std::lock_guard<std::mutex> guard(detector_latch_);
+    if (detector_thread_ == nullptr)
+      return;
+    detector_running_ = false;
+    detector_thread = detector_thread_;
+    detector_thread_ = nullptr;
+  }
+  detector_cv_.notify_one();
+  detector_thread->join();
+  delete detector_thread;
+  detection_ = false;
+}
+
+void LockManager::DetectorThread(std::chrono::milliseconds interval) {
+  std::unique_lock<std::mutex> lock(detector_latch_);
+  while (detector_running_) {
+    detector_cv_.wait_for(lock, interval);
+    if (!detector_running_)
+      break;
+    lock.unlock();
+    DetectDeadlocks();
+    lock.lock();
+  }
+}
+
+/*
+ * Build the waits-for graph with every shard latched, so it is a consistent
+ * snapshot: a waiting request waits for every request ahead of it in the
+ * queue that conflicts with it. Then abort the youngest transaction of a
+ * cycle, drop it from the graph and look again.
+ */
+int LockManager::DetectDeadlocks() {
+  std::vector<std::unique_lock<std::mutex>> locks;
+  for (auto &shard : shards_)
+    locks.emplace_back(shard->latch_);
+  std::map<txn_id_t, std::set<txn_id_t>> graph;
+  std::unordered_map<txn_id_t, LockRequest *> waiting;
+  for (auto &shard : shards_) {
+    for (auto &entry : shard->queues_) {
+      for (LockRequest *w = entry.second.head_; w != nullptr; w = w->next_) {
+        if (w->granted_ || w->aborted_)
+          continue;
+        waiting[w->txn_id_] = w;
+        for (LockRequest *r = entry.second.head_; r != w; r = r->next_) {
+          if (!r->aborted_ && r->txn_id_ != w->txn_id_ &&
+              !Compatible(w->mode_, r->mode_))
+            graph[w->txn_id_].insert(r->txn_id_);
+        }
+      }
+    }
+  }
+
+  int victims = 0;
+  txn_id_t victim;
+  auto now = std::chrono::steady_clock::now();
+  while (FindCycle(graph, victim)) {
+    // every transaction of a cycle waits, the victim gives up its request
+    LockRequest *request = waiting[victim];
+    request->aborted_ = true;
+    request->cv_.notify_one();
+    detection_latency_us_ +=
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - request->wait_start_)
+            .count();
+    num_deadlocks_++;
+    victims++;
+    graph.erase(victim);
+    for (auto &edges : graph)
+      edges.second.erase(victim);
+  }
+  return victims;
+}
+
+double LockManager::GetAverageDetectionLatency() {
+  int deadlocks = num_deadlocks_;
+  return deadlocks == 0
+             ? 0
+             : static_cast<double>(detection_latency_us_) / deadlocks;
+}
+
+/*
+ * Private helper: depth first search from the transactions in increasing id
+ * order, a cycle is found when a transaction on the current path is reached
+ * again. The victim is the youngest transaction on that cycle.
+ */
+bool LockManager::FindCycle(
+    const std::map<txn_id_t, std::set<txn_id_t>> &graph, txn_id_t &victim) {
+  std::set<txn_id_t> visited;
+  std::vector<txn_id_t> path;
+  std::function<bool(txn_id_t)> visit = [&](txn_id_t txn_id) {
+    auto on_path = std::find(path.begin(), path.end(), txn_id);
+    if (on_path != path.end()) {
+      victim = *std::max_element(on_path, path.end());
+      return true;
+    }
+    if (!visited.insert(txn_id).second)
+      return false;
+    auto edges = graph.find(txn_id);
+    if (edges == graph.end())
+      return false;
+    path.push_back(txn_id);
+    for (txn_id_t next : edges->second) {
+      if (visit(next))
+        return true;
+    }
+    path.pop_back();
+    return false;
+  };
+  for (auto &entry : graph) {
+    if (visit(entry.first))
+      return true;
+  }
   return false;
 }
 
+/*
+ * Private helper: the lock compatibility matrix, the tuple modes S and X
+ * behave as on a table
+ */
+bool LockManager::Compatible(LockMode a, LockMode b) {
+  static const bool compatible[5][5] = {
+      // IS    IX     S      SIX    X
+      {true, true, true, true, false},     // IS
+      {true, true, false, false, false},   // IX
+      {true, false, true, false, false},   // S
+      {true, false, false, false, false},  // SIX
+      {false, false, false, false, false}, // X
+  };
+  return compatible[static_cast<int>(a)][static_cast<int>(b)];
+}
+
+/*
+ * Private helper: the weakest mode that grants everything a and b grant
+ */
+LockMode LockManager::Combine(LockMode a, LockMode b) {
+  if (a == b)
+    return a;
+  if (a == LockMode::EXCLUSIVE || b == LockMode::EXCLUSIVE)
+    return LockMode::EXCLUSIVE;
+  if (a == LockMode::INTENTION_SHARED)
+    return b;
+  if (b == LockMode::INTENTION_SHARED)
+    return a;
+  // two of IX, S and SIX
+  return LockMode::SHARED_INTENTION_EXCLUSIVE;
+}
+
+LockManager::Shard &LockManager::GetShard(const RID &rid) {
+  uint64_t hash = static_cast<uint64_t>(std::hash<RID>()(rid)) *
+                  0x9E3779B97F4A7C15ULL;
+  return *shards_[shard_shift_ == 64 ? 0 : hash >> shard_shift_];
+}
+
 } // namespace scudb
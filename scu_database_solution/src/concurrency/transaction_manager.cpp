@@ -6,20 +6,82 @@
 #include "table/table_heap.h"
 
 #include <cassert>
+#include <vector>
 namespace scudb {
 
+// finished transactions kept for reuse by the thread that released them
+struct TransactionPool {
+  ~TransactionPool() {
+    for (Transaction *txn : free_)
+      delete txn;
+  }
+  std::vector<Transaction *> free_;
+};
+
+static thread_local TransactionPool txn_pool;
+
+// a pooled transaction of the calling thread, or a new one
+static Transaction *AcquireTransaction(txn_id_t txn_id) {
+  if (txn_pool.free_.empty())
+    return new Transaction(txn_id);
+  Transaction *txn = txn_pool.free_.back();
+  txn_pool.free_.pop_back();
+  txn->Reset(txn_id);
+  return txn;
+}
+
 Transaction *TransactionManager::Begin() {
-  Transaction *txn = new Transaction(next_txn_id_++);
+  Transaction *txn = AcquireTransaction(next_txn_id_++);
+  txn->SetAsyncCommit(async_commit_);
+  if (snapshot_isolation_) {
+    std::lock_guard<std::mutex> lck(snapshot_latch_);
+    txn->SetSnapshot(&version_store_, last_commit_ts_);
+    snapshots_.insert(last_commit_ts_);
+  }
+  if (optimistic_)
+    txn->SetOptimistic(&tuple_versions_);
 
   if (ENABLE_LOGGING) {
-    // TODO: write log and update transaction's prev_lsn here
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(),
+                         LogRecordType::BEGIN);
+    // under the latch, a checkpoint either sees the BEGIN record or the txn
+    std::lock_guard<std::mutex> lck(active_latch_);
+    txn->SetPrevLSN(log_manager_->AppendLogRecord(log_record));
+    active_txns_.emplace(txn->GetTransactionId(),
+                         std::make_pair(txn, txn->GetPrevLSN()));
   }
 
   return txn;
 }
 
-void TransactionManager::Commit(Transaction *txn) {
+Transaction *TransactionManager::BeginReadOnly() {
+  Transaction *txn = AcquireTransaction(next_txn_id_++);
+  txn->SetReadOnly(true);
+  if (snapshot_isolation_) {
+    std::lock_guard<std::mutex> lck(snapshot_latch_);
+    txn->SetSnapshot(&version_store_, last_commit_ts_);
+    snapshots_.insert(last_commit_ts_);
+  }
+  return txn;
+}
+
+bool TransactionManager::Commit(Transaction *txn) {
+  if (txn->IsReadOnly()) {
+    EndReadOnly(txn, TransactionState::COMMITTED);
+    return true;
+  }
+  if (txn->IsOptimistic() && !InstallWrites(txn)) {
+    Rollback(txn);
+    return false;
+  }
   txn->SetState(TransactionState::COMMITTED);
+  // publish the new versions before the deleted tuples leave their slots,
+  // which other transactions may reuse right away
+  if (txn->GetVersionStore() != nullptr) {
+    std::lock_guard<std::mutex> lck(snapshot_latch_);
+    version_store_.Commit(txn, ++last_commit_ts_);
+    RemoveSnapshot(txn);
+  }
   // truly delete before commit
   auto write_set = txn->GetWriteSet();
   while (!write_set->empty()) {
@@ -33,8 +95,19 @@ void TransactionManager::Commit(Transaction *txn) {
   }
   write_set->clear();
 
+  bool durable = true;
   if (ENABLE_LOGGING) {
-    // TODO: write log and update transaction's prev_lsn here
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(),
+                         LogRecordType::COMMIT);
+    txn->SetPrevLSN(log_manager_->AppendLogRecord(log_record));
+    RemoveActiveTransaction(txn);
+    if (txn->IsAsyncCommit()) {
+      // durable within the async commit window, do not wait for it
+      log_manager_->AsyncCommit(txn->GetPrevLSN());
+    } else {
+      // group commit, concurrent committers share one log write
+      durable = log_manager_->WaitForCommit(txn->GetPrevLSN());
+    }
   }
 
   // release all the lock
@@ -47,9 +120,171 @@ void TransactionManager::Commit(Transaction *txn) {
   for (auto locked_rid : lock_set) {
     lock_manager_->Unlock(txn, locked_rid);
   }
+  // then the table locks they were taken under
+  std::vector<page_id_t> tables;
+  for (auto item : *txn->GetTableLockSet())
+    tables.push_back(item.first);
+  for (auto table_id : tables) {
+    lock_manager_->UnlockTable(txn, table_id);
+  }
+  // the new versions of its writes
+  if (txn->IsOptimistic())
+    tuple_versions_.Unlock(txn, true);
+  return durable;
+}
+
+/*
+ * Backward validation: the words of the written tuples are locked first, so
+ * no transaction commits a write to them while the reads are checked against
+ * the transactions that committed already. The buffered writes then go to the
+ * pages like those of a locking transaction and become the undo log.
+ */
+bool TransactionManager::InstallWrites(Transaction *txn) {
+  auto write_set = txn->GetWriteSet();
+  WriteSet writes;
+  writes.swap(*write_set);
+  std::vector<RID> rids;
+  for (auto &item : writes) {
+    // inserts went to the pages right away
+    if (item.wtype_ == WType::INSERT)
+      write_set->push_back(item);
+    else
+      rids.push_back(item.rid_);
+  }
+  if (!tuple_versions_.Lock(txn, rids) || !tuple_versions_.Validate(txn))
+    return false;
+  // the table heap applies writes of a transaction that is not growing
+  txn->SetState(TransactionState::COMMITTED);
+  for (auto &item : writes) {
+    bool applied = true;
+    if (item.wtype_ == WType::UPDATE)
+      applied = item.table_->UpdateTuple(item.tuple_, item.rid_, txn);
+    else if (item.wtype_ == WType::DELETE)
+      applied = item.table_->MarkDelete(item.rid_, txn);
+    if (!applied || txn->GetState() == TransactionState::ABORTED)
+      return false;
+  }
+  return true;
+}
+
+void TransactionManager::Release(Transaction *txn) {
+  if (txn_pool.free_.size() < TXN_POOL_SIZE)
+    txn_pool.free_.push_back(txn);
+  else
+    delete txn;
+}
+
+bool TransactionManager::WaitForDurable(Transaction *txn) {
+  if (ENABLE_LOGGING && txn->GetPrevLSN() != INVALID_LSN) {
+    return log_manager_->WaitForDurable(txn->GetPrevLSN());
+  }
+  return true;
+}
+
+std::vector<std::pair<txn_id_t, lsn_t>>
+TransactionManager::GetActiveTransactions(lsn_t &min_begin_lsn) {
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txns;
+  min_begin_lsn = INVALID_LSN;
+  std::lock_guard<std::mutex> lck(active_latch_);
+  for (auto &entry : active_txns_) {
+    active_txns.emplace_back(entry.first, entry.second.first->GetPrevLSN());
+    if (min_begin_lsn == INVALID_LSN || entry.second.second < min_begin_lsn)
+      min_begin_lsn = entry.second.second;
+  }
+  return active_txns;
+}
+
+/*
+ * A snapshot that begins later reads at the last commit timestamp or after,
+ * so without running snapshots every version ended at it can go
+ */
+int TransactionManager::Vacuum() {
+  timestamp_t oldest_ts;
+  {
+    std::lock_guard<std::mutex> lck(snapshot_latch_);
+    oldest_ts = snapshots_.empty() ? last_commit_ts_ : *snapshots_.begin();
+  }
+  return version_store_.Vacuum(oldest_ts);
+}
+
+void TransactionManager::StartVacuumThread(
+    std::chrono::milliseconds interval) {
+  std::lock_guard<std::mutex> guard(vacuum_latch_);
+  if (vacuum_thread_ != nullptr)
+    return;
+  vacuum_running_ = true;
+  vacuum_thread_ =
+      new std::thread(&TransactionManager::VacuumThread, this, interval);
+}
+
+void TransactionManager::StopVacuumThread() {
+  std::thread *vacuum_thread;
+  {
+    std::lock_guard<std::mutex> guard(vacuum_latch_);
+    if (vacuum_thread_ == nullptr)
+      return;
+    vacuum_running_ = false;
+    vacuum_thread = vacuum_thread_;
+    vacuum_thread_ = nullptr;
+  }
+  vacuum_cv_.notify_all();
+  vacuum_thread->join();
+  delete vacuum_thread;
+}
+
+void TransactionManager::VacuumThread(std::chrono::milliseconds interval) {
+  std::unique_lock<std::mutex> lock(vacuum_latch_);
+  while (vacuum_running_) {
+    if (vacuum_cv_.wait_for(lock, interval, [&] { return !vacuum_running_; }))
+      break;
+    lock.unlock();
+    Vacuum();
+    lock.lock();
+  }
+}
+
+// the caller holds the snapshot latch
+void TransactionManager::RemoveSnapshot(Transaction *txn) {
+  auto snapshot = snapshots_.find(txn->GetReadTimestamp());
+  if (snapshot != snapshots_.end())
+    snapshots_.erase(snapshot);
+}
+
+void TransactionManager::RemoveActiveTransaction(Transaction *txn) {
+  std::lock_guard<std::mutex> lck(active_latch_);
+  active_txns_.erase(txn->GetTransactionId());
+}
+
+// a read-only transaction holds no locks and wrote nothing
+void TransactionManager::EndReadOnly(Transaction *txn,
+                                     TransactionState state) {
+  txn->SetState(state);
+  if (txn->GetVersionStore() != nullptr) {
+    std::lock_guard<std::mutex> lck(snapshot_latch_);
+    RemoveSnapshot(txn);
+  }
 }
 
 void TransactionManager::Abort(Transaction *txn) {
+  if (txn->IsReadOnly()) {
+    EndReadOnly(txn, TransactionState::ABORTED);
+    return;
+  }
+  // the buffered writes of an optimistic transaction never reached the pages
+  if (txn->IsOptimistic()) {
+    auto write_set = txn->GetWriteSet();
+    WriteSet writes;
+    writes.swap(*write_set);
+    for (auto &item : writes) {
+      if (item.wtype_ == WType::INSERT)
+        write_set->push_back(item);
+    }
+  }
+  Rollback(txn);
+}
+
+// undo the write set of txn and release what it holds
+void TransactionManager::Rollback(Transaction *txn) {
   txn->SetState(TransactionState::ABORTED);
   // rollback before releasing lock
   auto write_set = txn->GetWriteSet();
@@ -69,9 +304,19 @@ void TransactionManager::Abort(Transaction *txn) {
     write_set->pop_back();
   }
   write_set->clear();
+  // the pages hold the old versions again
+  if (txn->GetVersionStore() != nullptr) {
+    version_store_.Abort(txn);
+    std::lock_guard<std::mutex> lck(snapshot_latch_);
+    RemoveSnapshot(txn);
+  }
 
   if (ENABLE_LOGGING) {
-    // TODO: write log and update transaction's prev_lsn here
+    // an aborted transaction does not need to wait for its record
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(),
+                         LogRecordType::ABORT);
+    txn->SetPrevLSN(log_manager_->AppendLogRecord(log_record));
+    RemoveActiveTransaction(txn);
   }
 
   // release all the lock
@@ -84,5 +329,15 @@ void TransactionManager::Abort(Transaction *txn) {
   for (auto locked_rid : lock_set) {
     lock_manager_->Unlock(txn, locked_rid);
   }
+  // then the table locks they were taken under
+  std::vector<page_id_t> tables;
+  for (auto item : *txn->GetTableLockSet())
+    tables.push_back(item.first);
+  for (auto table_id : tables) {
+    lock_manager_->UnlockTable(txn, table_id);
+  }
+  // a reader of a word it held saw it locked, the versions stay
+  if (txn->IsOptimistic())
+    tuple_versions_.Unlock(txn, false);
 }
 } // namespace scudb
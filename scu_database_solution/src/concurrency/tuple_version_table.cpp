@@ -0,0 +1,86 @@
+/**
+ * tuple_version_table.cpp
+ */
+
+#include <algorithm>
+#include <thread>
+
+#include "concurrency/tuple_version_table.h"
+
+namespace scudb {
+
+/*
+ * The number of words is rounded up to a power of two, a word is picked by
+ * the high bits of a multiplicative hash of the RID
+ */
+TupleVersionTable::TupleVersionTable(int num_words) : shift_(64) {
+  int words = 1;
+  while (words < num_words) {
+    words <<= 1;
+    shift_--;
+  }
+  // a shift of 64 is undefined, a single word uses the top bit of a hash of
+  // at most 63 bits
+  if (shift_ == 64)
+    shift_ = 63;
+  words_.reset(new std::atomic<uint64_t>[words]);
+  for (int i = 0; i < words; i++)
+    words_[i] = 0;
+}
+
+/*
+ * Words are locked in increasing order, so two committing transactions never
+ * wait for each other in a circle. A word locked at insert time is out of
+ * order, hence the bounded spinning.
+ */
+bool TupleVersionTable::Lock(Transaction *txn, const std::vector<RID> &rids) {
+  std::vector<size_t> slots;
+  for (const RID &rid : rids)
+    slots.push_back(Slot(rid));
+  std::sort(slots.begin(), slots.end());
+  slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+  auto locked = txn->GetVersionLockSet();
+  for (size_t slot : slots) {
+    if (locked->find(slot) != locked->end())
+      continue;
+    for (int spins = 0;; spins++) {
+      uint64_t word = words_[slot].load() & ~LOCKED;
+      if (words_[slot].compare_exchange_weak(word, word | LOCKED))
+        break;
+      if (spins == LOCK_SPINS)
+        return false;
+      std::this_thread::yield();
+    }
+    locked->insert(slot);
+  }
+  return true;
+}
+
+/*
+ * A word read while another transaction held it may have been read in the
+ * middle of a write, it only validates if txn holds it now
+ */
+bool TupleVersionTable::Validate(Transaction *txn) {
+  auto locked = txn->GetVersionLockSet();
+  for (auto &read : *txn->GetReadSet()) {
+    size_t slot = Slot(read.first);
+    bool own = locked->find(slot) != locked->end();
+    uint64_t word = words_[slot].load();
+    if ((word & ~LOCKED) != (read.second & ~LOCKED))
+      return false;
+    if (!own && ((word & LOCKED) || (read.second & LOCKED)))
+      return false;
+  }
+  return true;
+}
+
+void TupleVersionTable::Unlock(Transaction *txn, bool wrote) {
+  auto locked = txn->GetVersionLockSet();
+  for (size_t slot : *locked) {
+    uint64_t word = words_[slot].load() & ~LOCKED;
+    words_[slot].store(wrote ? word + 1 : word);
+  }
+  locked->clear();
+}
+
+} // namespace scudb
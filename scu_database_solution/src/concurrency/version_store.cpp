@@ -0,0 +1,118 @@
+/**
+ * version_store.cpp
+ */
+
+#include "concurrency/version_store.h"
+
+namespace scudb {
+
+bool VersionStore::AddVersion(Transaction *txn, const RID &rid,
+                              const Tuple *image) {
+  latch_.WLock();
+  auto &chain = chains_[rid];
+  txn_id_t txn_id = txn->GetTransactionId();
+  if (!chain.empty() && chain.front().writer_ == txn_id) {
+    // the version before the first change of txn is saved already
+    latch_.WUnlock();
+    return true;
+  }
+  // first-updater-wins: the tuple changed after the snapshot began
+  bool conflict =
+      !chain.empty() && chain.front().end_ts_ > txn->GetReadTimestamp();
+  TupleVersion version;
+  version.exists_ = image != nullptr;
+  if (image != nullptr)
+    version.tuple_ = *image;
+  // a tuple without a chain is older than every snapshot
+  version.begin_ts_ = chain.empty() ? 0 : chain.front().end_ts_;
+  version.end_ts_ = INT64_MAX;
+  version.writer_ = txn_id;
+  chain.push_front(version);
+  pending_[txn_id].push_back(rid);
+  num_versions_++;
+  latch_.WUnlock();
+  return !conflict;
+}
+
+/*
+ * The newest version is seen if txn wrote it or it was committed before the
+ * snapshot began, otherwise the newest saved version that began before.
+ */
+bool VersionStore::GetVisibleVersion(Transaction *txn, const RID &rid,
+                                     bool exists, Tuple &tuple) {
+  latch_.RLock();
+  auto it = chains_.find(rid);
+  if (it == chains_.end() ||
+      it->second.front().writer_ == txn->GetTransactionId() ||
+      it->second.front().end_ts_ <= txn->GetReadTimestamp()) {
+    latch_.RUnlock();
+    return exists;
+  }
+  bool visible = false;
+  for (const TupleVersion &version : it->second) {
+    if (version.begin_ts_ <= txn->GetReadTimestamp()) {
+      visible = version.exists_;
+      if (visible)
+        tuple.DeserializeFrom(version.tuple_.GetData(),
+                              version.tuple_.GetLength());
+      break;
+    }
+  }
+  latch_.RUnlock();
+  return visible;
+}
+
+void VersionStore::Commit(Transaction *txn, timestamp_t commit_ts) {
+  latch_.WLock();
+  auto pending = pending_.find(txn->GetTransactionId());
+  if (pending != pending_.end()) {
+    for (const RID &rid : pending->second) {
+      TupleVersion &version = chains_[rid].front();
+      version.end_ts_ = commit_ts;
+      version.writer_ = INVALID_TXN_ID;
+    }
+    pending_.erase(pending);
+  }
+  latch_.WUnlock();
+}
+
+void VersionStore::Abort(Transaction *txn) {
+  latch_.WLock();
+  auto pending = pending_.find(txn->GetTransactionId());
+  if (pending != pending_.end()) {
+    for (const RID &rid : pending->second) {
+      auto chain = chains_.find(rid);
+      chain->second.pop_front();
+      num_versions_--;
+      if (chain->second.empty())
+        chains_.erase(chain);
+    }
+    pending_.erase(pending);
+  }
+  latch_.WUnlock();
+}
+
+/*
+ * Versions end in decreasing order along a chain, so the removed ones are at
+ * its tail. A version still replaced by a running transaction never goes.
+ */
+int VersionStore::Vacuum(timestamp_t oldest_ts) {
+  int removed = 0;
+  latch_.WLock();
+  for (auto it = chains_.begin(); it != chains_.end();) {
+    auto &chain = it->second;
+    while (!chain.empty() && chain.back().end_ts_ <= oldest_ts) {
+      chain.pop_back();
+      removed++;
+    }
+    if (chain.empty())
+      it = chains_.erase(it);
+    else
+      ++it;
+  }
+  num_versions_ -= removed;
+  latch_.WUnlock();
+  return removed;
+}
+
+} // namespace scudb
@@ -1,25 +1,38 @@
 /**
  * disk_manager.cpp
  */
+#include <algorithm>
 #include <assert.h>
+#include <cerrno>
+#include <climits>
 #include <cstring>
+#include <fcntl.h>
 #include <iostream>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <thread>
+#include <unistd.h>
 
 #include "common/logger.h"
 #include "disk/disk_manager.h"
 
 namespace scudb {
 
-static char *buffer_used = nullptr;
-
 /**
  * Constructor: open/create a single database file & log file
  * @input db_file: database file name
+ * @input durability: when to fdatasync the log file and the database file
+ * @input read_only: open an existing db file read only and map it into memory,
+ * every write is rejected
  */
-DiskManager::DiskManager(const std::string &db_file)
-    : file_name_(db_file), next_page_id_(0), num_flushes_(0), flush_log_(false),
+DiskManager::DiskManager(const std::string &db_file,
+                         DurabilityLevel durability, bool read_only)
+    : db_fd_(-1), file_name_(db_file), next_page_id_(0),
+      num_flushes_(0), num_page_writes_(0), durability_(durability),
+      num_log_syncs_(0), num_page_syncs_(0), log_written_seq_(0),
+      log_synced_seq_(0), log_syncing_(false), read_only_(read_only),
+      mapped_data_(nullptr), num_mapped_pages_(0), flush_log_(false),
       flush_log_f_(nullptr) {
   std::string::size_type n = file_name_.find(".");
   if (n == std::string::npos) {
@@ -28,89 +41,264 @@ DiskManager::DiskManager(const std::string &db_file)
   }
   log_name_ = file_name_.substr(0, n) + ".log";
 
-  log_io_.open(log_name_,
-               std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-  // directory or file does not exist
-  if (!log_io_.is_open()) {
-    log_io_.clear();
-    // create a new file
-    log_io_.open(log_name_, std::ios::binary | std::ios::trunc | std::ios::app |
-                                std::ios::out);
-    log_io_.close();
-    // reopen with original mode
-    log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app |
-                                std::ios::out);
-  }
-
-  db_io_.open(db_file,
-              std::ios::binary | std::ios::in | std::ios::out | std::ios::out);
-  // directory or file does not exist
-  if (!db_io_.is_open()) {
-    db_io_.clear();
-    // create a new file
-    db_io_.open(db_file, std::ios::binary | std::ios::trunc | std::ios::out);
-    db_io_.close();
-    // reopen with original mode
-    db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
+  // segments of the log are only created once something is appended, the
+  // stripes of a striped log are found by the segments they left behind
+  log_files_.reserve(MAX_LOG_STRIPES);
+  log_files_.push_back(OpenLogFile(0));
+  int num_stripes = 1;
+  for (int stripe = 1; stripe < MAX_LOG_STRIPES; stripe++) {
+    SegmentedLogFile *log_file = OpenLogFile(stripe);
+    if (log_file->GetEndOffset() > 0)
+      num_stripes = stripe + 1;
+    delete log_file;
+  }
+  SetNumLogStripes(num_stripes);
+
+  if (read_only_) {
+    OpenMapping();
+    return;
+  }
+
+  // create the db file if it does not exist
+  db_fd_ = open(db_file.c_str(), O_RDWR | O_CREAT, 0644);
+  if (db_fd_ < 0) {
+    LOG_DEBUG("can't open db file");
+    return;
+  }
+  // pages of an existing db file are never allocated again
+  struct stat stat_buf;
+  if (fstat(db_fd_, &stat_buf) == 0) {
+    next_page_id_ = static_cast<page_id_t>(stat_buf.st_size / PAGE_SIZE);
   }
 }
 
 DiskManager::~DiskManager() {
-  db_io_.close();
-  log_io_.close();
+  if (mapped_data_ != nullptr)
+    munmap(mapped_data_, static_cast<size_t>(num_mapped_pages_) * PAGE_SIZE);
+  if (db_fd_ >= 0)
+    close(db_fd_);
+  for (auto log_file : log_files_)
+    delete log_file;
+}
+
+/**
+ * Private helper for read only mode: open the existing db file without
+ * creating it, and map every whole page of the db file
+ */
+void DiskManager::OpenMapping() {
+  db_fd_ = open(file_name_.c_str(), O_RDONLY);
+  if (db_fd_ < 0) {
+    LOG_DEBUG("can't open db file");
+    return;
+  }
+  struct stat stat_buf;
+  if (fstat(db_fd_, &stat_buf) != 0 || stat_buf.st_size < PAGE_SIZE) {
+    LOG_DEBUG("nothing to map");
+    return;
+  }
+  int num_pages = stat_buf.st_size / PAGE_SIZE;
+  void *addr = mmap(nullptr, static_cast<size_t>(num_pages) * PAGE_SIZE,
+                    PROT_READ, MAP_SHARED, db_fd_, 0);
+  if (addr == MAP_FAILED) {
+    LOG_DEBUG("can't map db file");
+    return;
+  }
+  // mostly scans, let the kernel read ahead aggressively
+  madvise(addr, static_cast<size_t>(num_pages) * PAGE_SIZE, MADV_SEQUENTIAL);
+  mapped_data_ = static_cast<char *>(addr);
+  num_mapped_pages_ = num_pages;
+  next_page_id_ = num_pages;
+}
+
+/**
+ * Return the address of page_id inside the read only mapping,
+ * nullptr if the page is out of the mapped range
+ */
+char *DiskManager::GetMappedPage(page_id_t page_id) {
+  if (mapped_data_ == nullptr || page_id < 0 || page_id >= num_mapped_pages_)
+    return nullptr;
+  return mapped_data_ + static_cast<size_t>(page_id) * PAGE_SIZE;
 }
 
 /**
  * Write the contents of the specified page into disk file
  */
 void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
-  size_t offset = page_id * PAGE_SIZE;
-  // set write cursor to offset
-  db_io_.seekp(offset);
-  db_io_.write(page_data, PAGE_SIZE);
-  // check for I/O error
-  if (db_io_.bad()) {
-    LOG_DEBUG("I/O error while writing");
+  if (read_only_) {
+    LOG_DEBUG("write to read only db file");
     return;
   }
-  // needs to flush to keep disk file in sync
-  db_io_.flush();
+  off_t offset = static_cast<off_t>(page_id) * PAGE_SIZE;
+  size_t written = 0;
+  // positional write, no need to move a shared cursor
+  while (written < PAGE_SIZE) {
+    ssize_t ret = pwrite(db_fd_, page_data + written, PAGE_SIZE - written,
+                         offset + written);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    // check for I/O error
+    if (ret <= 0) {
+      LOG_DEBUG("I/O error while writing");
+      return;
+    }
+    written += ret;
+    num_page_writes_++;
+  }
+  // in FULL mode every page write is durable before returning
+  if (durability_ == DurabilityLevel::FULL) {
+    if (fdatasync(db_fd_) != 0) {
+      LOG_DEBUG("I/O error while syncing");
+    }
+    num_page_syncs_++;
+  }
+}
+
+/**
+ * Make every page written so far durable, e.g. before a checkpoint lets the
+ * log that would redo them go
+ * @return: false if the sync failed
+ */
+bool DiskManager::SyncPages() {
+  if (read_only_)
+    return false;
+  num_page_syncs_++;
+  if (fdatasync(db_fd_) != 0) {
+    LOG_DEBUG("I/O error while syncing");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Write a batch of pages into disk file. Pages are sorted by page id, runs of
+ * adjacent pages are merged into a single pwritev() call, and the data file is
+ * synced once at the end of the batch.
+ * NOTE: the order of the input vector is not preserved
+ * @return: the pages of the runs that failed, every page if the sync failed
+ */
+std::vector<page_id_t> DiskManager::WritePages(
+    std::vector<std::pair<page_id_t, const char *>> &pages) {
+  std::vector<page_id_t> failed;
+  if (read_only_) {
+    LOG_DEBUG("write to read only db file");
+    for (auto &page : pages)
+      failed.push_back(page.first);
+    return failed;
+  }
+  if (pages.empty())
+    return failed;
+  std::sort(pages.begin(), pages.end(),
+            [](const std::pair<page_id_t, const char *> &a,
+               const std::pair<page_id_t, const char *> &b) {
+              return a.first < b.first;
+            });
+
+  std::vector<struct iovec> iov;
+  iov.reserve(std::min<size_t>(pages.size(), IOV_MAX));
+  size_t i = 0;
+  while (i < pages.size()) {
+    // collect a run of adjacent pages, bounded by IOV_MAX
+    size_t run_begin = i;
+    page_id_t first_page_id = pages[i].first;
+    iov.clear();
+    while (i < pages.size() && iov.size() < IOV_MAX &&
+           pages[i].first == first_page_id + (page_id_t)iov.size()) {
+      iov.push_back({const_cast<char *>(pages[i].second), PAGE_SIZE});
+      ++i;
+    }
+    // skip duplicated page ids, the first copy has been written already
+    while (i < pages.size() &&
+           pages[i].first < first_page_id + (page_id_t)iov.size())
+      ++i;
+
+    off_t offset = static_cast<off_t>(first_page_id) * PAGE_SIZE;
+    size_t remain = iov.size() * PAGE_SIZE;
+    struct iovec *cur = iov.data();
+    int count = iov.size();
+    while (remain > 0) {
+      ssize_t ret = pwritev(db_fd_, cur, count, offset);
+      if (ret < 0 && errno == EINTR)
+        continue;
+      if (ret <= 0) {
+        LOG_DEBUG("I/O error while writing");
+        // the run is written in part at most, the next one may still go
+        for (size_t j = run_begin; j < i; j++)
+          failed.push_back(pages[j].first);
+        break;
+      }
+      num_page_writes_++;
+      offset += ret;
+      remain -= ret;
+      // partial write, advance iovec array
+      while (count > 0 && (size_t)ret >= cur->iov_len) {
+        ret -= cur->iov_len;
+        ++cur;
+        --count;
+      }
+      if (count > 0) {
+        cur->iov_base = static_cast<char *>(cur->iov_base) + ret;
+        cur->iov_len -= ret;
+      }
+    }
+  }
+  // one sync for the whole batch
+  if (durability_ != DurabilityLevel::NONE) {
+    if (fdatasync(db_fd_) != 0) {
+      LOG_DEBUG("I/O error while syncing");
+      failed.clear();
+      for (auto &page : pages)
+        failed.push_back(page.first);
+    }
+    num_page_syncs_++;
+  }
+  return failed;
 }
 
 /**
  * Read the contents of the specified page into the given memory area
  */
 void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
-  int offset = page_id * PAGE_SIZE;
+  off_t offset = static_cast<off_t>(page_id) * PAGE_SIZE;
+  ssize_t read_count = 0;
+  while (read_count < PAGE_SIZE) {
+    ssize_t ret = pread(db_fd_, page_data + read_count, PAGE_SIZE - read_count,
+                        offset + read_count);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      break;
+    read_count += ret;
+  }
   // check if read beyond file length
-  if (offset > GetFileSize(file_name_)) {
+  if (read_count == 0) {
     LOG_DEBUG("I/O error while reading");
     // std::cerr << "I/O error while reading" << std::endl;
-  } else {
-    // set read cursor to offset
-    db_io_.seekp(offset);
-    db_io_.read(page_data, PAGE_SIZE);
+  } else if (read_count < PAGE_SIZE) {
     // if file ends before reading PAGE_SIZE
-    int read_count = db_io_.gcount();
-    if (read_count < PAGE_SIZE) {
-      LOG_DEBUG("Read less than a page");
-      // std::cerr << "Read less than a page" << std::endl;
-      memset(page_data + read_count, 0, PAGE_SIZE - read_count);
-    }
+    LOG_DEBUG("Read less than a page");
+    // std::cerr << "Read less than a page" << std::endl;
   }
+  memset(page_data + read_count, 0, PAGE_SIZE - read_count);
 }
 
 /**
  * Write the contents of the log into disk file
  * Only return when sync is done, and only perform sequence write
+ * NONE: return once the data is handed to the OS
+ * GROUP: concurrent writers share a single fdatasync
+ * FULL: every call issues its own fdatasync
+ * @return: false if the data is not durable, nothing past the previous end of
+ * the log may be trusted then
  */
-void DiskManager::WriteLog(char *log_data, int size) {
-  // enforce swap log buffer
-  assert(log_data != buffer_used);
-  buffer_used = log_data;
-
+bool DiskManager::WriteLog(char *log_data, int size, int stripe) {
   if (size == 0) // no effect on num_flushes_ if log buffer is empty
-    return;
+    return true;
+  if (read_only_) {
+    LOG_DEBUG("write to read only log file");
+    return false;
+  }
+  if (log_failed_)
+    return false;
 
   flush_log_ = true;
 
@@ -120,40 +308,148 @@ void DiskManager::WriteLog(char *log_data, int size) {
            std::future_status::ready);
 
   num_flushes_ += 1;
-  // sequence write
-  log_io_.write(log_data, size);
+  // sequence write into the preallocated segments
+  SegmentedLogFile *log_file = GetLogFile(stripe);
+  if (log_file == nullptr || !log_file->Append(log_data, size)) {
+    // an append is retried, unless a segment failed to sync
+    if (log_file != nullptr && log_file->IsFailed())
+      log_failed_ = true;
+    flush_log_ = false;
+    return false;
+  }
 
-  // check for I/O error
-  if (log_io_.bad()) {
-    LOG_DEBUG("I/O error while writing log");
-    return;
+  // the flush thread of a stripe is its only writer, a stripe other than the
+  // first has nobody to share its sync with
+  bool synced = true;
+  if (durability_ == DurabilityLevel::FULL ||
+      (durability_ == DurabilityLevel::GROUP && stripe > 0)) {
+    synced = log_file->Sync();
+    num_log_syncs_++;
+    if (!synced)
+      log_failed_ = true;
+  } else if (durability_ == DurabilityLevel::GROUP) {
+    uint64_t write_seq;
+    {
+      std::lock_guard<std::mutex> guard(sync_latch_);
+      write_seq = ++log_written_seq_;
+    }
+    synced = SyncLog(write_seq);
   }
-  // needs to flush to keep disk file in sync
-  log_io_.flush();
   flush_log_ = false;
+  return synced;
+}
+
+/**
+ * Private helper for GROUP durability: wait until the log write with sequence
+ * number write_seq is synced. The first waiter becomes the leader and syncs on
+ * behalf of every write that has completed so far, the others just wait.
+ * @return: false if the sync covering write_seq failed
+ */
+bool DiskManager::SyncLog(uint64_t write_seq) {
+  std::unique_lock<std::mutex> lock(sync_latch_);
+  while (log_synced_seq_ < write_seq) {
+    if (log_failed_)
+      return false;
+    if (log_syncing_) {
+      sync_cv_.wait(lock);
+      continue;
+    }
+    log_syncing_ = true;
+    uint64_t target = log_written_seq_;
+    lock.unlock();
+    bool synced = log_files_[0]->Sync();
+    num_log_syncs_++;
+    lock.lock();
+    log_syncing_ = false;
+    if (synced)
+      log_synced_seq_ = std::max(log_synced_seq_, target);
+    else
+      log_failed_ = true;
+    sync_cv_.notify_all();
+  }
+  return true;
 }
 
 /**
  * Read the contents of the log into the given memory area
- * Always read from the beginning and perform sequence read
+ * Perform sequence read from a logical offset of the log, the tail of a
+ * segment written before a restart reads as zeros
  * @return: false means already reach the end
  */
-bool DiskManager::ReadLog(char *log_data, int size, int offset) {
-  if (offset >= GetFileSize(log_name_)) {
-    // LOG_DEBUG("end of log file");
-    // LOG_DEBUG("file size is %d", GetFileSize(log_name_));
+bool DiskManager::ReadLog(char *log_data, int size, int64_t offset,
+                          int stripe) {
+  SegmentedLogFile *log_file = GetLogFile(stripe);
+  if (log_file == nullptr)
     return false;
-  }
-  log_io_.seekp(offset);
-  log_io_.read(log_data, size);
-  // if log file ends before reading "size"
-  int read_count = log_io_.gcount();
-  if (read_count < size) {
-    log_io_.clear();
-    memset(log_data + read_count, 0, size - read_count);
-  }
+  return log_file->Read(log_data, size, offset);
+}
 
-  return true;
+/**
+ * Segments entirely below offset are no longer needed for recovery, e.g.
+ * because a checkpoint flushed every page they describe
+ */
+void DiskManager::RecycleLog(int64_t offset, int stripe) {
+  SegmentedLogFile *log_file = GetLogFile(stripe);
+  if (log_file != nullptr && !read_only_)
+    log_file->Recycle(offset);
+}
+
+bool DiskManager::TruncateLog(int64_t offset, int stripe) {
+  SegmentedLogFile *log_file = GetLogFile(stripe);
+  if (log_file == nullptr || read_only_)
+    return false;
+  return log_file->Truncate(offset);
+}
+
+/**
+ * Returns the first log offset that can still be read
+ */
+int64_t DiskManager::GetLogStartOffset(int stripe) {
+  SegmentedLogFile *log_file = GetLogFile(stripe);
+  return log_file == nullptr ? 0 : log_file->GetStartOffset();
+}
+
+/**
+ * Returns the logical offset the next log write goes to
+ */
+int64_t DiskManager::GetLogEndOffset(int stripe) {
+  SegmentedLogFile *log_file = GetLogFile(stripe);
+  return log_file == nullptr ? 0 : log_file->GetEndOffset();
+}
+
+/**
+ * Open the log files of the stripes below num_stripes that are not open yet.
+ * Stripes are only added, the log manager sets them up before it writes.
+ */
+void DiskManager::SetNumLogStripes(int num_stripes) {
+  std::lock_guard<std::mutex> guard(stripes_latch_);
+  if (log_files_.empty())
+    return;
+  num_stripes = std::min(num_stripes, MAX_LOG_STRIPES);
+  for (int stripe = log_files_.size(); stripe < num_stripes; stripe++)
+    log_files_.push_back(OpenLogFile(stripe));
+}
+
+/**
+ * Private helper: the log file of stripe, nullptr if there is none
+ */
+SegmentedLogFile *DiskManager::GetLogFile(int stripe) {
+  if (stripe < 0 || stripe >= static_cast<int>(log_files_.size()))
+    return nullptr;
+  return log_files_[stripe];
+}
+
+/**
+ * Private helper: open the log file of stripe, stripe 0 is named after the
+ * db file and stripe k > 0 gets a -k suffix
+ */
+SegmentedLogFile *DiskManager::OpenLogFile(int stripe) {
+  std::string name = log_name_;
+  if (stripe > 0)
+    name += "-" + std::to_string(stripe);
+  auto log_file = new SegmentedLogFile(name);
+  log_file->Open(durability_ != DurabilityLevel::NONE);
+  return log_file;
 }
 
 /**
@@ -162,6 +458,13 @@ bool DiskManager::ReadLog(char *log_data, int size, int offset) {
  */
 page_id_t DiskManager::AllocatePage() { return next_page_id_++; }
 
+void DiskManager::ReservePage(page_id_t page_id) {
+  page_id_t next = next_page_id_;
+  while (next <= page_id &&
+         !next_page_id_.compare_exchange_weak(next, page_id + 1)) {
+  }
+}
+
 /**
  * Deallocate page (operations like drop index/table)
  * Need bitmap in header page for tracking pages
@@ -176,17 +479,23 @@ void DiskManager::DeallocatePage(__attribute__((unused)) page_id_t page_id) {
 int DiskManager::GetNumFlushes() const { return num_flushes_; }
 
 /**
- * Returns true if the log is currently being flushed
+ * Returns number of write system calls issued against the db file so far
  */
-bool DiskManager::GetFlushState() const { return flush_log_; }
+int DiskManager::GetNumPageWrites() const { return num_page_writes_; }
 
 /**
- * Private helper function to get disk file size
+ * Returns number of fdatasync calls issued against the log file so far
  */
-int DiskManager::GetFileSize(const std::string &file_name) {
-  struct stat stat_buf;
-  int rc = stat(file_name.c_str(), &stat_buf);
-  return rc == 0 ? stat_buf.st_size : -1;
-}
+int DiskManager::GetNumLogSyncs() const { return num_log_syncs_; }
+
+/**
+ * Returns number of fdatasync calls issued against the db file so far
+ */
+int DiskManager::GetNumPageSyncs() const { return num_page_syncs_; }
+
+/**
+ * Returns true if the log is currently being flushed
+ */
+bool DiskManager::GetFlushState() const { return flush_log_; }
 
 } // namespace scudb
@@ -0,0 +1,465 @@
+/**
+ * log_file.cpp
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "common/logger.h"
+#include "disk/log_file.h"
+
+namespace scudb {
+
+// split a path into its directory and file name
+static void SplitPath(const std::string &name, std::string &dir,
+                      std::string &base) {
+  std::string::size_type n = name.rfind('/');
+  dir = (n == std::string::npos) ? "." : name.substr(0, n);
+  base = (n == std::string::npos) ? name : name.substr(n + 1);
+}
+
+// parse a non-negative number that makes up the whole string
+static bool ParseNumber(const std::string &str, int64_t &number) {
+  if (str.empty() || str.size() > 18)
+    return false;
+  number = 0;
+  for (char c : str) {
+    if (c < '0' || c > '9')
+      return false;
+    number = number * 10 + (c - '0');
+  }
+  return true;
+}
+
+SegmentedLogFile::SegmentedLogFile(const std::string &name,
+                                   int64_t segment_size)
+    : name_(name), segment_size_(segment_size), sync_on_switch_(true),
+      start_offset_(0), end_offset_(0), cur_seq_(-1), cur_fd_(-1),
+      next_seq_(-1), num_segments_created_(0), num_segments_reused_(0) {}
+
+SegmentedLogFile::~SegmentedLogFile() {
+  // an unused prepared segment becomes a spare, so a restart does not skip it
+  if (next_fd_.valid()) {
+    int fd = next_fd_.get();
+    if (fd >= 0) {
+      close(fd);
+      std::lock_guard<std::mutex> guard(spare_latch_);
+      int spare = 0;
+      while (std::find(spares_.begin(), spares_.end(), spare) != spares_.end())
+        spare++;
+      if (rename(SegmentName(next_seq_).c_str(), SpareName(spare).c_str()) ==
+          0) {
+        spares_.push_back(spare);
+        SyncDirectory();
+      }
+    }
+  }
+  for (auto &entry : fds_) {
+    close(entry.second);
+  }
+}
+
+/**
+ * Find the segments and spares left by a previous run. Appends start in the
+ * segment after the last existing one.
+ */
+void SegmentedLogFile::Open(bool sync_on_switch) {
+  std::lock_guard<std::mutex> guard(latch_);
+  sync_on_switch_ = sync_on_switch;
+  std::string dir, base;
+  SplitPath(name_, dir, base);
+  DIR *dp = opendir(dir.c_str());
+  if (dp == nullptr) {
+    LOG_DEBUG("can't open log directory");
+    return;
+  }
+  std::string seg_prefix = base + ".";
+  std::string spare_prefix = base + ".spare.";
+  while (struct dirent *entry = readdir(dp)) {
+    std::string file(entry->d_name);
+    int64_t number;
+    if (file.compare(0, spare_prefix.size(), spare_prefix) == 0) {
+      if (ParseNumber(file.substr(spare_prefix.size()), number)) {
+        std::lock_guard<std::mutex> spare_guard(spare_latch_);
+        spares_.push_back(static_cast<int>(number));
+      }
+    } else if (file.compare(0, seg_prefix.size(), seg_prefix) == 0) {
+      if (ParseNumber(file.substr(seg_prefix.size()), number))
+        segments_.insert(number);
+    }
+  }
+  closedir(dp);
+  if (!segments_.empty()) {
+    start_offset_ = *segments_.begin() * segment_size_;
+    end_offset_ = (*segments_.rbegin() + 1) * segment_size_;
+  }
+}
+
+/**
+ * Append at the end of the log with positional writes, crossing into the next
+ * segment when the current one is full. A failed append leaves the end where
+ * it was, a retry writes over the part that went through. Once a sync failed
+ * every append fails.
+ */
+bool SegmentedLogFile::Append(const char *data, int size) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (sync_failed_)
+    return false;
+  int64_t begin_offset = end_offset_;
+  int written = 0;
+  while (written < size) {
+    int64_t seq = end_offset_ / segment_size_;
+    int64_t in_segment = end_offset_ % segment_size_;
+    if (seq != cur_seq_ && !SwitchSegment(seq)) {
+      end_offset_ = begin_offset;
+      return false;
+    }
+    int count = static_cast<int>(
+        std::min<int64_t>(size - written, segment_size_ - in_segment));
+    ssize_t ret = pwrite(cur_fd_, data + written, count, in_segment);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    // check for I/O error
+    if (ret <= 0) {
+      LOG_DEBUG("I/O error while writing log");
+      end_offset_ = begin_offset;
+      return false;
+    }
+    written += ret;
+    end_offset_ += ret;
+  }
+  return true;
+}
+
+/**
+ * Read from the segments covering [offset, offset + size). Recycled segments
+ * and everything beyond the end of the log read as zeros.
+ */
+bool SegmentedLogFile::Read(char *data, int size, int64_t offset) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (offset >= end_offset_)
+    return false;
+  int read_count = 0;
+  while (read_count < size && offset + read_count < end_offset_) {
+    int64_t pos = offset + read_count;
+    int64_t seq = pos / segment_size_;
+    int64_t in_segment = pos % segment_size_;
+    int count = static_cast<int>(std::min<int64_t>(
+        {size - read_count, segment_size_ - in_segment, end_offset_ - pos}));
+    int fd = GetSegmentFd(seq);
+    ssize_t ret = 0;
+    if (fd >= 0) {
+      ret = pread(fd, data + read_count, count, in_segment);
+      if (ret < 0 && errno == EINTR)
+        continue;
+    }
+    if (ret <= 0) {
+      memset(data + read_count, 0, count);
+      ret = count;
+    }
+    read_count += ret;
+  }
+  // if log ends before reading "size"
+  if (read_count < size)
+    memset(data + read_count, 0, size - read_count);
+  return true;
+}
+
+/**
+ * Earlier segments were synced when the log moved past them, so syncing the
+ * current segment makes everything appended so far durable
+ */
+bool SegmentedLogFile::Sync() {
+  if (sync_failed_)
+    return false;
+  int fd = cur_fd_;
+  if (fd < 0)
+    return true;
+  if (fdatasync(fd) != 0) {
+    LOG_DEBUG("I/O error while syncing log");
+    sync_failed_ = true;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Segments entirely below offset are no longer needed for recovery. Keep up
+ * to LOG_SEGMENT_SPARES of them zeroed for reuse and delete the others.
+ */
+void SegmentedLogFile::Recycle(int64_t offset) {
+  std::lock_guard<std::mutex> guard(latch_);
+  bool recycled = false;
+  while (!segments_.empty()) {
+    int64_t seq = *segments_.begin();
+    if ((seq + 1) * segment_size_ > std::min(offset, end_offset_) ||
+        seq == cur_seq_)
+      break;
+    segments_.erase(segments_.begin());
+    recycled = true;
+    int fd = GetSegmentFd(seq);
+    fds_.erase(seq);
+    std::lock_guard<std::mutex> spare_guard(spare_latch_);
+    if (fd >= 0 && static_cast<int>(spares_.size()) < LOG_SEGMENT_SPARES &&
+        ZeroFill(fd, 0, segment_size_)) {
+      int spare = 0;
+      while (std::find(spares_.begin(), spares_.end(), spare) != spares_.end())
+        spare++;
+      if (rename(SegmentName(seq).c_str(), SpareName(spare).c_str()) == 0) {
+        spares_.push_back(spare);
+        close(fd);
+        continue;
+      }
+    }
+    if (fd >= 0)
+      close(fd);
+    unlink(SegmentName(seq).c_str());
+  }
+  // a rename lost in a crash would bring back a segment that looks live
+  if (recycled && !SyncDirectory()) {
+    LOG_DEBUG("I/O error while syncing log directory");
+  }
+  start_offset_ = segments_.empty() ? end_offset_
+                                    : *segments_.begin() * segment_size_;
+}
+
+/**
+ * Drop the log from offset on, e.g. the torn record a crash left at its end.
+ * The rest of the segment at offset is zeroed, the segments after it are
+ * deleted and appends go on at offset, so a later recovery finds what is
+ * appended next right behind the valid records, with no torn record between.
+ */
+bool SegmentedLogFile::Truncate(int64_t offset) {
+  std::lock_guard<std::mutex> guard(latch_);
+  offset = std::max(offset, start_offset_);
+  if (offset >= end_offset_)
+    return true;
+  // the segment prepared ahead lies past offset as well
+  if (next_fd_.valid()) {
+    int unused = next_fd_.get();
+    if (unused >= 0) {
+      close(unused);
+      unlink(SegmentName(next_seq_).c_str());
+    }
+  }
+  next_seq_ = -1;
+  int64_t seq = offset / segment_size_;
+  while (!segments_.empty() && *segments_.rbegin() > seq) {
+    int64_t last = *segments_.rbegin();
+    segments_.erase(last);
+    auto it = fds_.find(last);
+    if (it != fds_.end()) {
+      close(it->second);
+      fds_.erase(it);
+    }
+    unlink(SegmentName(last).c_str());
+  }
+  bool truncated = true;
+  int fd = GetSegmentFd(seq);
+  if (fd >= 0) {
+    truncated = ZeroFill(fd, offset % segment_size_, segment_size_) &&
+                fdatasync(fd) == 0;
+  }
+  truncated = SyncDirectory() && truncated;
+  if (!truncated) {
+    LOG_DEBUG("I/O error while truncating log");
+  }
+  cur_seq_ = fd >= 0 ? seq : -1;
+  cur_fd_ = fd;
+  end_offset_ = offset;
+  if (segments_.empty())
+    start_offset_ = end_offset_;
+  return truncated;
+}
+
+int64_t SegmentedLogFile::GetStartOffset() {
+  std::lock_guard<std::mutex> guard(latch_);
+  return start_offset_;
+}
+
+int64_t SegmentedLogFile::GetEndOffset() {
+  std::lock_guard<std::mutex> guard(latch_);
+  return end_offset_;
+}
+
+void SegmentedLogFile::Remove(const std::string &name) {
+  std::string dir, base;
+  SplitPath(name, dir, base);
+  DIR *dp = opendir(dir.c_str());
+  if (dp == nullptr)
+    return;
+  std::vector<std::string> files;
+  while (struct dirent *entry = readdir(dp)) {
+    std::string file(entry->d_name);
+    std::string rest = file.substr(std::min(file.size(), base.size() + 1));
+    int64_t number;
+    if (file.compare(0, base.size() + 1, base + ".") != 0)
+      continue;
+    if (ParseNumber(rest, number) ||
+        (rest.compare(0, 6, "spare.") == 0 &&
+         ParseNumber(rest.substr(6), number)))
+      files.push_back(dir + "/" + file);
+  }
+  closedir(dp);
+  for (auto &file : files) {
+    unlink(file.c_str());
+  }
+}
+
+std::string SegmentedLogFile::SegmentName(int64_t seq) const {
+  return name_ + "." + std::to_string(seq);
+}
+
+std::string SegmentedLogFile::SpareName(int spare) const {
+  return name_ + ".spare." + std::to_string(spare);
+}
+
+/**
+ * Private helper: make segment seq ready for writing, preferably by renaming
+ * a spare into place. Runs in the background, so it only touches spares.
+ */
+int SegmentedLogFile::PrepareSegment(int64_t seq) {
+  std::string segment_name = SegmentName(seq);
+  {
+    std::lock_guard<std::mutex> guard(spare_latch_);
+    if (!spares_.empty()) {
+      int spare = spares_.back();
+      spares_.pop_back();
+      if (rename(SpareName(spare).c_str(), segment_name.c_str()) == 0) {
+        int fd = open(segment_name.c_str(), O_RDWR);
+        if (fd >= 0 && SyncDirectory()) {
+          num_segments_reused_++;
+          return fd;
+        }
+        if (fd >= 0)
+          close(fd);
+        LOG_DEBUG("can't make reused log segment durable");
+        return -1;
+      }
+    }
+  }
+  int fd = open(segment_name.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    LOG_DEBUG("can't open log segment");
+    return -1;
+  }
+  if (!Preallocate(fd, segment_size_)) {
+    LOG_DEBUG("can't preallocate log segment");
+  }
+  // the name must survive a crash before anything synced in the segment does
+  if (fsync(fd) != 0 || !SyncDirectory()) {
+    LOG_DEBUG("can't make new log segment durable");
+    close(fd);
+    return -1;
+  }
+  num_segments_created_++;
+  return fd;
+}
+
+/**
+ * Private helper: descriptor of an existing segment, opened on demand.
+ * Caller holds latch_.
+ */
+int SegmentedLogFile::GetSegmentFd(int64_t seq) {
+  auto it = fds_.find(seq);
+  if (it != fds_.end())
+    return it->second;
+  if (segments_.find(seq) == segments_.end())
+    return -1;
+  int fd = open(SegmentName(seq).c_str(), O_RDWR);
+  if (fd < 0)
+    fd = open(SegmentName(seq).c_str(), O_RDONLY);
+  if (fd >= 0)
+    fds_[seq] = fd;
+  return fd;
+}
+
+/**
+ * Private helper: move appends to segment seq. The segment we leave is synced
+ * first, then the one after seq starts being prepared. Caller holds latch_.
+ */
+bool SegmentedLogFile::SwitchSegment(int64_t seq) {
+  // Sync only covers the current segment, the one left behind must be
+  // durable before the log moves on
+  if (cur_fd_ >= 0 && sync_on_switch_ && fdatasync(cur_fd_) != 0) {
+    LOG_DEBUG("I/O error while syncing log");
+    sync_failed_ = true;
+    return false;
+  }
+  int fd;
+  if (next_fd_.valid() && next_seq_ == seq) {
+    fd = next_fd_.get();
+  } else {
+    if (next_fd_.valid()) {
+      int unused = next_fd_.get();
+      if (unused >= 0)
+        close(unused);
+      unlink(SegmentName(next_seq_).c_str());
+    }
+    fd = PrepareSegment(seq);
+  }
+  // the segment prepared ahead failed, the error may have gone by now
+  if (fd < 0)
+    fd = PrepareSegment(seq);
+  if (fd < 0)
+    return false;
+  fds_[seq] = fd;
+  segments_.insert(seq);
+  cur_seq_ = seq;
+  cur_fd_ = fd;
+  next_seq_ = seq + 1;
+  next_fd_ = std::async(std::launch::async, &SegmentedLogFile::PrepareSegment,
+                        this, next_seq_);
+  return true;
+}
+
+/**
+ * Private helper: fsync the directory of the log, which makes the creates and
+ * renames of segments and spares in it durable
+ */
+bool SegmentedLogFile::SyncDirectory() const {
+  std::string dir, base;
+  SplitPath(name_, dir, base);
+  int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0)
+    return false;
+  int ret;
+  do {
+    ret = fsync(fd);
+  } while (ret != 0 && errno == EINTR);
+  close(fd);
+  return ret == 0;
+}
+
+bool SegmentedLogFile::Preallocate(int fd, int64_t size) {
+  if (fallocate(fd, 0, 0, size) == 0)
+    return true;
+  // file system without fallocate, fall back to writing zeros
+  return ZeroFill(fd, 0, size);
+}
+
+// zero the bytes [begin, end) of a file
+bool SegmentedLogFile::ZeroFill(int fd, int64_t begin, int64_t end) {
+#ifdef FALLOC_FL_ZERO_RANGE
+  // keeps the blocks allocated, only marks them as zero
+  if (fallocate(fd, FALLOC_FL_ZERO_RANGE, begin, end - begin) == 0)
+    return true;
+#endif
+  std::vector<char> zeros(PAGE_SIZE * 8, 0);
+  for (int64_t offset = begin; offset < end;) {
+    int count = static_cast<int>(
+        std::min<int64_t>(zeros.size(), end - offset));
+    ssize_t ret = pwrite(fd, zeros.data(), count, offset);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      return false;
+    offset += ret;
+  }
+  return true;
+}
+
+} // namespace scudb
@@ -0,0 +1,217 @@
+/**
+ * simulated_disk_manager.cpp
+ */
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "common/logger.h"
+#include "disk/simulated_disk_manager.h"
+
+namespace scudb {
+
+/**
+ * Constructor: the base DiskManager still opens the db file and the log file,
+ * pages only go to the db file when options.in_memory is false
+ */
+SimulatedDiskManager::SimulatedDiskManager(const std::string &db_file,
+                                           const SimulatedDiskOptions &options,
+                                           DurabilityLevel durability)
+    : DiskManager(db_file, durability), options_(options), rng_(options.seed),
+      read_busy_until_(std::chrono::steady_clock::now()),
+      write_busy_until_(std::chrono::steady_clock::now()), in_flight_(0),
+      num_reads_(0), num_writes_(0), num_short_reads_(0), num_io_errors_(0),
+      max_queue_depth_(0), total_delay_us_(0) {}
+
+SimulatedDiskManager::~SimulatedDiskManager() {}
+
+/**
+ * Write the contents of the specified page, an injected error drops the write
+ */
+void SimulatedDiskManager::WritePage(page_id_t page_id,
+                                     const char *page_data) {
+  num_writes_++;
+  if (!SimulateIO(IOType::WRITE, PAGE_SIZE, true)) {
+    LOG_DEBUG("injected I/O error while writing");
+    return;
+  }
+  if (!options_.in_memory) {
+    DiskManager::WritePage(page_id, page_data);
+    return;
+  }
+  std::lock_guard<std::mutex> guard(pages_latch_);
+  pages_[page_id].assign(page_data, page_data + PAGE_SIZE);
+}
+
+/**
+ * Read the contents of the specified page. Like DiskManager, an I/O error
+ * leaves a zeroed page and a short read zero-fills the rest of the page
+ */
+void SimulatedDiskManager::ReadPage(page_id_t page_id, char *page_data) {
+  num_reads_++;
+  if (!SimulateIO(IOType::READ, PAGE_SIZE, true)) {
+    LOG_DEBUG("injected I/O error while reading");
+    memset(page_data, 0, PAGE_SIZE);
+    return;
+  }
+  if (!options_.in_memory) {
+    DiskManager::ReadPage(page_id, page_data);
+  } else {
+    std::lock_guard<std::mutex> guard(pages_latch_);
+    auto it = pages_.find(page_id);
+    if (it == pages_.end()) {
+      memset(page_data, 0, PAGE_SIZE);
+    } else {
+      memcpy(page_data, it->second.data(), PAGE_SIZE);
+    }
+  }
+  if (Chance(options_.short_read_rate)) {
+    int read_count;
+    {
+      std::lock_guard<std::mutex> guard(rng_latch_);
+      read_count = std::uniform_int_distribution<int>(0, PAGE_SIZE - 1)(rng_);
+    }
+    num_short_reads_++;
+    LOG_DEBUG("Read less than a page");
+    memset(page_data + read_count, 0, PAGE_SIZE - read_count);
+  }
+}
+
+/**
+ * A batch reaches the device as one request, an injected error drops it all
+ */
+std::vector<page_id_t> SimulatedDiskManager::WritePages(
+    std::vector<std::pair<page_id_t, const char *>> &pages) {
+  std::vector<page_id_t> failed;
+  if (pages.empty())
+    return failed;
+  num_writes_++;
+  if (!SimulateIO(IOType::WRITE, pages.size() * PAGE_SIZE, true)) {
+    LOG_DEBUG("injected I/O error while writing");
+    for (auto &page : pages)
+      failed.push_back(page.first);
+    return failed;
+  }
+  if (!options_.in_memory)
+    return DiskManager::WritePages(pages);
+  std::lock_guard<std::mutex> guard(pages_latch_);
+  for (auto &page : pages) {
+    pages_[page.first].assign(page.second, page.second + PAGE_SIZE);
+  }
+  return failed;
+}
+
+/**
+ * Log writes are delayed by the device. An injected error fails the log for
+ * good, as a failed sync does, so nothing written later is acknowledged
+ */
+bool SimulatedDiskManager::WriteLog(char *log_data, int size, int stripe) {
+  if (size > 0) {
+    SimulateIO(IOType::WRITE, size, false);
+    if (Chance(options_.log_error_rate)) {
+      num_io_errors_++;
+      LOG_DEBUG("injected I/O error while writing the log");
+      FailLog();
+      return false;
+    }
+  }
+  return DiskManager::WriteLog(log_data, size, stripe);
+}
+
+bool SimulatedDiskManager::ReadLog(char *log_data, int size, int64_t offset,
+                                   int stripe) {
+  SimulateIO(IOType::READ, size, false);
+  return DiskManager::ReadLog(log_data, size, offset, stripe);
+}
+
+/**
+ * Private helper: wait for a free slot in the device queue, take it, then
+ * spend the sampled access latency followed by the transfer time. Transfers
+ * in the same direction share the bandwidth and are served one after another.
+ */
+bool SimulatedDiskManager::SimulateIO(IOType type, size_t bytes,
+                                      bool may_fail) {
+  EnterQueue();
+  auto start = std::chrono::steady_clock::now();
+  bool is_read = (type == IOType::READ);
+  double latency_us =
+      SampleLatency(is_read ? options_.read_latency : options_.write_latency);
+  auto done = start + std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::duration<double, std::micro>(latency_us));
+  double bandwidth =
+      is_read ? options_.read_bandwidth : options_.write_bandwidth;
+  if (bandwidth > 0) {
+    auto transfer = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::duration<double>(bytes / bandwidth));
+    std::lock_guard<std::mutex> guard(bus_latch_);
+    auto &busy_until = is_read ? read_busy_until_ : write_busy_until_;
+    busy_until = std::max(busy_until, done) + transfer;
+    done = busy_until;
+  }
+  std::this_thread::sleep_until(done);
+  total_delay_us_ += std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  LeaveQueue();
+
+  if (may_fail && Chance(is_read ? options_.read_error_rate
+                                 : options_.write_error_rate)) {
+    num_io_errors_++;
+    return false;
+  }
+  return true;
+}
+
+double SimulatedDiskManager::SampleLatency(const LatencyDistribution &dist) {
+  std::lock_guard<std::mutex> guard(rng_latch_);
+  double latency = 0;
+  switch (dist.type) {
+  case LatencyDistribution::Type::CONSTANT:
+    latency = dist.mean_us;
+    break;
+  case LatencyDistribution::Type::UNIFORM:
+    latency = std::uniform_real_distribution<double>(
+        dist.mean_us - dist.spread_us, dist.mean_us + dist.spread_us)(rng_);
+    break;
+  case LatencyDistribution::Type::EXPONENTIAL:
+    if (dist.mean_us > 0)
+      latency = std::exponential_distribution<double>(1 / dist.mean_us)(rng_);
+    break;
+  case LatencyDistribution::Type::NORMAL:
+    latency =
+        std::normal_distribution<double>(dist.mean_us, dist.spread_us)(rng_);
+    break;
+  }
+  if (dist.tail_probability > 0 &&
+      std::uniform_real_distribution<double>(0, 1)(rng_) <
+          dist.tail_probability) {
+    latency += dist.tail_us;
+  }
+  return std::max(latency, 0.0);
+}
+
+bool SimulatedDiskManager::Chance(double probability) {
+  if (probability <= 0)
+    return false;
+  std::lock_guard<std::mutex> guard(rng_latch_);
+  return std::uniform_real_distribution<double>(0, 1)(rng_) < probability;
+}
+
+void SimulatedDiskManager::EnterQueue() {
+  std::unique_lock<std::mutex> lock(queue_latch_);
+  if (options_.queue_depth > 0) {
+    queue_cv_.wait(lock,
+                   [this] { return in_flight_ < options_.queue_depth; });
+  }
+  in_flight_++;
+  if (in_flight_ > max_queue_depth_)
+    max_queue_depth_ = in_flight_;
+}
+
+void SimulatedDiskManager::LeaveQueue() {
+  std::lock_guard<std::mutex> guard(queue_latch_);
+  in_flight_--;
+  queue_cv_.notify_one();
+}
+
+} // namespace scudb
@@ -8,8 +8,10 @@
 
 #pragma once
 
+#include <atomic>
 #include <list>
 #include <mutex>
+#include <vector>
 
 #include "buffer/lru_replacer.h"
 #include "disk/disk_manager.h"
@@ -31,19 +33,53 @@ namespace scudb {
 
         bool FlushPage(page_id_t page_id);
 
+        // write back every dirty page in the pool with coalesced writes
+        void FlushAllPages();
+
+        // write back the dirty pages among page_ids with coalesced writes,
+        // false if some of them stay dirty
+        bool FlushPages(const std::vector<page_id_t> &page_ids);
+
         Page *NewPage(page_id_t &page_id);
 
         bool DeletePage(page_id_t page_id);
 
+        // true when pages are served from a read only mapping of the db file
+        inline bool IsReadOnly() const { return read_only_; }
+
+        inline size_t GetPoolSize() const { return pool_size_; }
+
+        // page id and recLSN of every page that is dirty or may become so
+        std::vector<std::pair<page_id_t, lsn_t>> GetDirtyPageTable();
+
+        // pages evicted, and evictions that had to wait for a log flush
+        inline size_t GetNumEvictions() const { return num_evictions_; }
+        inline size_t GetNumLogWaits() const { return num_log_waits_; }
+
     private:
         size_t pool_size_; // number of pages in buffer pool
         Page *pages_;      // array of pages
+        char *frames_;     // memory of the pages, PAGE_SIZE bytes per page
         DiskManager *disk_manager_;
         LogManager *log_manager_;
         HashTable<page_id_t, Page *> *page_table_; // to keep track of pages
         Replacer<Page *> *replacer_;   // to find an unpinned page for replacement
         std::list<Page *> *free_list_; // to find a free page for replacement
         std::mutex latch_;             // to protect shared data structure
-        Page *GetVictimPage();        // to get pointer of victim Page
+        // to get pointer of victim Page, may let go of latch_ meanwhile
+        Page *GetVictimPage(std::unique_lock<std::mutex> &lck);
+        bool FlushBatch(std::vector<Page *> &batch); // write back dirty pages
+        bool ForceLog(Page *page);    // write ahead log before the page
+        bool IsLogDurable(Page *page); // written back without a log flush
+        void TrackRecLSN(Page *page); // recLSN of a page pinned while clean
+        void ResetRecLSN(Page *page); // recLSN of a page written back
+        // read only mode, descriptors of mapped pages indexed by page id
+        bool read_only_;
+        size_t num_mapped_pages_;
+        std::atomic<Page *> *mapped_pages_;
+        Page *FetchMappedPage(page_id_t page_id);
+        // eviction statistics
+        std::atomic<size_t> num_evictions_{0};
+        std::atomic<size_t> num_log_waits_{0};
     };
 } // namespace scudb
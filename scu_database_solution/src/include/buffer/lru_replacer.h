@@ -40,6 +40,9 @@ namespace scudb {
 
         bool Victim(T &value);
 
+        bool VictimIf(T &value, const std::function<bool(const T &)> &pred,
+                      size_t depth);
+
         bool Erase(const T &value);
 
         size_t Size();
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <cstdlib>
+#include <functional>
 
 namespace scudb {
 
@@ -21,6 +22,13 @@ namespace scudb {
 
         virtual bool Victim(T &value) = 0;
 
+        // pop the least recently used of the depth oldest members for which
+        // pred holds, false if there is none or the replacer cannot tell
+        virtual bool VictimIf(T &, const std::function<bool(const T &)> &,
+                              size_t) {
+            return false;
+        }
+
         virtual bool Erase(const T &value) = 0;
 
         virtual size_t Size() = 0;
@@ -25,9 +25,32 @@ extern std::atomic<bool> ENABLE_LOGGING;
   ((BUFFER_POOL_SIZE + 1) * PAGE_SIZE) // size of a log buffer in byte
 #define BUCKET_SIZE 50                 // size of extendible hash bucket
 #define BUFFER_POOL_SIZE 10            // size of buffer pool
+#define LOG_SEGMENT_SIZE (1 << 20)     // size of a preallocated log segment
+#define LOG_SEGMENT_SPARES 2           // recycled segments kept for reuse
+#define LOG_INDEX_INTERVAL (64 << 10)  // log bytes between sampled offsets
+#define CHECKPOINT_INTERVAL 30000      // milliseconds between checkpoints
+#define LOG_READ_CHUNK_SIZE (4 << 20)  // log bytes read ahead by recovery
+#define VICTIM_SCAN_DEPTH 8            // LRU pages checked for a durable LSN
+#define LOG_STRIPES 1                  // log files the log is striped over
+#define MAX_LOG_STRIPES 16             // upper bound of LOG_STRIPES
+#define LOCK_TABLE_SHARDS 64           // shards of the tuple lock table
+#define DEADLOCK_DETECTION_INTERVAL 50 // milliseconds between deadlock checks
+#define LOCK_ESCALATION_THRESHOLD 1000 // tuple locks of a table to escalate
+#define VACUUM_INTERVAL 100            // milliseconds between vacuum runs
+#define OCC_VERSION_WORDS (1 << 16)    // tuple version words for OCC
+#define OLC_MAX_RESTARTS 8             // optimistic index descents to try
+#define TXN_POOL_SIZE 16               // transactions kept per thread for reuse
+
+// controls when fdatasync runs for the log file and the db file
+enum class DurabilityLevel {
+  NONE,  // never sync, leave write back to the OS
+  GROUP, // concurrent log writers share one sync, db file synced per batch
+  FULL,  // every log write and page write is synced before returning
+};
 
 typedef int32_t page_id_t; // page id type
 typedef int32_t txn_id_t;  // transaction id type
 typedef int32_t lsn_t;     // log sequence number type
+typedef int64_t timestamp_t; // commit timestamp type
 
 } // namespace scudb
\ No newline at end of file
@@ -2,68 +2,126 @@
  * rwmutex.h
  *
  * Reader-Writer lock
+ *
+ * The whole latch is one atomic word: a reader count, a bit for the writer
+ * and a bit telling that somebody sleeps on the word. Without contention a
+ * shared or exclusive latch costs one atomic read-modify-write. A blocked
+ * thread spins a little, then sleeps on the word (a futex on Linux) until an
+ * unlock wakes it. A writer that entered blocks new readers, then waits for
+ * the readers before it to leave.
  */
 
 #pragma once
 
-#include <climits>
-#include <condition_variable>
-#include <mutex>
+#include <atomic>
+#include <cstdint>
 
 namespace scudb {
 class RWMutex {
-
-  typedef std::mutex mutex_t;
-  typedef std::condition_variable cond_t;
-  static const uint32_t max_readers_ = UINT_MAX;
+  static const uint32_t WRITER = 1U << 31;
+  static const uint32_t WAITERS = 1U << 30;
+  static const uint32_t READERS = WAITERS - 1;
 
 public:
-  RWMutex() : reader_count_(0), writer_entered_(false) {}
-
-  ~RWMutex() { std::lock_guard<mutex_t> guard(mutex_); }
+  RWMutex() : state_(0) {}
 
   RWMutex(const RWMutex &) = delete;
   RWMutex &operator=(const RWMutex &) = delete;
 
-  void WLock() {
-    std::unique_lock<mutex_t> lock(mutex_);
-    while (writer_entered_)
-      reader_.wait(lock);
-    writer_entered_ = true;
-    while (reader_count_ > 0)
-      writer_.wait(lock);
+  inline void WLock() {
+    uint32_t state = 0;
+    if (!state_.compare_exchange_strong(state, WRITER,
+                                        std::memory_order_acquire))
+      WLockSlow();
+  }
+
+  // no reader entered while the writer held the latch
+  inline void WUnlock() {
+    if (state_.exchange(0, std::memory_order_release) & WAITERS)
+      Wake();
   }
 
-  void WUnlock() {
-    std::lock_guard<mutex_t> guard(mutex_);
-    writer_entered_ = false;
-    reader_.notify_all();
+  inline void RLock() {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    if ((state & WRITER) ||
+        !state_.compare_exchange_weak(state, state + 1,
+                                      std::memory_order_acquire,
+                                      std::memory_order_relaxed))
+      RLockSlow();
   }
 
-  void RLock() {
-    std::unique_lock<mutex_t> lock(mutex_);
-    while (writer_entered_ || reader_count_ == max_readers_)
-      reader_.wait(lock);
-    reader_count_++;
+  // the last reader wakes a writer waiting for it
+  inline void RUnlock() {
+    uint32_t state = state_.fetch_sub(1, std::memory_order_release) - 1;
+    if ((state & WAITERS) && (state & READERS) == 0 &&
+        (state_.fetch_and(~WAITERS) & WAITERS))
+      Wake();
+  }
+
+private:
+  void WLockSlow();
+  void RLockSlow();
+  // sleep while the word is state, with the waiters bit set
+  void Park(uint32_t state);
+  void Wake();
+
+  std::atomic<uint32_t> state_;
+};
+
+/*
+ * Reader-writer lock for latches nearly every operation takes shared, like
+ * the root of an index. Readers count themselves in one of several counters,
+ * each on its own cache line, so they do not fight over a single word. A
+ * writer excludes the other writers, announces itself, then waits until
+ * every counter drains. A reader that meets a writer waits on the writers'
+ * latch.
+ */
+class DistributedRWMutex {
+  static const int READER_SLOTS = 16;
+
+  // padded to a cache line, two counters never share one
+  struct ReaderSlot {
+    std::atomic<uint32_t> readers_{0};
+    char padding_[64 - sizeof(std::atomic<uint32_t>)];
+  };
+
+public:
+  DistributedRWMutex() : writer_(false) {}
+
+  DistributedRWMutex(const DistributedRWMutex &) = delete;
+  DistributedRWMutex &operator=(const DistributedRWMutex &) = delete;
+
+  void WLock();
+
+  inline void WUnlock() {
+    writer_.store(false);
+    writers_.WUnlock();
   }
 
-  void RUnlock() {
-    std::lock_guard<mutex_t> guard(mutex_);
-    reader_count_--;
-    if (writer_entered_) {
-      if (reader_count_ == 0)
-        writer_.notify_one();
-    } else {
-      if (reader_count_ == max_readers_ - 1)
-        reader_.notify_one();
+  // sequentially consistent, either the writer sees the reader count or the
+  // reader sees the writer
+  inline void RLock() {
+    std::atomic<uint32_t> &readers = slots_[SlotIndex()].readers_;
+    for (;;) {
+      readers.fetch_add(1);
+      if (!writer_.load())
+        return;
+      readers.fetch_sub(1);
+      writers_.RLock();
+      writers_.RUnlock();
     }
   }
 
+  // called by the thread that took the shared latch
+  inline void RUnlock() { slots_[SlotIndex()].readers_.fetch_sub(1); }
+
 private:
-  mutex_t mutex_;
-  cond_t writer_;
-  cond_t reader_;
-  uint32_t reader_count_;
-  bool writer_entered_;
+  // the counter of the calling thread
+  static int SlotIndex();
+
+  ReaderSlot slots_[READER_SLOTS];
+  std::atomic<bool> writer_;
+  // held exclusively by the writer, readers wait on it
+  RWMutex writers_;
 };
 } // namespace scudb
@@ -0,0 +1,129 @@
+/**
+ * small_vector.h
+ *
+ * A vector that keeps its first N elements inside the object, it only
+ * allocates once it grows past them. Cleared, it keeps what it allocated, so
+ * a reused owner does not allocate again. Iterators are pointers and are
+ * invalidated by growing, like those of std::vector.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <utility>
+
+namespace scudb {
+template <typename T, size_t N> class SmallVector {
+public:
+  typedef T value_type;
+  typedef T *iterator;
+  typedef const T *const_iterator;
+  typedef std::reverse_iterator<iterator> reverse_iterator;
+  typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+  SmallVector() : data_(Inline()), size_(0), capacity_(N) {}
+
+  SmallVector(const SmallVector &) = delete;
+  SmallVector &operator=(const SmallVector &) = delete;
+
+  ~SmallVector() {
+    clear();
+    if (data_ != Inline())
+      ::operator delete(data_);
+  }
+
+  inline size_t size() const { return size_; }
+  inline bool empty() const { return size_ == 0; }
+  inline size_t capacity() const { return capacity_; }
+
+  inline T &operator[](size_t i) { return data_[i]; }
+  inline const T &operator[](size_t i) const { return data_[i]; }
+  inline T &back() { return data_[size_ - 1]; }
+
+  inline iterator begin() { return data_; }
+  inline iterator end() { return data_ + size_; }
+  inline const_iterator begin() const { return data_; }
+  inline const_iterator end() const { return data_ + size_; }
+  inline reverse_iterator rbegin() { return reverse_iterator(end()); }
+  inline reverse_iterator rend() { return reverse_iterator(begin()); }
+  inline const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+  inline const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+
+  template <typename... Args> inline void emplace_back(Args &&... args) {
+    if (size_ == capacity_)
+      Grow(capacity_ * 2);
+    new (data_ + size_) T(std::forward<Args>(args)...);
+    size_++;
+  }
+
+  inline void push_back(const T &value) { emplace_back(value); }
+
+  inline void pop_back() {
+    assert(size_ > 0);
+    data_[--size_].~T();
+  }
+
+  // the elements go, the storage stays
+  inline void clear() {
+    while (size_ > 0)
+      data_[--size_].~T();
+  }
+
+  // an allocated buffer changes hands, inline elements are moved
+  void swap(SmallVector &other) {
+    SmallVector tmp;
+    tmp.Take(*this);
+    Take(other);
+    other.Take(tmp);
+  }
+
+private:
+  inline T *Inline() { return reinterpret_cast<T *>(inline_); }
+
+  void Grow(size_t capacity) {
+    T *data = static_cast<T *>(::operator new(capacity * sizeof(T)));
+    for (size_t i = 0; i < size_; i++) {
+      new (data + i) T(std::move(data_[i]));
+      data_[i].~T();
+    }
+    if (data_ != Inline())
+      ::operator delete(data_);
+    data_ = data;
+    capacity_ = capacity;
+  }
+
+  // the elements of other, which is left empty with its inline storage
+  void Take(SmallVector &other) {
+    clear();
+    if (other.data_ != other.Inline()) {
+      if (data_ != Inline())
+        ::operator delete(data_);
+      data_ = other.data_;
+      size_ = other.size_;
+      capacity_ = other.capacity_;
+      other.data_ = other.Inline();
+      other.size_ = 0;
+      other.capacity_ = N;
+      return;
+    }
+    if (capacity_ < other.size_)
+      Grow(other.size_);
+    for (size_t i = 0; i < other.size_; i++)
+      new (data_ + i) T(std::move(other.data_[i]));
+    size_ = other.size_;
+    other.clear();
+  }
+
+  T *data_;
+  size_t size_;
+  size_t capacity_;
+  alignas(T) char inline_[N * sizeof(T)];
+};
+} // namespace scudb
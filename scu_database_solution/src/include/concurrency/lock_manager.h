@@ -1,16 +1,43 @@
 /**
  * lock_manager.h
  *
- * Tuple level lock manager, use wait-die to prevent deadlocks
+ * Multi-granularity lock manager, use wait-die to prevent deadlocks
+ *
+ * The lock table is split into shards by the hash of the RID, every shard has
+ * its own latch, so transactions locking different tuples rarely meet. Every
+ * locked tuple has a FIFO queue of requests: a request is granted once every
+ * request ahead of it is granted and compatible. An upgrade goes ahead of the
+ * waiting requests. Each request has its own condition variable, an unlock
+ * only wakes up the requests it grants. Requests are recycled through a pool
+ * per shard.
+ * Wait-die: a transaction only waits for younger ones (larger txn id), a
+ * younger transaction that would wait for an older one aborts instead.
+ * Deadlock detection, once started, replaces wait-die: transactions wait
+ * freely and a background thread builds the waits-for graph at an interval,
+ * then aborts the youngest transaction of every cycle.
+ * Tables are locked in the same lock table, as the resource RID(table id, -1),
+ * in the modes IS, IX, S, SIX and X. A tuple locked on behalf of a table first
+ * takes the matching intention lock on it, or skips the tuple lock when the
+ * table lock already covers it. Once a transaction holds the escalation
+ * threshold of tuple locks in a table, its table lock is converted to S, SIX
+ * or X and the tuple locks it covers are released. Escalation never waits:
+ * while another transaction holds a conflicting table lock, the tuple locks
+ * stay.
  */
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
-#include <list>
+#include <deque>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <set>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include "common/rid.h"
 #include "concurrency/transaction.h"
@@ -18,9 +45,39 @@
 namespace scudb {
 
 class LockManager {
+  struct LockRequest {
+    Transaction *txn_;
+    txn_id_t txn_id_;
+    LockMode mode_;
+    bool granted_;
+    // killed by an older transaction that upgraded ahead of it, or chosen as
+    // the victim of a deadlock
+    bool aborted_;
+    std::chrono::steady_clock::time_point wait_start_;
+    std::condition_variable cv_;
+    // intrusive links of the queue of the tuple
+    LockRequest *prev_;
+    LockRequest *next_;
+  };
+
+  struct LockQueue {
+    LockRequest *head_ = nullptr;
+    LockRequest *tail_ = nullptr;
+    // a transaction waits to upgrade its shared lock
+    bool upgrading_ = false;
+  };
+
+  struct Shard {
+    std::mutex latch_;
+    std::unordered_map<RID, LockQueue> queues_;
+    // every request ever allocated, the free ones are listed for reuse
+    std::deque<LockRequest> pool_;
+    std::vector<LockRequest *> free_;
+  };
 
 public:
-  LockManager(bool strict_2PL) : strict_2PL_(strict_2PL){};
+  LockManager(bool strict_2PL, int num_shards = LOCK_TABLE_SHARDS);
+  ~LockManager();
 
   /*** below are APIs need to implement ***/
   // lock:
@@ -28,17 +85,88 @@ public:
   // it should be blocked on waiting and should return true when granted
   // note the behavior of trying to lock locked rids by same txn is undefined
   // it is transaction's job to keep track of its current locks
-  bool LockShared(Transaction *txn, const RID &rid);
-  bool LockExclusive(Transaction *txn, const RID &rid);
-  bool LockUpgrade(Transaction *txn, const RID &rid);
+  // a tuple of table table_id is locked under an intention lock on the table
+  bool LockShared(Transaction *txn, const RID &rid,
+                  page_id_t table_id = INVALID_PAGE_ID);
+  bool LockExclusive(Transaction *txn, const RID &rid,
+                     page_id_t table_id = INVALID_PAGE_ID);
+  bool LockUpgrade(Transaction *txn, const RID &rid,
+                   page_id_t table_id = INVALID_PAGE_ID);
 
   // unlock:
   // release the lock hold by the txn
-  bool Unlock(Transaction *txn, const RID &rid);
+  bool Unlock(Transaction *txn, const RID &rid,
+              page_id_t table_id = INVALID_PAGE_ID);
   /*** END OF APIs ***/
 
+  // lock a whole table, a table lock already held is converted to the
+  // weakest mode covering both
+  bool LockTable(Transaction *txn, page_id_t table_id, LockMode mode);
+  bool UnlockTable(Transaction *txn, page_id_t table_id);
+
+  // tuple locks a transaction takes in one table before it is escalated
+  inline void SetEscalationThreshold(int threshold) {
+    escalation_threshold_ = threshold;
+  }
+  inline int GetNumEscalations() const { return num_escalations_; }
+
+  // switch from wait-die to deadlock detection by a background thread
+  void StartDeadlockDetection(std::chrono::milliseconds interval =
+                                  std::chrono::milliseconds(
+                                      DEADLOCK_DETECTION_INTERVAL));
+  void StopDeadlockDetection();
+  // one round of deadlock detection, returns the number of victims
+  int DetectDeadlocks();
+
+  inline int GetNumShards() const { return shards_.size(); }
+  // transactions aborted by wait-die or as deadlock victims
+  inline int GetNumAborts() const { return num_aborts_; }
+  inline int GetNumDeadlocks() const { return num_deadlocks_; }
+  // average microseconds a deadlock victim waited before it was aborted
+  double GetAverageDetectionLatency();
+
 private:
+  bool LockTuple(Transaction *txn, const RID &rid, LockMode mode,
+                 page_id_t table_id);
+  bool Lock(Transaction *txn, const RID &rid, LockMode mode);
+  bool Convert(Transaction *txn, const RID &rid, LockMode mode);
+  bool Release(Transaction *txn, const RID &rid);
+  void Escalate(Transaction *txn, page_id_t table_id);
+  bool CanLock(Transaction *txn);
+  bool CanUnlock(Transaction *txn);
+  bool WaitForGrant(Shard &shard, std::unique_lock<std::mutex> &lock,
+                    const RID &rid, LockQueue &queue, LockRequest *request);
+  void GrantWaiting(LockQueue &queue);
+  void Remove(Shard &shard, const RID &rid, LockQueue &queue,
+              LockRequest *request);
+  static void InsertAfter(LockQueue &queue, LockRequest *pos,
+                          LockRequest *request);
+  static void Unlink(LockQueue &queue, LockRequest *request);
+  LockRequest *NewRequest(Shard &shard, Transaction *txn, LockMode mode);
+  Shard &GetShard(const RID &rid);
+  static inline RID TableKey(page_id_t table_id) { return RID(table_id, -1); }
+  static bool Compatible(LockMode a, LockMode b);
+  static LockMode Combine(LockMode a, LockMode b);
+  void DetectorThread(std::chrono::milliseconds interval);
+  static bool FindCycle(const std::map<txn_id_t, std::set<txn_id_t>> &graph,
+                        txn_id_t &victim);
+
   bool strict_2PL_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  // shift that maps a hash to one of the 2^k shards
+  int shard_shift_;
+  std::atomic<int> escalation_threshold_;
+  // deadlock detection
+  std::atomic<bool> detection_;
+  bool detector_running_;
+  std::thread *detector_thread_;
+  std::mutex detector_latch_;
+  std::condition_variable detector_cv_;
+  // statistics
+  std::atomic<int> num_aborts_;
+  std::atomic<int> num_deadlocks_;
+  std::atomic<int> num_escalations_;
+  std::atomic<int64_t> detection_latency_us_;
 };
 
 } // namespace scudb
@@ -5,13 +5,16 @@
 #pragma once
 
 #include <atomic>
-#include <deque>
 #include <memory>
 #include <thread>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "common/logger.h"
+#include "common/small_vector.h"
 #include "page/page.h"
 #include "table/tuple.h"
 
@@ -30,9 +33,23 @@ enum class TransactionState { GROWING, SHRINKING, COMMITTED, ABORTED };
 
 enum class WType { INSERT = 0, DELETE, UPDATE };
 
+// lock modes, tuples are only locked SHARED or EXCLUSIVE, a table also in the
+// intention modes that announce locks on its tuples
+enum class LockMode {
+  INTENTION_SHARED,
+  INTENTION_EXCLUSIVE,
+  SHARED,
+  SHARED_INTENTION_EXCLUSIVE,
+  EXCLUSIVE
+};
+
 class TableHeap;
+class TupleVersionTable;
+class VersionStore;
 
-// write set record
+// write set record, the undo log of the transaction. An optimistic
+// transaction buffers its updates and deletes here until it commits, tuple
+// is the new one then.
 class WriteRecord {
 public:
   WriteRecord(RID rid, WType wtype, const Tuple &tuple, TableHeap *table)
@@ -46,22 +63,47 @@ public:
   TableHeap *table_;
 };
 
+// the few writes and index pages of a short transaction stay inline
+typedef SmallVector<WriteRecord, 4> WriteSet;
+typedef SmallVector<Page *, 8> PageSet;
+
+/*
+ * The sets live inside the transaction and allocate nothing until they are
+ * used. A transaction manager resets a finished transaction for reuse, the
+ * sets keep the memory they grew.
+ */
 class Transaction {
 public:
   Transaction(Transaction const &) = delete;
   Transaction(txn_id_t txn_id)
       : state_(TransactionState::GROWING),
-        thread_id_(std::this_thread::get_id()),
-        txn_id_(txn_id), prev_lsn_(INVALID_LSN), shared_lock_set_{new std::unordered_set<RID>},
-        exclusive_lock_set_{new std::unordered_set<RID>} {
-    // initialize sets
-    write_set_.reset(new std::deque<WriteRecord>);
-    page_set_.reset(new std::deque<Page *>);
-    deleted_page_set_.reset(new std::unordered_set<page_id_t>);
-  }
+        thread_id_(std::this_thread::get_id()), txn_id_(txn_id),
+        prev_lsn_(INVALID_LSN) {}
 
   ~Transaction() {}
 
+  // start over as a new transaction of the calling thread
+  void Reset(txn_id_t txn_id) {
+    state_ = TransactionState::GROWING;
+    thread_id_ = std::this_thread::get_id();
+    txn_id_ = txn_id;
+    write_set_.clear();
+    prev_lsn_ = INVALID_LSN;
+    async_commit_ = false;
+    read_only_ = false;
+    version_store_ = nullptr;
+    read_ts_ = 0;
+    tuple_versions_ = nullptr;
+    read_set_.clear();
+    version_lock_set_.clear();
+    page_set_.clear();
+    deleted_page_set_.clear();
+    shared_lock_set_.clear();
+    exclusive_lock_set_.clear();
+    table_lock_set_.clear();
+    table_tuple_lock_set_.clear();
+  }
+
   //===--------------------------------------------------------------------===//
   // Mutators and Accessors
   //===--------------------------------------------------------------------===//
@@ -69,28 +111,43 @@ public:
 
   inline txn_id_t GetTransactionId() const { return txn_id_; }
 
-  inline std::shared_ptr<std::deque<WriteRecord>> GetWriteSet() {
-    return write_set_;
-  }
+  inline WriteSet *GetWriteSet() { return &write_set_; }
 
-  inline std::shared_ptr<std::deque<Page *>> GetPageSet() { return page_set_; }
+  inline PageSet *GetPageSet() { return &page_set_; }
 
-  inline void AddIntoPageSet(Page *page) { page_set_->push_back(page); }
+  inline void AddIntoPageSet(Page *page) { page_set_.push_back(page); }
 
-  inline std::shared_ptr<std::unordered_set<page_id_t>> GetDeletedPageSet() {
-    return deleted_page_set_;
+  inline std::unordered_set<page_id_t> *GetDeletedPageSet() {
+    return &deleted_page_set_;
   }
 
   inline void AddIntoDeletedPageSet(page_id_t page_id) {
-    deleted_page_set_->insert(page_id);
+    deleted_page_set_.insert(page_id);
   }
 
-  inline std::shared_ptr<std::unordered_set<RID>> GetSharedLockSet() {
-    return shared_lock_set_;
+  inline std::unordered_set<RID> *GetSharedLockSet() {
+    return &shared_lock_set_;
   }
 
-  inline std::shared_ptr<std::unordered_set<RID>> GetExclusiveLockSet() {
-    return exclusive_lock_set_;
+  inline std::unordered_set<RID> *GetExclusiveLockSet() {
+    return &exclusive_lock_set_;
+  }
+
+  inline std::unordered_map<page_id_t, LockMode> *GetTableLockSet() {
+    return &table_lock_set_;
+  }
+
+  inline std::unordered_map<page_id_t, std::unordered_set<RID>> *
+  GetTableTupleLockSet() {
+    return &table_tuple_lock_set_;
+  }
+
+  // rid is exclusive locked, on its own or through its table
+  inline bool IsExclusiveLocked(const RID &rid, page_id_t table_id) {
+    if (exclusive_lock_set_.find(rid) != exclusive_lock_set_.end())
+      return true;
+    auto it = table_lock_set_.find(table_id);
+    return it != table_lock_set_.end() && it->second == LockMode::EXCLUSIVE;
   }
 
   inline TransactionState GetState() { return state_; }
@@ -101,6 +158,49 @@ public:
 
   inline void SetPrevLSN(lsn_t prev_lsn) { prev_lsn_ = prev_lsn; }
 
+  inline bool IsAsyncCommit() { return async_commit_; }
+
+  inline void SetAsyncCommit(bool async_commit) {
+    async_commit_ = async_commit;
+  }
+
+  // a read-only transaction takes no locks and writes no log records, its
+  // writes are rejected
+  inline bool IsReadOnly() { return read_only_; }
+
+  inline void SetReadOnly(bool read_only) { read_only_ = read_only; }
+
+  // snapshot isolation, the transaction reads the versions committed at its
+  // read timestamp from the version store. nullptr without snapshot isolation.
+  inline VersionStore *GetVersionStore() { return version_store_; }
+
+  inline timestamp_t GetReadTimestamp() { return read_ts_; }
+
+  inline void SetSnapshot(VersionStore *version_store, timestamp_t read_ts) {
+    version_store_ = version_store;
+    read_ts_ = read_ts;
+  }
+
+  // optimistic concurrency control, the transaction validates its reads
+  // against the tuple versions at commit. nullptr for a locking transaction.
+  inline TupleVersionTable *GetTupleVersionTable() { return tuple_versions_; }
+
+  inline bool IsOptimistic() { return tuple_versions_ != nullptr; }
+
+  inline void SetOptimistic(TupleVersionTable *tuple_versions) {
+    tuple_versions_ = tuple_versions;
+  }
+
+  // every tuple read by an optimistic transaction and its version word
+  inline std::vector<std::pair<RID, uint64_t>> *GetReadSet() {
+    return &read_set_;
+  }
+
+  // version words locked by an optimistic transaction
+  inline std::unordered_set<size_t> *GetVersionLockSet() {
+    return &version_lock_set_;
+  }
+
 private:
   TransactionState state_;
   // thread id, single-threaded transactions
@@ -108,20 +208,35 @@ private:
   // transaction id
   txn_id_t txn_id_;
   // Below are used by transaction, undo set
-  std::shared_ptr<std::deque<WriteRecord>> write_set_;
-  // prev lsn
-  lsn_t prev_lsn_;
+  WriteSet write_set_;
+  // prev lsn, read by checkpoints while the transaction runs
+  std::atomic<lsn_t> prev_lsn_;
+  // commit returns before the COMMIT record is durable
+  bool async_commit_ = false;
+  bool read_only_ = false;
+  // snapshot isolation
+  VersionStore *version_store_ = nullptr;
+  timestamp_t read_ts_ = 0;
+  // optimistic concurrency control
+  TupleVersionTable *tuple_versions_ = nullptr;
+  std::vector<std::pair<RID, uint64_t>> read_set_;
+  std::unordered_set<size_t> version_lock_set_;
 
   // Below are used by concurrent index
-  // this deque contains page pointer that was latche during index operation
-  std::shared_ptr<std::deque<Page *>> page_set_;
+  // this set contains page pointer that was latche during index operation
+  PageSet page_set_;
   // this set contains page_id that was deleted during index operation
-  std::shared_ptr<std::unordered_set<page_id_t>> deleted_page_set_;
+  std::unordered_set<page_id_t> deleted_page_set_;
 
   // Below are used by lock manager
   // this set contains rid of shared-locked tuples by this transaction
-  std::shared_ptr<std::unordered_set<RID>> shared_lock_set_;
+  std::unordered_set<RID> shared_lock_set_;
   // this set contains rid of exclusive-locked tuples by this transaction
-  std::shared_ptr<std::unordered_set<RID>> exclusive_lock_set_;
+  std::unordered_set<RID> exclusive_lock_set_;
+  // this map contains the mode of every table locked by this transaction
+  std::unordered_map<page_id_t, LockMode> table_lock_set_;
+  // tuples locked under each table lock, counted for lock escalation
+  std::unordered_map<page_id_t, std::unordered_set<RID>>
+      table_tuple_lock_set_;
 };
 } // namespace scudb
@@ -5,10 +5,20 @@
 
 #pragma once
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
+#include "concurrency/tuple_version_table.h"
+#include "concurrency/version_store.h"
 #include "logging/log_manager.h"
 
 namespace scudb {
@@ -17,15 +27,89 @@ public:
   TransactionManager(LockManager *lock_manager,
                            LogManager *log_manager = nullptr)
       : next_txn_id_(0), lock_manager_(lock_manager),
-        log_manager_(log_manager) {}
+        log_manager_(log_manager), last_commit_ts_(0),
+        vacuum_running_(false), vacuum_thread_(nullptr) {}
+  ~TransactionManager() { StopVacuumThread(); }
   Transaction *Begin();
-  void Commit(Transaction *txn);
+  // a read-only transaction: under snapshot isolation it reads its snapshot,
+  // otherwise the latest tuples under the page latches, committed or not.
+  // It is not logged and its commit only ends the snapshot.
+  Transaction *BeginReadOnly();
+  // false if an optimistic transaction failed validation, it is aborted then.
+  // Also false if the COMMIT record can't be made durable because the log
+  // failed: the locks are released, but the next recovery may roll it back
+  bool Commit(Transaction *txn);
   void Abort(Transaction *txn);
+  // hand a committed or aborted transaction back instead of deleting it,
+  // Begin reuses it on the same thread
+  void Release(Transaction *txn);
+
+  // asynchronous commit for every transaction begun from now on, the commits
+  // lost in a crash are bounded by the log manager's async commit window
+  inline void SetAsyncCommit(bool async_commit) {
+    async_commit_ = async_commit;
+  }
+  // wait until the last log record of txn, e.g. its COMMIT, is durable,
+  // false if it never will be
+  bool WaitForDurable(Transaction *txn);
+
+  // snapshot isolation for every transaction begun from now on: reads see
+  // the tuples committed when the transaction began and take no locks,
+  // writers still lock exclusively and abort when they would overwrite a
+  // version committed after their snapshot
+  inline void SetSnapshotIsolation(bool snapshot_isolation) {
+    snapshot_isolation_ = snapshot_isolation;
+  }
+  inline VersionStore *GetVersionStore() { return &version_store_; }
+  // optimistic concurrency control for every transaction begun from now on:
+  // reads take no locks and record the tuple versions they saw, updates and
+  // deletes are buffered until commit. Commit validates the reads and then
+  // applies the writes, or aborts. Meant for workloads with few conflicts,
+  // not to be mixed with locking transactions. An update that no longer fits
+  // its page aborts at commit.
+  inline void SetOptimistic(bool optimistic) { optimistic_ = optimistic; }
+
+  // remove the versions no running snapshot sees, returns how many
+  int Vacuum();
+  // vacuum every interval in a separate thread
+  void StartVacuumThread(std::chrono::milliseconds interval);
+  void StopVacuumThread();
+
+  // active transaction table for fuzzy checkpoints: txn id and last lsn of
+  // every running transaction, min_begin_lsn is the oldest BEGIN among them
+  std::vector<std::pair<txn_id_t, lsn_t>>
+  GetActiveTransactions(lsn_t &min_begin_lsn);
 
 private:
+  void RemoveActiveTransaction(Transaction *txn);
+  void RemoveSnapshot(Transaction *txn);
+  void EndReadOnly(Transaction *txn, TransactionState state);
+  bool InstallWrites(Transaction *txn);
+  void Rollback(Transaction *txn);
+  void VacuumThread(std::chrono::milliseconds interval);
+
+  // txn id -> (transaction, lsn of its BEGIN record)
+  std::unordered_map<txn_id_t, std::pair<Transaction *, lsn_t>> active_txns_;
+  std::mutex active_latch_;
   std::atomic<txn_id_t> next_txn_id_;
+  std::atomic<bool> async_commit_{false};
   LockManager *lock_manager_;
   LogManager *log_manager_;
+  // snapshot isolation
+  std::atomic<bool> snapshot_isolation_{false};
+  VersionStore version_store_;
+  // guards the commit timestamps and the read timestamps of the snapshots
+  std::mutex snapshot_latch_;
+  timestamp_t last_commit_ts_;
+  std::multiset<timestamp_t> snapshots_;
+  // optimistic concurrency control
+  std::atomic<bool> optimistic_{false};
+  TupleVersionTable tuple_versions_;
+  // vacuum thread
+  std::mutex vacuum_latch_;
+  std::condition_variable vacuum_cv_;
+  bool vacuum_running_;
+  std::thread *vacuum_thread_;
 };
 
 } // namespace scudb
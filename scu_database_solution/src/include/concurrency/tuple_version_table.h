@@ -0,0 +1,60 @@
+/**
+ * tuple_version_table.h
+ *
+ * Version words of tuples, for optimistic concurrency control
+ *
+ * Every tuple maps to one atomic word by the hash of its RID, the word holds
+ * a version counter and a lock bit. Tuples sharing a word only cause
+ * needless aborts. An optimistic transaction reads without locks and
+ * remembers the word of every tuple it read. At commit it locks the words of
+ * the tuples it writes, in word order, then checks that no word it read
+ * changed or is locked by another transaction. This backward validation only
+ * looks at transactions that committed already and takes no latch. A
+ * committed writer bumps the versions of its words as it unlocks them.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "common/rid.h"
+#include "concurrency/transaction.h"
+
+namespace scudb {
+
+class TupleVersionTable {
+public:
+  TupleVersionTable(int num_words = OCC_VERSION_WORDS);
+
+  // the version word of rid, read with the page of rid latched
+  inline uint64_t Read(const RID &rid) const {
+    return words_[Slot(rid)].load();
+  }
+
+  // lock the words of rids for txn, false if another transaction held one
+  // of them for too long
+  bool Lock(Transaction *txn, const std::vector<RID> &rids);
+  // every word txn read still has the version it read
+  bool Validate(Transaction *txn);
+  // release the words locked by txn, bump their versions if it wrote
+  void Unlock(Transaction *txn, bool wrote);
+
+private:
+  static const uint64_t LOCKED = 1ULL << 63;
+  // attempts to lock a word held by another transaction
+  static const int LOCK_SPINS = 1000;
+
+  inline size_t Slot(const RID &rid) const {
+    return (static_cast<uint64_t>(std::hash<RID>()(rid)) *
+            0x9E3779B97F4A7C15ULL) >> shift_;
+  }
+
+  std::unique_ptr<std::atomic<uint64_t>[]> words_;
+  // shift that maps a hash to one of the 2^k words
+  int shift_;
+};
+
+} // namespace scudb
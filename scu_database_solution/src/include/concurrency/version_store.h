@@ -0,0 +1,76 @@
+/**
+ * version_store.h
+ *
+ * Old versions of tuples, for snapshot isolation
+ *
+ * A table page only holds the newest version of a tuple. The writer saves the
+ * version it replaced in the undo chain of the tuple, newest first. Every
+ * version carries the commit timestamp of the transaction that created it and
+ * of the one that replaced it. A snapshot read walks the chain to the version
+ * that was committed when the snapshot began, it takes no lock. Versions that
+ * no running snapshot can see are removed by the vacuum.
+ * A transaction saves only the first version it replaces of a tuple, it holds
+ * the exclusive lock on the tuple until it commits or aborts.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "common/rid.h"
+#include "common/rwmutex.h"
+#include "concurrency/transaction.h"
+#include "table/tuple.h"
+
+namespace scudb {
+
+class VersionStore {
+  struct TupleVersion {
+    // false before the tuple was inserted or after it was deleted
+    bool exists_;
+    Tuple tuple_;
+    timestamp_t begin_ts_;
+    // INT64_MAX until writer_ commits
+    timestamp_t end_ts_;
+    txn_id_t writer_;
+  };
+
+public:
+  VersionStore() : num_versions_(0) {}
+
+  // txn changed the tuple at rid, image is the version it replaced, nullptr
+  // for an insert. Called with the page latched for write.
+  // return false if the replaced version was committed after the snapshot of
+  // txn began, txn must abort then
+  bool AddVersion(Transaction *txn, const RID &rid, const Tuple *image);
+
+  // tuple is the newest version of rid, if exists. Replace it by the version
+  // the snapshot of txn sees, return false if that snapshot sees no tuple.
+  // Called with the page latched.
+  bool GetVisibleVersion(Transaction *txn, const RID &rid, bool exists,
+                         Tuple &tuple);
+
+  // commit or abort time, the versions txn replaced end at commit_ts or go
+  // away
+  void Commit(Transaction *txn, timestamp_t commit_ts);
+  void Abort(Transaction *txn);
+
+  // remove the versions that ended at or before oldest_ts, the read timestamp
+  // of the oldest snapshot. Returns the number of removed versions.
+  int Vacuum(timestamp_t oldest_ts);
+
+  inline int GetNumVersions() const { return num_versions_; }
+
+private:
+  RWMutex latch_;
+  std::unordered_map<RID, std::deque<TupleVersion>> chains_;
+  // tuples whose newest saved version was replaced by a running transaction
+  std::unordered_map<txn_id_t, std::vector<RID>> pending_;
+  std::atomic<int> num_versions_;
+};
+
+} // namespace scudb
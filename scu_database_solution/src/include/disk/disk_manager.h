@@ -8,44 +8,111 @@
  */
 
 #pragma once
+#include <algorithm>
 #include <atomic>
-#include <fstream>
+#include <condition_variable>
 #include <future>
+#include <mutex>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
+#include "disk/log_file.h"
 
 namespace scudb {
 
 class DiskManager {
 public:
-  DiskManager(const std::string &db_file);
-  ~DiskManager();
+  DiskManager(const std::string &db_file,
+              DurabilityLevel durability = DurabilityLevel::GROUP,
+              bool read_only = false);
+  virtual ~DiskManager();
 
-  void WritePage(page_id_t page_id, const char *page_data);
-  void ReadPage(page_id_t page_id, char *page_data);
+  virtual void WritePage(page_id_t page_id, const char *page_data);
+  virtual void ReadPage(page_id_t page_id, char *page_data);
+  // fdatasync the db file, so that every page written so far is durable
+  // even where the durability level did not sync it
+  bool SyncPages();
+  // write a batch of pages with as few system calls as possible, returns the
+  // ids of the pages that may not have reached the disk
+  virtual std::vector<page_id_t>
+  WritePages(std::vector<std::pair<page_id_t, const char *>> &pages);
 
-  void WriteLog(char *log_data, int size);
-  bool ReadLog(char *log_data, int size, int offset);
+  // the log may be striped over several files, stripe 0 is <db>.log and
+  // stripe k > 0 is <db>.log-k. false if the data may not be durable, the
+  // end of the log is left where it was then.
+  virtual bool WriteLog(char *log_data, int size, int stripe = 0);
+  virtual bool ReadLog(char *log_data, int size, int64_t offset,
+                       int stripe = 0);
+  void RecycleLog(int64_t offset, int stripe = 0);
+  // drop the log from offset on, e.g. a torn record found by recovery
+  bool TruncateLog(int64_t offset, int stripe = 0);
+  int64_t GetLogStartOffset(int stripe = 0);
+  int64_t GetLogEndOffset(int stripe = 0);
+  // open the stripes up to num_stripes, existing ones are found on startup
+  void SetNumLogStripes(int num_stripes);
+  inline int GetNumLogStripes() const {
+    return std::max<int>(1, log_files_.size());
+  }
 
   page_id_t AllocatePage();
   void DeallocatePage(page_id_t page_id);
+  // never hand out page_id again, e.g. a page recovery found in the log
+  void ReservePage(page_id_t page_id);
 
   int GetNumFlushes() const;
+  int GetNumPageWrites() const;
+  int GetNumLogSyncs() const;
+  int GetNumPageSyncs() const;
+  inline DurabilityLevel GetDurability() const { return durability_; }
+  // a log write or sync failed, no later log write is acknowledged
+  inline bool IsLogFailed() const { return log_failed_; }
+  // read only mode, pages are served straight from a mapping of the db file
+  inline bool IsReadOnly() const { return read_only_; }
+  inline int GetNumMappedPages() const { return num_mapped_pages_; }
+  char *GetMappedPage(page_id_t page_id);
   bool GetFlushState() const;
   inline void SetFlushLogFuture(std::future<void> *f) { flush_log_f_ = f; }
   inline bool HasFlushLogFuture() { return flush_log_f_ != nullptr; }
 
+protected:
+  // the log failed for good, like after a failed sync
+  inline void FailLog() { log_failed_ = true; }
+
 private:
-  int GetFileSize(const std::string &name);
-  // stream to write log file
-  std::fstream log_io_;
+  bool SyncLog(uint64_t write_seq);
+  void OpenMapping();
+  SegmentedLogFile *GetLogFile(int stripe);
+  SegmentedLogFile *OpenLogFile(int stripe);
+  // log split into preallocated segments, one file per stripe
+  std::vector<SegmentedLogFile *> log_files_;
+  std::mutex stripes_latch_;
   std::string log_name_;
-  // stream to write db file
-  std::fstream db_io_;
+  // file descriptor of db file, positional I/O only
+  int db_fd_;
   std::string file_name_;
   std::atomic<page_id_t> next_page_id_;
-  int num_flushes_;
+  std::atomic<int> num_flushes_;
+  // number of write system calls issued against the db file
+  std::atomic<int> num_page_writes_;
+  // durability setting and sync statistics
+  DurabilityLevel durability_;
+  std::atomic<int> num_log_syncs_;
+  std::atomic<int> num_page_syncs_;
+  // group sync of log writes: a write is durable once synced >= its sequence
+  std::mutex sync_latch_;
+  std::condition_variable sync_cv_;
+  uint64_t log_written_seq_;
+  uint64_t log_synced_seq_;
+  bool log_syncing_;
+  // a failed log sync may have dropped the written data from the page cache,
+  // a later sync that succeeds proves nothing, so every later write fails
+  std::atomic<bool> log_failed_{false};
+  // read only mapping of the whole db file
+  bool read_only_;
+  char *mapped_data_;
+  int num_mapped_pages_;
   bool flush_log_;
   std::future<void> *flush_log_f_;
 };
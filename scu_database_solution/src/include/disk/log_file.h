@@ -0,0 +1,97 @@
+/**
+ * log_file.h
+ *
+ * The log as a sequence of fixed-size segment files <name>.0, <name>.1, ...
+ * Offsets are logical: offset o lives in segment o / LOG_SEGMENT_SIZE.
+ * Segments are preallocated, so appends never extend a file and fdatasync
+ * never has to write back file size metadata. The next segment is prepared in
+ * the background while the current one fills up. Segments that a checkpoint
+ * made obsolete are zeroed and kept as spares (<name>.spare.<k>) to be
+ * renamed into place later, the rest are deleted, so disk usage stays bounded.
+ * After a restart appends begin in a fresh segment, readers must skip the
+ * zero padding at the end of a segment to the next segment boundary, unless
+ * recovery truncated the log behind its last valid record first.
+ * Creates and renames are made durable with an fsync of the directory before
+ * a segment takes appends, or a crash could lose a whole synced segment.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+
+namespace scudb {
+
+class SegmentedLogFile {
+public:
+  SegmentedLogFile(const std::string &name,
+                   int64_t segment_size = LOG_SEGMENT_SIZE);
+  ~SegmentedLogFile();
+
+  // find the segments of an existing log, nothing is created until Append
+  void Open(bool sync_on_switch);
+  // append size bytes at the end of the log, false on I/O error
+  bool Append(const char *data, int size);
+  // read size bytes at offset, zero-fill past the end, false if offset is
+  // beyond the end of the log
+  bool Read(char *data, int size, int64_t offset);
+  // fdatasync everything appended so far
+  bool Sync();
+  // a sync failed, what was appended may be lost and later appends fail
+  inline bool IsFailed() const { return sync_failed_; }
+  // drop every segment that lies entirely below offset
+  void Recycle(int64_t offset);
+  // drop everything from offset to the end, appends go on at offset
+  bool Truncate(int64_t offset);
+
+  int64_t GetStartOffset();
+  int64_t GetEndOffset();
+  inline int64_t GetSegmentSize() const { return segment_size_; }
+  inline int GetNumSegmentsCreated() const { return num_segments_created_; }
+  inline int GetNumSegmentsReused() const { return num_segments_reused_; }
+
+  // delete every segment and spare of the log called name
+  static void Remove(const std::string &name);
+
+private:
+  std::string SegmentName(int64_t seq) const;
+  std::string SpareName(int spare) const;
+  int PrepareSegment(int64_t seq);
+  int GetSegmentFd(int64_t seq);
+  bool SwitchSegment(int64_t seq);
+  bool SyncDirectory() const;
+  static bool Preallocate(int fd, int64_t size);
+  static bool ZeroFill(int fd, int64_t begin, int64_t end);
+
+  std::string name_;
+  int64_t segment_size_;
+  bool sync_on_switch_;
+  // protects everything below except spares
+  std::mutex latch_;
+  int64_t start_offset_;
+  int64_t end_offset_;
+  std::set<int64_t> segments_;  // sequence numbers of existing segments
+  std::map<int64_t, int> fds_;  // open segments
+  int64_t cur_seq_;
+  std::atomic<int> cur_fd_;
+  // a failed fdatasync may have dropped the data from the page cache, a
+  // later sync that succeeds proves nothing
+  std::atomic<bool> sync_failed_{false};
+  // next segment, prepared in the background
+  int64_t next_seq_;
+  std::future<int> next_fd_;
+  // spare files ready to be renamed into place
+  std::mutex spare_latch_;
+  std::vector<int> spares_;
+  std::atomic<int> num_segments_created_;
+  std::atomic<int> num_segments_reused_;
+};
+
+} // namespace scudb
@@ -0,0 +1,115 @@
+/**
+ * simulated_disk_manager.h
+ *
+ * Disk manager that models slow or jittery storage for benchmarks and tests.
+ * Pages are kept either in memory or in the db file of the base DiskManager,
+ * and every I/O goes through a simulated device: a latency distribution, a
+ * bandwidth cap shared by all requests, a bounded queue depth, and randomly
+ * injected short reads and I/O errors. All randomness comes from one seeded
+ * generator so that a storage profile can be reproduced exactly.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "disk/disk_manager.h"
+
+namespace scudb {
+
+// latency of one I/O request, in microseconds
+struct LatencyDistribution {
+  enum class Type { CONSTANT, UNIFORM, EXPONENTIAL, NORMAL };
+  Type type = Type::CONSTANT;
+  // CONSTANT: mean_us; UNIFORM: [mean_us - spread_us, mean_us + spread_us];
+  // EXPONENTIAL: mean mean_us; NORMAL: mean mean_us, stddev spread_us
+  double mean_us = 0;
+  double spread_us = 0;
+  // occasional hiccup added on top, e.g. a garbage collecting SSD
+  double tail_probability = 0;
+  double tail_us = 0;
+};
+
+struct SimulatedDiskOptions {
+  // keep pages in memory instead of the db file, the log always uses the file
+  bool in_memory = true;
+  LatencyDistribution read_latency;
+  LatencyDistribution write_latency;
+  // bytes per second, 0 means unlimited
+  double read_bandwidth = 0;
+  double write_bandwidth = 0;
+  // requests served concurrently by the device, 0 means unlimited
+  int queue_depth = 0;
+  // probability that a page read returns only part of the page
+  double short_read_rate = 0;
+  // probability that a read or write fails with an I/O error
+  double read_error_rate = 0;
+  double write_error_rate = 0;
+  // probability that a log write fails, the log then fails for good
+  double log_error_rate = 0;
+  unsigned int seed = 0;
+};
+
+class SimulatedDiskManager : public DiskManager {
+public:
+  SimulatedDiskManager(const std::string &db_file,
+                       const SimulatedDiskOptions &options,
+                       DurabilityLevel durability = DurabilityLevel::NONE);
+  ~SimulatedDiskManager();
+
+  void WritePage(page_id_t page_id, const char *page_data);
+  void ReadPage(page_id_t page_id, char *page_data);
+  std::vector<page_id_t>
+  WritePages(std::vector<std::pair<page_id_t, const char *>> &pages);
+
+  bool WriteLog(char *log_data, int size, int stripe = 0);
+  bool ReadLog(char *log_data, int size, int64_t offset, int stripe = 0);
+
+  // statistics of the simulated device
+  inline int GetNumReads() const { return num_reads_; }
+  inline int GetNumWrites() const { return num_writes_; }
+  inline int GetNumShortReads() const { return num_short_reads_; }
+  inline int GetNumIOErrors() const { return num_io_errors_; }
+  inline int GetMaxQueueDepth() const { return max_queue_depth_; }
+  inline long GetTotalDelayUs() const { return total_delay_us_; }
+
+private:
+  enum class IOType { READ, WRITE };
+  // model one request of bytes through the device, returns false on an
+  // injected I/O error of a page
+  bool SimulateIO(IOType type, size_t bytes, bool may_fail);
+  double SampleLatency(const LatencyDistribution &dist);
+  bool Chance(double probability);
+  void EnterQueue();
+  void LeaveQueue();
+
+  SimulatedDiskOptions options_;
+  // memory backing of pages
+  std::mutex pages_latch_;
+  std::unordered_map<page_id_t, std::vector<char>> pages_;
+  // seeded generator shared by every request
+  std::mutex rng_latch_;
+  std::mt19937 rng_;
+  // bandwidth: the device is busy transferring until this point in time
+  std::mutex bus_latch_;
+  std::chrono::steady_clock::time_point read_busy_until_;
+  std::chrono::steady_clock::time_point write_busy_until_;
+  // queue depth
+  std::mutex queue_latch_;
+  std::condition_variable queue_cv_;
+  int in_flight_;
+  // statistics
+  std::atomic<int> num_reads_;
+  std::atomic<int> num_writes_;
+  std::atomic<int> num_short_reads_;
+  std::atomic<int> num_io_errors_;
+  std::atomic<int> max_queue_depth_;
+  std::atomic<long> total_delay_us_;
+};
+
+} // namespace scudb
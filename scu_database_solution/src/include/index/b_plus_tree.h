@@ -33,6 +33,19 @@ namespace scudb {
         // Returns true if this B+ tree has no keys and values.
         bool IsEmpty() const;
 
+        // B-link tree mode, chosen before the tree is used: readers and
+        // writers hold one page latch at a time on the way down and move
+        // right past pages split meanwhile. Splits only latch upwards, pages
+        // are never merged or redistributed. The mode of a non-empty tree
+        // cannot change since the other mode's pages lack the high keys or
+        // may have been merged, returns false then.
+        inline bool SetBLinkMode(bool blink) {
+            if (blink != blink_ && !IsEmpty())
+                return false;
+            blink_ = blink;
+            return true;
+        }
+
         // Insert a key-value pair into this B+ tree.
         bool Insert(const KeyType &key, const ValueType &value,
                     Transaction *transaction = nullptr);
@@ -72,6 +85,23 @@ namespace scudb {
     private:
         BPlusTreePage *FetchPage(page_id_t page_id);
 
+        bool OptimisticLookup(const KeyType &key, ValueType &value,
+                              bool &found);
+
+        Page *BLinkDescend(const KeyType &key, bool leftMost, int level,
+                           bool exclusive,
+                           std::vector<std::pair<page_id_t, int>> *path);
+
+        Page *MoveRight(Page *page, const KeyType &key, bool exclusive);
+
+        bool BLinkInsert(const KeyType &key, const ValueType &value);
+
+        Page *BLinkSplit(Page *page, KeyType &separator);
+
+        Page *BLinkParent(Page *page, Page *sibling, const KeyType &separator,
+                          int level,
+                          const std::vector<std::pair<page_id_t, int>> &path);
+
         void StartNewTree(const KeyType &key, const ValueType &value);
 
         bool InsertIntoLeaf(const KeyType &key, const ValueType &value,
@@ -159,7 +189,9 @@ namespace scudb {
         page_id_t root_page_id_;
         BufferPoolManager *buffer_pool_manager_;
         KeyComparator comparator_;
-        RWMutex mutex_;
+        // every operation latches the root page id, shared mostly
+        DistributedRWMutex mutex_;
+        bool blink_ = false;
         static thread_local int rootLockedCnt;
 
     };
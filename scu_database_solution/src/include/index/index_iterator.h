@@ -27,7 +27,8 @@ namespace scudb {
 
         IndexIterator &operator++() {
             index_++;
-            if (index_ >= leaf_->GetSize()) {
+            // B-link leaves are never merged, they may be empty
+            while (leaf_ != nullptr && index_ >= leaf_->GetSize()) {
                 page_id_t next = leaf_->GetNextPageId();
                 UnlockAndUnPin();
                 if (next == INVALID_PAGE_ID) {
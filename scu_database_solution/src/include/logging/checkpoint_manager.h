@@ -0,0 +1,65 @@
+/**
+ * checkpoint_manager.h
+ * Fuzzy checkpoints bound the log recovery has to read: a checkpoint records
+ * the active transaction table and the dirty page table without stopping the
+ * system, and remembers where it is in the header page.
+ */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "buffer/buffer_pool_manager.h"
+#include "concurrency/transaction_manager.h"
+#include "logging/log_manager.h"
+
+namespace scudb {
+
+class CheckpointManager {
+public:
+  CheckpointManager(TransactionManager *transaction_manager,
+                    LogManager *log_manager,
+                    BufferPoolManager *buffer_pool_manager,
+                    DiskManager *disk_manager)
+      : transaction_manager_(transaction_manager), log_manager_(log_manager),
+        buffer_pool_manager_(buffer_pool_manager), disk_manager_(disk_manager),
+        last_checkpoint_lsn_(INVALID_LSN), num_checkpoints_(0),
+        running_(false), checkpoint_thread_(nullptr) {}
+
+  ~CheckpointManager() {
+    if (checkpoint_thread_ != nullptr)
+      StopCheckpointThread();
+  }
+
+  // take one fuzzy checkpoint, returns the lsn of its BEGIN_CHECKPOINT
+  lsn_t Checkpoint();
+
+  // take a checkpoint every interval in a separate thread
+  void StartCheckpointThread(std::chrono::milliseconds interval);
+  void StopCheckpointThread();
+
+  inline lsn_t GetLastCheckpointLSN() { return last_checkpoint_lsn_; }
+  inline int GetNumCheckpoints() { return num_checkpoints_; }
+
+private:
+  void CheckpointThread(std::chrono::milliseconds interval);
+
+  TransactionManager *transaction_manager_;
+  LogManager *log_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  DiskManager *disk_manager_;
+  // one checkpoint at a time
+  std::mutex checkpoint_latch_;
+  std::atomic<lsn_t> last_checkpoint_lsn_;
+  std::atomic<int> num_checkpoints_;
+  // checkpoint thread
+  std::mutex latch_;
+  std::condition_variable cv_;
+  bool running_;
+  std::thread *checkpoint_thread_;
+};
+
+} // namespace scudb
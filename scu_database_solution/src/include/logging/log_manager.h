@@ -3,13 +3,22 @@
  * log manager maintain a separate thread that is awaken when the log buffer is
  * full or time out(every X second) to write log buffer's content into disk log
  * file.
+ * The log can be striped over several log files. A striped log manager routes
+ * the records of a transaction to one stripe, each stripe has its own buffers
+ * and flush thread and writes its own file. LSNs stay globally ordered: the
+ * lsn of stripe k is clock * num_stripes + k, and a record on a page last
+ * logged by another stripe gets a clock past the page LSN. Such a record is
+ * only written once the other stripe has written the page LSN.
  */
 
 #pragma once
 #include <algorithm>
 #include <condition_variable>
 #include <future>
+#include <map>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 #include "disk/disk_manager.h"
 #include "logging/log_record.h"
@@ -18,49 +27,194 @@ namespace scudb {
 
 class LogManager {
 public:
-  LogManager(DiskManager *disk_manager)
-      : next_lsn_(0), persistent_lsn_(INVALID_LSN),
-        disk_manager_(disk_manager) {
-    // TODO: you may intialize your own defined memeber variables here
-    log_buffer_ = new char[LOG_BUFFER_SIZE];
-    flush_buffer_ = new char[LOG_BUFFER_SIZE];
+  LogManager(DiskManager *disk_manager, int num_stripes = 1)
+      : LogManager(disk_manager, 0,
+                   std::min(std::max(num_stripes, 1), MAX_LOG_STRIPES)) {
+    if (num_stripes_ > 1) {
+      disk_manager_->SetNumLogStripes(num_stripes_);
+      for (int stripe = 0; stripe < num_stripes_; stripe++) {
+        stripes_.push_back(new LogManager(disk_manager, stripe, num_stripes_));
+        stripes_.back()->router_ = this;
+      }
+    }
   }
 
   ~LogManager() {
-    delete[] log_buffer_;
-    delete[] flush_buffer_;
-    log_buffer_ = nullptr;
-    flush_buffer_ = nullptr;
+    if (flush_thread_ != nullptr)
+      StopFlushThread();
+    for (int i = 0; i < 2; i++) {
+      delete[] buffers_[i];
+      buffers_[i] = nullptr;
+    }
+    for (auto stripe : stripes_)
+      delete stripe;
   }
   // spawn a separate thread to wake up periodically to flush
   void RunFlushThread();
   void StopFlushThread();
 
-  // append a log record into log buffer
-  lsn_t AppendLogRecord(LogRecord &log_record);
+  // append a log record into log buffer, min_lsn is the LSN of the page the
+  // record changes, if any: the record gets a larger lsn
+  lsn_t AppendLogRecord(LogRecord &log_record, lsn_t min_lsn = INVALID_LSN);
+
+  // flush now and wait until every record up to lsn is on disk. The waits
+  // below return false instead when the log failed or the flush thread was
+  // stopped first, the record may never be durable then
+  bool ForceFlush(lsn_t lsn);
+  // wake up the flush thread early, without waiting for it
+  void RequestFlush();
+  // wait until the COMMIT record at lsn is on disk, sharing the flush
+  bool WaitForCommit(lsn_t lsn);
+
+  // asynchronous commit: the record at lsn is made durable within the async
+  // commit window, without waiting for it
+  void AsyncCommit(lsn_t lsn);
+  // wait until every record up to lsn is on disk, without forcing a flush
+  bool WaitForDurable(lsn_t lsn);
+  void SetAsyncCommitWindow(std::chrono::microseconds window);
+
+  // log offset at or before the record at lsn, e.g. where recovery must
+  // start reading to see it. Offsets of a striped log are those of stripe 0,
+  // which gets the checkpoint records
+  int64_t GetOffsetLowerBound(lsn_t lsn);
+  void TruncateOffsetIndex(lsn_t lsn);
+  // drop the log below lsn, from every stripe
+  void RecycleLog(lsn_t lsn);
+
+  // group commit: once a committer waits, the flush thread waits up to delay
+  // for batch_size committers before it writes the log
+  void SetGroupCommit(std::chrono::microseconds delay, int batch_size);
+  // average number of commits made durable by one log write
+  double GetAverageGroupSize();
 
   // get/set helper functions
-  inline lsn_t GetPersistentLSN() { return persistent_lsn_; }
-  inline void SetPersistentLSN(lsn_t lsn) { persistent_lsn_ = lsn; }
-  inline char *GetLogBuffer() { return log_buffer_; }
+  lsn_t GetPersistentLSN();
+  void SetPersistentLSN(lsn_t lsn);
+  // a lower bound of the lsn the next appended record will get
+  lsn_t GetNextLSN();
+  // continue the lsns of a recovered log, before anything is appended
+  void SetNextLSN(lsn_t lsn);
+  inline char *GetLogBuffer() {
+    if (!stripes_.empty())
+      return stripes_[0]->GetLogBuffer();
+    return buffers_[Generation(reserve_) & 1];
+  }
+  inline int GetNumStripes() const { return num_stripes_; }
 
 private:
-  // TODO: you may add your own member variables
-  // also remember to change constructor accordingly
+  // a single stripe of num_stripes
+  LogManager(DiskManager *disk_manager, int stripe, int num_stripes)
+      : reserve_(0), persistent_lsn_(INVALID_LSN), flush_gen_(0),
+        flushed_offset_(0), running_(false), flush_requested_(false),
+        flush_thread_(nullptr), commit_delay_(0), commit_batch_size_(1),
+        waiting_commits_(0), num_commits_(0), num_commit_groups_(0),
+        stripe_(stripe), num_stripes_(num_stripes), router_(nullptr),
+        num_deps_(0), disk_manager_(disk_manager) {
+    // buffers must start zeroed, a zero size marks an unfinished record
+    for (int i = 0; i < 2; i++) {
+      buffers_[i] = new char[LOG_BUFFER_SIZE]();
+      sealed_size_[i] = -1;
+    }
+    buffer_free_[0] = false;
+    buffer_free_[1] = true;
+  }
+
+  /*
+   * Layout of the reservation word: clock of the next lsn in the high 32
+   * bits, buffer generation in the next 8 bits and bytes reserved in the
+   * current buffer in the low 24 bits. One fetch_add of (1 << 32) + size both
+   * assigns the lsn and reserves the space of a record.
+   */
+  static constexpr int OFFSET_BITS = 24;
+  static constexpr uint64_t OFFSET_MASK = (1ULL << OFFSET_BITS) - 1;
+  static constexpr uint64_t LSN_ONE = 1ULL << 32;
+  static inline int Offset(uint64_t word) {
+    return static_cast<int>(word & OFFSET_MASK);
+  }
+  static inline uint32_t Generation(uint64_t word) {
+    return static_cast<uint32_t>((word >> OFFSET_BITS) & 0xFF);
+  }
+  inline lsn_t NextLSN(uint64_t word) const {
+    return static_cast<lsn_t>(word >> 32) * num_stripes_ + stripe_;
+  }
+  // the first clock of this stripe whose lsn is at least lsn
+  inline uint32_t ClockAt(lsn_t lsn) const {
+    return lsn <= stripe_ ? 0 : (lsn - stripe_ + num_stripes_ - 1) /
+                                    num_stripes_;
+  }
+  // stripe of a transaction and stripe that logged lsn
+  inline LogManager *Route(txn_id_t txn_id) {
+    return stripes_[txn_id == INVALID_TXN_ID ? 0 : txn_id % num_stripes_];
+  }
+  inline LogManager *Owner(lsn_t lsn) {
+    return stripes_[lsn % num_stripes_];
+  }
+
+  void FlushThread();
+  bool DrainLogBuffers();
+  void SwitchBuffer(uint32_t generation);
+  void Advance(lsn_t lsn);
+  void AddDependency(lsn_t lsn, lsn_t dependency);
+  bool DependencyDurable(lsn_t lsn);
+  static void SerializeLogRecord(char *dest, LogRecord &log_record);
+  // true once waiting for the persistent lsn is pointless, caller holds latch_
+  inline bool Stalled() const {
+    return !running_ || disk_manager_->IsLogFailed();
+  }
 
-  // atomic counter, record the next log sequence number
-  std::atomic<lsn_t> next_lsn_;
+  // reservation word, see above
+  std::atomic<uint64_t> reserve_;
   // log records before & include persistent_lsn_ have been written to disk
   std::atomic<lsn_t> persistent_lsn_;
-  // log buffer related
-  char *log_buffer_;
-  char *flush_buffer_;
+  // the two log buffers, appenders fill one while the other is written out
+  char *buffers_[2];
+  // bytes of valid records once a buffer is full, -1 while it is open
+  std::atomic<int> sealed_size_[2];
+  // a buffer is free once it has been written out and zeroed
+  std::atomic<bool> buffer_free_[2];
+  // owned by the flush thread: buffer generation it drains and bytes written
+  uint32_t flush_gen_;
+  int flushed_offset_;
+  // log file offset of the next byte written and of the next sampled record
+  int64_t log_offset_ = 0;
+  int64_t next_index_offset_ = 0;
+  // sampled lsn to log offset index, for checkpoints
+  std::map<lsn_t, int64_t> offset_index_;
+  std::mutex index_latch_;
   // latch to protect shared member variables
   std::mutex latch_;
   // flush thread
+  bool running_;
+  bool flush_requested_;
   std::thread *flush_thread_;
   // for notifying flush thread
   std::condition_variable cv_;
+  // for appenders waiting on a full log buffer
+  std::condition_variable append_cv_;
+  // for threads waiting on persistent_lsn_
+  std::condition_variable flushed_cv_;
+  // group commit settings and statistics
+  std::chrono::microseconds commit_delay_;
+  int commit_batch_size_;
+  int waiting_commits_;
+  bool commit_requested_ = false;
+  lsn_t last_group_lsn_ = INVALID_LSN;
+  // async commit: the flush thread writes the log by async_deadline_
+  std::chrono::microseconds async_window_ = std::chrono::milliseconds(10);
+  std::chrono::steady_clock::time_point async_deadline_ =
+      std::chrono::steady_clock::time_point::max();
+  std::atomic<int> num_commits_;
+  std::atomic<int> num_commit_groups_;
+  // striping: the router owns the stripes, a stripe knows its router
+  int stripe_;
+  int num_stripes_;
+  std::vector<LogManager *> stripes_;
+  LogManager *router_;
+  // records of this stripe that wait for another stripe, lsn to the lsn
+  // that must be on disk first
+  std::map<lsn_t, lsn_t> deps_;
+  std::atomic<int> num_deps_;
+  std::mutex deps_latch_;
   // disk manager
   DiskManager *disk_manager_;
 };
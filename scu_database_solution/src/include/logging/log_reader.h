@@ -0,0 +1,49 @@
+/**
+ * log_reader.h
+ * Streaming reader of the log for recovery. The log is read in large chunks
+ * aligned to the chunk size, and the next chunk is prefetched on a separate
+ * thread while the current one is parsed. Records are handed out in place,
+ * only a record that straddles two chunks is copied, into a side buffer.
+ */
+
+#pragma once
+#include <future>
+
+#include "disk/disk_manager.h"
+
+namespace scudb {
+
+class LogReader {
+public:
+  LogReader(DiskManager *disk_manager, int64_t offset,
+            int chunk_size = LOG_READ_CHUNK_SIZE, int stripe = 0);
+  ~LogReader();
+
+  // the next complete record and its log offset. The record stays valid until
+  // the next call. Returns false at the end of the log or at a torn record
+  bool Next(const char *&record, int64_t &offset);
+
+private:
+  void Seek(int64_t offset);
+  bool NextChunk();
+  void Prefetch();
+  int ReadChunk(char *chunk, int64_t chunk_offset);
+
+  DiskManager *disk_manager_;
+  // the log file read, when the log is striped
+  int stripe_;
+  int chunk_size_;
+  int64_t end_offset_;
+  // the chunk being parsed and the one being prefetched
+  char *chunks_[2];
+  int current_;
+  int64_t chunk_offset_;
+  int chunk_length_;
+  int pos_;
+  // valid bytes of the prefetched chunk
+  std::future<int> prefetch_;
+  // a record that straddles two chunks
+  char *straddle_;
+};
+
+} // namespace scudb
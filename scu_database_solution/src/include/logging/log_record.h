@@ -2,30 +2,52 @@
  * log_record.h
  * For every write opeartion on table page, you should write ahead a
  * corresponding log record.
- * For EACH log record, HEADER is like (5 fields in common, 20 bytes in totoal)
+ * Fields marked (v) are varints: 7 bits per byte, low bits first, the high
+ * bit set on all but the last byte. Ids and lsns are stored plus one, so
+ * that the invalid -1 takes a single byte.
+ * For EACH log record, HEADER is like (5 fields in common, 9 to 19 bytes)
  *-------------------------------------------------------------
- * | size | LSN | transID | prevLSN | LogType |
+ * | size | LSN | LogType(1 byte) | transID(v) | prevLSN(v) |
  *-------------------------------------------------------------
+ * size and LSN keep 4 bytes: appenders publish the size last with an atomic
+ * store, and the LSN is only known once the space is reserved.
+ * A compensation record (CLR), logged by recovery for every record it undoes,
+ * is a record of the type that redoes the undo with the high bit of LogType
+ * set. Its header goes on with | undoNextLSN(v) |, the prevLSN of the record
+ * undone: undo continues there and never undoes a CLR.
+ * A RID is | page_id(v) | slot_num(v) |, a tuple is | tuple_size(v) | data |
  * For insert type log record
  *-------------------------------------------------------------
- * | HEADER | tuple_rid | tuple_size | tuple_data(char[] array) |
+ * | HEADER | tuple_rid | tuple |
  *-------------------------------------------------------------
  * For delete type(including markdelete, rollbackdelete, applydelete)
  *-------------------------------------------------------------
- * | HEADER | tuple_rid | tuple_size | tuple_data(char[] array) |
+ * | HEADER | tuple_rid | tuple |
  *-------------------------------------------------------------
- * For update type log record
+ * For update type log record, only the byte range that differs between the
+ * old and the new tuple is logged, recovery takes the rest from the page
  *------------------------------------------------------------------------------
- * | HEADER | tuple_rid | tuple_size | old_tuple_data | tuple_size |
- * | new_tuple_data |
+ * | HEADER | tuple_rid | prefix_size(v) | suffix_size(v) |
+ * | old_range_size(v) | old_range | new_range_size(v) | new_range |
  *------------------------------------------------------------------------------
- * For new page type log record
+ * For new page type log record, the previous page is relative to the page
  *-------------------------------------------------------------
- * | HEADER | prev_page_id |
+ * | HEADER | page_id(v) | page_id - prev_page_id(zigzag v) |
+ *-------------------------------------------------------------
+ * For end checkpoint type log record, prevLSN is the begin checkpoint lsn.
+ * Tables too large for one record are split over several, every one but the
+ * last has a scan_offset of -1
+ *-------------------------------------------------------------
+ * | HEADER | scan_offset | txn_count | (txn_id, last_lsn) ... |
+ * | page_count | (page_id, rec_lsn) ... |
  *-------------------------------------------------------------
  */
 #pragma once
+#include <algorithm>
 #include <cassert>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "table/tuple.h"
@@ -44,11 +66,15 @@ enum class LogRecordType {
   ABORT,
   // when create a new page in heap table
   NEWPAGE,
+  // fuzzy checkpoint
+  BEGIN_CHECKPOINT,
+  END_CHECKPOINT,
 };
 
 class LogRecord {
   friend class LogManager;
   friend class LogRecovery;
+  friend class LogReader;
 
 public:
   LogRecord()
@@ -57,8 +83,10 @@ public:
 
   // constructor for Transaction type(BEGIN/COMMIT/ABORT)
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type)
-      : size_(HEADER_SIZE), lsn_(INVALID_LSN), txn_id_(txn_id),
-        prev_lsn_(prev_lsn), log_record_type_(log_record_type) {}
+      : lsn_(INVALID_LSN), txn_id_(txn_id), prev_lsn_(prev_lsn),
+        log_record_type_(log_record_type) {
+    size_ = GetHeaderSize();
+  }
 
   // constructor for INSERT/DELETE type
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type,
@@ -76,7 +104,7 @@ public:
       delete_tuple_ = tuple;
     }
     // calculate log record size
-    size_ = HEADER_SIZE + sizeof(RID) + sizeof(int32_t) + tuple.GetLength();
+    size_ = GetHeaderSize() + RIDSize(rid) + TupleSize(tuple.GetLength());
   }
 
   // constructor for UPDATE type
@@ -86,21 +114,61 @@ public:
       : lsn_(INVALID_LSN), txn_id_(txn_id), prev_lsn_(prev_lsn),
         log_record_type_(log_record_type), update_rid_(update_rid),
         old_tuple_(old_tuple), new_tuple_(new_tuple) {
+    // the bytes both tuples start and end with are left out
+    const char *old_data = old_tuple.GetData();
+    const char *new_data = new_tuple.GetData();
+    int old_size = old_tuple.GetLength(), new_size = new_tuple.GetLength();
+    int common = std::min(old_size, new_size);
+    while (update_prefix_ < common &&
+           old_data[update_prefix_] == new_data[update_prefix_])
+      update_prefix_++;
+    while (update_prefix_ + update_suffix_ < common &&
+           old_data[old_size - update_suffix_ - 1] ==
+               new_data[new_size - update_suffix_ - 1])
+      update_suffix_++;
     // calculate log record size
-    size_ = HEADER_SIZE + sizeof(RID) + old_tuple.GetLength() +
-            new_tuple.GetLength() + 2 * sizeof(int32_t);
+    size_ = GetHeaderSize() + RIDSize(update_rid) + VarintSize(update_prefix_) +
+            VarintSize(update_suffix_) +
+            TupleSize(old_size - update_prefix_ - update_suffix_) +
+            TupleSize(new_size - update_prefix_ - update_suffix_);
   }
 
   // constructor for NEWPAGE type
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type,
-            page_id_t page_id)
-      : size_(HEADER_SIZE), lsn_(INVALID_LSN), txn_id_(txn_id),
-        prev_lsn_(prev_lsn), log_record_type_(log_record_type),
-        prev_page_id_(page_id) {
+            page_id_t prev_page_id, page_id_t page_id)
+      : lsn_(INVALID_LSN), txn_id_(txn_id), prev_lsn_(prev_lsn),
+        log_record_type_(log_record_type), prev_page_id_(prev_page_id),
+        page_id_(page_id) {
     // calculate log record size
-    size_ = HEADER_SIZE + sizeof(page_id_t);
+    size_ = GetHeaderSize() + VarintSize(page_id + 1) +
+            VarintSize(ZigZag(page_id - prev_page_id));
   }
 
+  // constructor for END_CHECKPOINT type
+  LogRecord(lsn_t begin_lsn, int64_t scan_offset,
+            const std::vector<std::pair<txn_id_t, lsn_t>> &active_txns,
+            const std::vector<std::pair<page_id_t, lsn_t>> &dirty_pages)
+      : lsn_(INVALID_LSN), txn_id_(INVALID_TXN_ID), prev_lsn_(begin_lsn),
+        log_record_type_(LogRecordType::END_CHECKPOINT),
+        scan_offset_(scan_offset), active_txns_(active_txns),
+        dirty_pages_(dirty_pages) {
+    // calculate log record size
+    size_ = GetHeaderSize() + sizeof(int64_t) + 2 * sizeof(int32_t) +
+            (active_txns.size() + dirty_pages.size()) * 2 * sizeof(int32_t);
+  }
+  // make this the compensation record of an undone record whose prevLSN was
+  // undo_next_lsn
+  inline void SetUndoNextLSN(lsn_t undo_next_lsn) {
+    assert(!compensation_);
+    compensation_ = true;
+    undo_next_lsn_ = undo_next_lsn;
+    size_ += VarintSize(undo_next_lsn + 1);
+  }
+  // table entries one END_CHECKPOINT record carries at most, so that it takes
+  // no more than half a log buffer: 8 bytes an entry after a header of up to
+  // 19 bytes, the scan offset and both counts
+  static const int CHECKPOINT_ENTRIES = (LOG_BUFFER_SIZE / 2 - 35) / 8;
+
   ~LogRecord() {}
 
   inline RID &GetDeleteRID() { return delete_rid_; }
@@ -111,6 +179,18 @@ public:
 
   inline page_id_t GetNewPageRecord() { return prev_page_id_; }
 
+  inline page_id_t GetNewPageId() { return page_id_; }
+
+  inline int64_t GetScanOffset() { return scan_offset_; }
+
+  inline std::vector<std::pair<txn_id_t, lsn_t>> &GetActiveTxns() {
+    return active_txns_;
+  }
+
+  inline std::vector<std::pair<page_id_t, lsn_t>> &GetDirtyPages() {
+    return dirty_pages_;
+  }
+
   inline int32_t GetSize() { return size_; }
 
   inline lsn_t GetLSN() { return lsn_; }
@@ -121,6 +201,10 @@ public:
 
   inline LogRecordType &GetLogRecordType() { return log_record_type_; }
 
+  inline bool IsCompensation() { return compensation_; }
+
+  inline lsn_t GetUndoNextLSN() { return undo_next_lsn_; }
+
   // For debug purpose
   inline std::string ToString() const {
     std::ostringstream os;
@@ -135,6 +219,48 @@ public:
   }
 
 private:
+  inline int GetHeaderSize() {
+    return HEADER_SIZE + VarintSize(txn_id_ + 1) + VarintSize(prev_lsn_ + 1) +
+           (compensation_ ? VarintSize(undo_next_lsn_ + 1) : 0);
+  }
+  static inline int RIDSize(const RID &rid) {
+    return VarintSize(rid.GetPageId() + 1) + VarintSize(rid.GetSlotNum());
+  }
+  static inline int TupleSize(int32_t size) { return VarintSize(size) + size; }
+
+  // varint helpers, see above
+  static inline int VarintSize(uint32_t value) {
+    int size = 1;
+    for (; value >= 0x80; value >>= 7)
+      size++;
+    return size;
+  }
+  static inline int PutVarint(char *dest, uint32_t value) {
+    int size = 0;
+    for (; value >= 0x80; value >>= 7)
+      dest[size++] = static_cast<char>(value | 0x80);
+    dest[size++] = static_cast<char>(value);
+    return size;
+  }
+  // @return: bytes read, 0 if the varint does not end within limit bytes
+  static inline int GetVarint(const char *src, int limit, uint32_t &value) {
+    value = 0;
+    for (int i = 0; i < limit && i < 5; i++) {
+      value |= static_cast<uint32_t>(src[i] & 0x7F) << (7 * i);
+      if ((src[i] & 0x80) == 0)
+        return i + 1;
+    }
+    return 0;
+  }
+  // small negative numbers as small varints
+  static inline uint32_t ZigZag(int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^
+           static_cast<uint32_t>(value >> 31);
+  }
+  static inline int32_t UnZigZag(uint32_t value) {
+    return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+  }
+
   // the length of log record(for serialization, in bytes)
   int32_t size_ = 0;
   // must have fields
@@ -142,6 +268,9 @@ private:
   txn_id_t txn_id_ = INVALID_TXN_ID;
   lsn_t prev_lsn_ = INVALID_LSN;
   LogRecordType log_record_type_ = LogRecordType::INVALID;
+  // for compensation records, see above
+  bool compensation_ = false;
+  lsn_t undo_next_lsn_ = INVALID_LSN;
 
   // case1: for delete opeartion, delete_tuple_ for UNDO opeartion
   RID delete_rid_;
@@ -151,14 +280,29 @@ private:
   RID insert_rid_;
   Tuple insert_tuple_;
 
-  // case3: for update opeartion
+  // case3: for update opeartion, bytes shared by the old and the new tuple at
+  // either end. A record read back from the log only has the ranges between
   RID update_rid_;
   Tuple old_tuple_;
   Tuple new_tuple_;
+  int32_t update_prefix_ = 0;
+  int32_t update_suffix_ = 0;
+  std::string old_range_;
+  std::string new_range_;
 
   // case4: for new page opeartion
   page_id_t prev_page_id_ = INVALID_PAGE_ID;
-  const static int HEADER_SIZE = 20;
+  page_id_t page_id_ = INVALID_PAGE_ID;
+
+  // case5: for end checkpoint, where recovery starts reading the log, the
+  // active transaction table and the dirty page table
+  int64_t scan_offset_ = 0;
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txns_;
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages_;
+  // size, LSN and LogType, the fixed part of the header
+  const static int HEADER_SIZE = 9;
+  // LogType bit of compensation records
+  const static int COMPENSATION_FLAG = 0x80;
 }; // namespace scudb
 
 } // namespace scudb
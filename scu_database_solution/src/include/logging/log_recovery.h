@@ -5,23 +5,47 @@
 
 #pragma once
 #include <algorithm>
+#include <functional>
 #include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/lock_manager.h"
+#include "logging/log_manager.h"
+#include "logging/log_reader.h"
 #include "logging/log_record.h"
+#include "page/table_page.h"
 
 namespace scudb {
 
+/*
+ * ARIES style recovery, to be run before the log manager starts logging.
+ * Redo first runs the analysis pass which builds the active transaction
+ * table and the dirty page table, then replays the log in parallel: records
+ * are split by page id across num_redo_threads workers, so every page sees
+ * its records in LSN order. Undo then rolls back the loser transactions.
+ * The log is read from the scan offset of the last checkpoint, if any. A
+ * striped log is read from the start of every stripe, the stripes are merged
+ * in lsn order.
+ */
 class LogRecovery {
 public:
   LogRecovery(DiskManager *disk_manager,
-                    BufferPoolManager *buffer_pool_manager)
+                    BufferPoolManager *buffer_pool_manager,
+                    int num_redo_threads = 0)
       : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager),
-        offset_(0) {
+        max_lsn_(INVALID_LSN) {
     // global transaction through recovery phase
     log_buffer_ = new char[LOG_BUFFER_SIZE];
+    // every worker pins up to two pages at a time
+    int max_threads = std::max(
+        1, static_cast<int>(buffer_pool_manager_->GetPoolSize() / 2));
+    if (num_redo_threads <= 0)
+      num_redo_threads = std::thread::hardware_concurrency();
+    num_redo_threads_ = std::min(std::max(num_redo_threads, 1), max_threads);
   }
 
   ~LogRecovery() {
@@ -30,21 +54,59 @@ public:
   }
 
   void Redo();
-  void Undo();
+  bool Undo(LogManager *log_manager = nullptr);
   bool DeserializeLogRecord(const char *data, LogRecord &log_record);
 
+  // the log manager must continue after the last lsn found in the log
+  inline lsn_t GetNextLSN() { return max_lsn_ + 1; }
+  inline int GetNumRedoThreads() { return num_redo_threads_; }
+  // where analysis and redo started reading the log
+  inline int64_t GetScanOffset() { return scan_offset_; }
+  // transactions rolled back by Undo and their last lsn. Unless Undo logged
+  // their ABORT records, each needs one once their pages are written back,
+  // or the next recovery would undo them again
+  inline const std::vector<std::pair<txn_id_t, lsn_t>> &GetLosers() {
+    return losers_;
+  }
+  inline void SetReadChunkSize(int chunk_size) { chunk_size_ = chunk_size; }
+
 private:
-  // TODO: you can add whatever member variable here
-  // Don't forget to initialize newly added variable in constructor
+  void Analysis();
+  void ScanLog(int64_t offset,
+               const std::function<bool(LogRecord &, int, int64_t)> &handler,
+               std::vector<int64_t> *ends = nullptr);
+  bool ReadLogRecord(lsn_t lsn, LogRecord &log_record);
+  void RedoPartition(std::vector<LogRecord> &log_records, int partition);
+  void RedoRecord(LogRecord &log_record);
+  void LinkPage(page_id_t prev_page_id, page_id_t page_id);
+  bool UndoRecord(LogRecord &log_record);
+  bool ReleasePages();
+  bool PatchTuple(TablePage *page, LogRecord &log_record, bool undo,
+                  Tuple &tuple);
+  Page *FetchPage(page_id_t page_id);
+  static page_id_t GetRecordPageId(LogRecord &log_record);
+
   DiskManager *disk_manager_;
   BufferPoolManager *buffer_pool_manager_;
   // maintain active transactions and its corresponds latest lsn
   std::unordered_map<txn_id_t, lsn_t> active_txn_;
-  // mapping log sequence number to log file offset, for undo purpose
-  std::unordered_map<lsn_t, int> lsn_mapping_;
-  // log buffer related
-  int offset_;
+  // the active transactions undone
+  std::vector<std::pair<txn_id_t, lsn_t>> losers_;
+  // while undo logs: pages held until their CLRs are on disk, last CLR lsn
+  LogManager *log_manager_ = nullptr;
+  std::vector<page_id_t> held_pages_;
+  lsn_t last_lsn_ = INVALID_LSN;
+  // mapping log sequence number to stripe and log file offset, for undo
+  std::unordered_map<lsn_t, std::pair<int, int64_t>> lsn_mapping_;
+  // dirty page table, page id to the first lsn that may have dirtied it
+  std::unordered_map<page_id_t, lsn_t> dirty_page_table_;
+  // log buffer related, records are read one by one for undo and streamed in
+  // chunks of chunk_size_ for analysis and redo
   char *log_buffer_;
+  int chunk_size_ = LOG_READ_CHUNK_SIZE;
+  lsn_t max_lsn_;
+  int64_t scan_offset_ = 0;
+  int num_redo_threads_;
 };
 
 } // namespace scudb
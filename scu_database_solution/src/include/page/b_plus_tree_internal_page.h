@@ -12,6 +12,10 @@
  *  --------------------------------------------------------------------------
  * | HEADER | KEY(1)+PAGE_ID(1) | KEY(2)+PAGE_ID(2) | ... | KEY(n)+PAGE_ID(n) |
  *  --------------------------------------------------------------------------
+ *
+ * The header ends with the right link, the level and the high key used by a
+ * B-link tree: every key under the page is below the high key, the rightmost
+ * page of a level has no high key. The level of a leaf is 0.
  */
 
 #pragma once
@@ -43,6 +47,24 @@ namespace scudb {
 
         ValueType Lookup(const KeyType &key, const KeyComparator &comparator) const;
 
+        inline page_id_t GetRightPageId() const { return right_page_id_; }
+        inline void SetRightPageId(page_id_t right_page_id) {
+            right_page_id_ = right_page_id;
+        }
+        inline int GetLevel() const { return level_; }
+        inline void SetLevel(int level) { level_ = level; }
+        inline KeyType GetHighKey() const { return high_key_; }
+        inline void SetHighKey(const KeyType &high_key) { high_key_ = high_key; }
+        // the right sibling if key is at or past the high key,
+        // INVALID_PAGE_ID if key belongs under this page
+        inline page_id_t RightLinkFor(const KeyType &key,
+                                      const KeyComparator &comparator) const {
+            if (right_page_id_ != INVALID_PAGE_ID &&
+                comparator(key, high_key_) >= 0)
+                return right_page_id_;
+            return INVALID_PAGE_ID;
+        }
+
         void PopulateNewRoot(const ValueType &old_value, const KeyType &new_key,
                              const ValueType &new_value);
 
@@ -85,6 +107,9 @@ namespace scudb {
         void CopyFirstFrom(const MappingType &pair, int parent_index,
                            BufferPoolManager *buffer_pool_manager);
 
+        page_id_t right_page_id_;
+        int level_;
+        KeyType high_key_;
         MappingType array[0];
     };
 } // namespace scudb
@@ -14,9 +14,12 @@
  *  ---------------------------------------------------------------------
  * | PageType (4) | CurrentSize (4) | MaxSize (4) | ParentPageId (4) |
  *  ---------------------------------------------------------------------
- *  ------------------------------
- * | PageId (4) | NextPageId (4)
- *  ------------------------------
+ *  ------------------------------------------------
+ * | PageId (4) | NextPageId (4) | HighKey (key size)
+ *  ------------------------------------------------
+ *
+ * In a B-link tree the next page is the right link, every key of the page is
+ * below the high key. The rightmost leaf has no high key.
  */
 #pragma once
 #include <utility>
@@ -38,6 +41,16 @@ public:
   // helper methods
   page_id_t GetNextPageId() const;
   void SetNextPageId(page_id_t next_page_id);
+  inline KeyType GetHighKey() const { return high_key_; }
+  inline void SetHighKey(const KeyType &high_key) { high_key_ = high_key; }
+  // the right sibling if key is at or past the high key, INVALID_PAGE_ID if
+  // key belongs to this page
+  inline page_id_t RightLinkFor(const KeyType &key,
+                                const KeyComparator &comparator) const {
+    if (next_page_id_ != INVALID_PAGE_ID && comparator(key, high_key_) >= 0)
+      return next_page_id_;
+    return INVALID_PAGE_ID;
+  }
   KeyType KeyAt(int index) const;
   int KeyIndex(const KeyType &key, const KeyComparator &comparator) const;
   const MappingType &GetItem(int index);
@@ -68,6 +81,7 @@ private:
   void CopyFirstFrom(const MappingType &item, int parentIndex,
                      BufferPoolManager *buffer_pool_manager);
   page_id_t next_page_id_;
+  KeyType high_key_;
   MappingType array[0];
 };
 } // namespace scudb
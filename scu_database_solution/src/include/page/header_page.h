@@ -9,6 +9,10 @@
  *  -----------------------------------------------------------------
  * | RecordCount (4) | Entry_1 name (32) | Entry_1 root_id (4) | ... |
  *  -----------------------------------------------------------------
+ * The last 16 bytes of the page are reserved for the last checkpoint:
+ *  ---------------------------------------------------------------
+ * | ... | Checkpoint lsn (4) | Log offset (8) | Checkpoint magic (4) |
+ *  ---------------------------------------------------------------
  */
 
 #pragma once
@@ -33,7 +37,20 @@ public:
   bool GetRootId(const std::string &name, page_id_t &root_id);
   int GetRecordCount();
 
+  /**
+   * Checkpoint related, the lsn and log offset of the last checkpoint live in
+   * the reserved tail of the page, false if no checkpoint was taken yet
+   */
+  void SetCheckpoint(lsn_t lsn, int64_t offset);
+  bool GetCheckpoint(lsn_t &lsn, int64_t &offset);
+
 private:
+  static constexpr int CHECKPOINT_LSN_OFFSET = PAGE_SIZE - 16;
+  static constexpr int CHECKPOINT_LOG_OFFSET = PAGE_SIZE - 12;
+  static constexpr int CHECKPOINT_MAGIC_OFFSET = PAGE_SIZE - 4;
+  // tells a checkpoint from the zeros of a header page that never had one
+  static constexpr uint32_t CHECKPOINT_MAGIC = 0x43484b50;
+
   /**
    * helper functions
    */
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstring>
 #include <iostream>
 
@@ -20,7 +21,7 @@ class Page {
   friend class BufferPoolManager;
 
 public:
-  Page() { ResetMemory(); }
+  Page() {}
   ~Page(){};
   // get actual data page content
   inline char *GetData() { return data_; }
@@ -28,12 +29,30 @@ public:
   inline page_id_t GetPageId() { return page_id_; }
   // get page pin count
   inline int GetPinCount() { return pin_count_; }
-  // method use to latch/unlatch page content
-  inline void WUnlatch() { rwlatch_.WUnlock(); }
-  inline void WLatch() { rwlatch_.WLock(); }
+  // method use to latch/unlatch page content, a writer makes the version odd
+  // while it holds the latch and leaves a new even one
+  inline void WUnlatch() {
+    version_.fetch_add(1, std::memory_order_release);
+    rwlatch_.WUnlock();
+  }
+  inline void WLatch() {
+    rwlatch_.WLock();
+    version_.fetch_add(1, std::memory_order_acquire);
+  }
   inline void RUnlatch() { rwlatch_.RUnlock(); }
   inline void RLatch() { rwlatch_.RLock(); }
 
+  // optimistic read without the latch: take the version, read the pinned
+  // page, then the read is consistent if the version is even and unchanged
+  inline uint32_t GetVersion() {
+    return version_.load(std::memory_order_acquire);
+  }
+  inline bool ValidateVersion(uint32_t version) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return (version & 1) == 0 &&
+           version_.load(std::memory_order_relaxed) == version;
+  }
+
   inline lsn_t GetLSN() { return *reinterpret_cast<lsn_t *>(GetData() + 4); }
   inline void SetLSN(lsn_t lsn) { memcpy(GetData() + 4, &lsn, 4); }
 
@@ -41,11 +60,15 @@ private:
   // method used by buffer pool manager
   inline void ResetMemory() { memset(data_, 0, PAGE_SIZE); }
   // members
-  char data_[PAGE_SIZE]; // actual data
+  // actual data, either a buffer pool frame or a page of the read-only mapping
+  char *data_ = nullptr;
   page_id_t page_id_ = INVALID_PAGE_ID;
   int pin_count_ = 0;
   bool is_dirty_ = false;
+  // recLSN, no record before it touched the frame since it was last clean
+  lsn_t rec_lsn_ = INVALID_LSN;
   RWMutex rwlatch_;
+  std::atomic<uint32_t> version_{0};
 };
 
 } // namespace scudb
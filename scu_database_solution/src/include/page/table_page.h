@@ -46,30 +46,43 @@ public:
   /**
    * Tuple related
    */
+  // tuples are locked under a lock on table table_id when it is valid,
+  // InsertTuple returns rid if success
   bool InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn,
-                   LockManager *lock_manager,
-                   LogManager *log_manager); // return rid if success
+                   LockManager *lock_manager, LogManager *log_manager,
+                   page_id_t table_id = INVALID_PAGE_ID);
   bool MarkDelete(const RID &rid, Transaction *txn, LockManager *lock_manager,
-                  LogManager *log_manager); // delete
+                  LogManager *log_manager,
+                  page_id_t table_id = INVALID_PAGE_ID); // delete
   bool UpdateTuple(const Tuple &new_tuple, Tuple &old_tuple, const RID &rid,
                    Transaction *txn, LockManager *lock_manager,
-                   LogManager *log_manager);
+                   LogManager *log_manager,
+                   page_id_t table_id = INVALID_PAGE_ID);
 
-  // commit/abort time
-  void ApplyDelete(const RID &rid, Transaction *txn,
-                   LogManager *log_manager); // when commit success
+  // commit/abort time, ApplyDelete when commit success, RollbackDelete when
+  // commit abort
+  void ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_manager,
+                   page_id_t table_id = INVALID_PAGE_ID);
   void RollbackDelete(const RID &rid, Transaction *txn,
-                      LogManager *log_manager); // when commit abort
+                      LogManager *log_manager,
+                      page_id_t table_id = INVALID_PAGE_ID);
+  // put a tuple back into its free slot, recovery undoes ApplyDelete with it
+  bool RestoreTuple(const Tuple &tuple, const RID &rid);
 
   // return tuple (with data pointing to heap) if success
   bool GetTuple(const RID &rid, Tuple &tuple, Transaction *txn,
-                LockManager *lock_manager);
+                LockManager *lock_manager,
+                page_id_t table_id = INVALID_PAGE_ID);
+  // copy of a tuple without locking it, false if its slot is free or it is
+  // marked deleted, for snapshot reads
+  bool ReadTuple(const RID &rid, Tuple &tuple);
 
   /**
-   * Tuple iterator
+   * Tuple iterator, all_slots also returns free slots and deleted tuples
    */
-  bool GetFirstTupleRid(RID &first_rid);
-  bool GetNextTupleRid(const RID &cur_rid, RID &next_rid);
+  bool GetFirstTupleRid(RID &first_rid, bool all_slots = false);
+  bool GetNextTupleRid(const RID &cur_rid, RID &next_rid,
+                       bool all_slots = false);
 
 private:
   /**
@@ -85,5 +98,7 @@ private:
                            // actual tuples because some slots may be empty
   void SetTupleCount(int32_t tuple_count);
   int32_t GetFreeSpaceSize();
+  // deep copy of the tuple stored in a slot, for log records
+  Tuple CopyTuple(const RID &rid, int32_t tuple_size);
 };
 } // namespace scudb
@@ -28,7 +28,9 @@ public:
   TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager,
             LogManager *log_manager, Transaction *txn);
 
-  // for insert, if tuple is too large (>~page_size), return false
+  // for insert, if tuple is too large (>~page_size), return false.
+  // An optimistic transaction inserts right away, its updates and deletes
+  // are buffered in its write set and applied at commit.
   bool InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn);
 
   bool MarkDelete(const RID &rid, Transaction *txn); // for delete
@@ -53,6 +55,17 @@ public:
   inline page_id_t GetFirstPageId() const { return first_page_id_; }
 
 private:
+  bool GetSnapshotTuple(TablePage *page, const RID &rid, Tuple &tuple,
+                        Transaction *txn);
+  bool GetOptimisticTuple(TablePage *page, const RID &rid, Tuple &tuple,
+                          Transaction *txn);
+  bool BufferWrite(const RID &rid, WType wtype, const Tuple &tuple,
+                   Transaction *txn);
+  // an optimistic transaction takes no locks
+  inline LockManager *GetLockManager(Transaction *txn) {
+    return txn->IsOptimistic() ? nullptr : lock_manager_;
+  }
+
   /**
    * Members
    */
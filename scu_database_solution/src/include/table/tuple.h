@@ -49,6 +49,8 @@ public:
 
   // deserialize tuple data(deep copy)
   void DeserializeFrom(const char *storage);
+  // deep copy of size bytes of raw tuple data
+  void DeserializeFrom(const char *data, int32_t size);
 
   // return RID of current tuple
   inline RID GetRid() const { return rid_; }
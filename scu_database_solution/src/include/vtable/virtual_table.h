@@ -8,6 +8,7 @@
 #include "catalog/schema.h"
 #include "concurrency/transaction_manager.h"
 #include "index/b_plus_tree_index.h"
+#include "logging/checkpoint_manager.h"
 #include "logging/log_manager.h"
 #include "sqlite/sqlite3ext.h"
 #include "table/table_heap.h"
@@ -62,14 +63,19 @@ int VtabBegin(sqlite3_vtab *pVTab);
 // storage engine
 class StorageEngine {
 public:
-  StorageEngine(std::string db_file_name) {
+  StorageEngine(std::string db_file_name,
+                DurabilityLevel durability = DurabilityLevel::GROUP,
+                bool read_only = false) {
     ENABLE_LOGGING = false;
 
-    // storage related
-    disk_manager_ = new DiskManager(db_file_name);
+    // storage related, a read only engine maps the db file and rejects writes
+    disk_manager_ = new DiskManager(db_file_name, durability, read_only);
 
-    // log related
-    log_manager_ = new LogManager(disk_manager_);
+    // log related, stripes left by a previous run are kept so that
+    // checkpoints recycle them
+    log_manager_ = new LogManager(
+        disk_manager_,
+        std::max(LOG_STRIPES, disk_manager_->GetNumLogStripes()));
 
     buffer_pool_manager_ =
         new BufferPoolManager(BUFFER_POOL_SIZE, disk_manager_, log_manager_);
@@ -77,16 +83,23 @@ public:
     // txn related
     lock_manager_ = new LockManager(true); // S2PL
     transaction_manager_ = new TransactionManager(lock_manager_, log_manager_);
+    checkpoint_manager_ =
+        new CheckpointManager(transaction_manager_, log_manager_,
+                              buffer_pool_manager_, disk_manager_);
   }
 
   ~StorageEngine() {
+    checkpoint_manager_->StopCheckpointThread();
     if (ENABLE_LOGGING)
       log_manager_->StopFlushThread();
+    // write back all dirty pages in one sorted, coalesced batch
+    buffer_pool_manager_->FlushAllPages();
     delete disk_manager_;
     delete buffer_pool_manager_;
     delete log_manager_;
     delete lock_manager_;
     delete transaction_manager_;
+    delete checkpoint_manager_;
   }
 
   DiskManager *disk_manager_;
@@ -94,6 +107,7 @@ public:
   LockManager *lock_manager_;
   TransactionManager *transaction_manager_;
   LogManager *log_manager_;
+  CheckpointManager *checkpoint_manager_;
 };
 
 StorageEngine *storage_engine_;
@@ -118,6 +132,7 @@ public:
       table_heap_ =
           new TableHeap(buffer_pool_manager, lock_manager, log_manager, txn);
       storage_engine_->transaction_manager_->Commit(txn);
+      storage_engine_->transaction_manager_->Release(txn);
     }
   }
 
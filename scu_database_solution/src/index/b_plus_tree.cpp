@@ -1,6 +1,7 @@
 /**
  * b_plus_tree.cpp
  */
+#include <fstream>
 #include <iostream>
 #include <string>
 
@@ -45,6 +46,20 @@ namespace scudb {
     bool BPLUSTREE_TYPE::GetValue(const KeyType &key,
                                   std::vector<ValueType> &result,
                                   Transaction *transaction) {
+        // latch free first, readers only latch when writers keep them
+        // restarting
+        ValueType value;
+        bool found;
+        if (this->OptimisticLookup(key, value, found)) {
+            if (!found && this->IsEmpty())
+                return false;
+            result.resize(1);
+            result[0] = value;
+            return found;
+        }
+        // a B-link descent holds no page set
+        if (blink_)
+            transaction = nullptr;
         // get page
         B_PLUS_TREE_LEAF_PAGE_TYPE *pg = this->FindLeafPage(key, false, OpType::READ, transaction);
         if (pg == nullptr)
@@ -58,6 +73,84 @@ namespace scudb {
 
     }
 
+/*
+ * Optimistic lock coupling: descend without latching, take the version of
+ * every page before reading it and check it afterwards. A child is pinned
+ * before the version of its parent is checked, so the parent still pointed to
+ * it. A page latched by a writer or changed since restarts the descent.
+ * @return : false if the descent restarted too often, found tells whether
+ * key exists otherwise
+ */
+    INDEX_TEMPLATE_ARGUMENTS
+    bool BPLUSTREE_TYPE::OptimisticLookup(const KeyType &key, ValueType &value,
+                                          bool &found) {
+        for (int restart = 0; restart < OLC_MAX_RESTARTS; restart++) {
+            this->mutex_.RLock();
+            page_id_t pageId = this->root_page_id_;
+            this->mutex_.RUnlock();
+            if (pageId == INVALID_PAGE_ID) {
+                found = false;
+                return true;
+            }
+            Page *page = this->buffer_pool_manager_->FetchPage(pageId);
+            if (page == nullptr)
+                return false;
+            uint32_t version = page->GetVersion();
+            auto node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+            // a new root may have been added above the one we read
+            bool valid = node->IsRootPage();
+            while (valid && !node->IsLeafPage()) {
+                auto internal = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node);
+                // sizes read in the middle of a write are not to be trusted
+                if (internal->GetSize() < 2 ||
+                    internal->GetSize() > internal->GetMaxSize() + 1 ||
+                    !page->ValidateVersion(version)) {
+                    valid = false;
+                    break;
+                }
+                page_id_t childId = internal->Lookup(key, comparator_);
+                // a B-link page split since its parent was read
+                if (blink_ && internal->RightLinkFor(key, comparator_) !=
+                              INVALID_PAGE_ID) {
+                    valid = false;
+                    break;
+                }
+                if (!page->ValidateVersion(version)) {
+                    valid = false;
+                    break;
+                }
+                Page *child = this->buffer_pool_manager_->FetchPage(childId);
+                if (child == nullptr) {
+                    valid = false;
+                    break;
+                }
+                uint32_t childVersion = child->GetVersion();
+                valid = page->ValidateVersion(version);
+                this->buffer_pool_manager_->UnpinPage(pageId, false);
+                page = child;
+                pageId = childId;
+                version = childVersion;
+                node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+            }
+            if (valid) {
+                auto leaf = static_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(node);
+                valid = leaf->GetSize() >= 0 &&
+                        leaf->GetSize() <= leaf->GetMaxSize() + 1 &&
+                        page->ValidateVersion(version);
+                if (valid) {
+                    found = leaf->Lookup(key, value, comparator_);
+                    valid = !(blink_ && leaf->RightLinkFor(key, comparator_) !=
+                                        INVALID_PAGE_ID) &&
+                            page->ValidateVersion(version);
+                }
+            }
+            this->buffer_pool_manager_->UnpinPage(pageId, false);
+            if (valid)
+                return true;
+        }
+        return false;
+    }
+
 /*****************************************************************************
  * INSERTION
  *****************************************************************************/
@@ -71,6 +164,13 @@ namespace scudb {
     INDEX_TEMPLATE_ARGUMENTS
     bool BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value,
                                 Transaction *transaction) {
+        // a read only database rejects every writer
+        if (this->buffer_pool_manager_->IsReadOnly()) {
+            return false;
+        }
+        if (blink_) {
+            return this->BLinkInsert(key, value);
+        }
         // 给B+Tree上锁
         this->LockRootPageId(true);
         // tree if is empty if current tree is empty, start new tree,
@@ -205,6 +305,9 @@ namespace scudb {
             assert(newPage->GetPinCount() == 1);
             B_PLUS_TREE_INTERNAL_PAGE *newRoot = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(newPage->GetData());
             newRoot->Init(root_page_id_);
+            if (!old_node->IsLeafPage())
+                newRoot->SetLevel(reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(
+                                      old_node)->GetLevel() + 1);
             newRoot->PopulateNewRoot(old_node->GetPageId(), key, new_node->GetPageId());
             old_node->SetParentPageId(root_page_id_);
             new_node->SetParentPageId(root_page_id_);
@@ -229,6 +332,7 @@ namespace scudb {
         if (ifOverFlow) {
             //split it
             B_PLUS_TREE_INTERNAL_PAGE *newLeafPage = Split(parent, transaction);
+            newLeafPage->SetLevel(parent->GetLevel());
 
             InsertIntoParent(parent, newLeafPage->KeyAt(0), newLeafPage, transaction);
         }
@@ -248,7 +352,18 @@ namespace scudb {
  */
     INDEX_TEMPLATE_ARGUMENTS
     void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
-        if (!this->IsEmpty()) {
+        if (blink_ && !this->buffer_pool_manager_->IsReadOnly()) {
+            // the leaf may underflow, B-link pages are never merged
+            Page *page = this->BLinkDescend(key, false, 0, true, nullptr);
+            if (page != nullptr) {
+                reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData())
+                        ->RemoveAndDeleteRecord(key, comparator_);
+                page->WUnlatch();
+                buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+            }
+            return;
+        }
+        if (!this->IsEmpty() && !this->buffer_pool_manager_->IsReadOnly()) {
             B_PLUS_TREE_LEAF_PAGE_TYPE *CurPage = this->FindLeafPage(key, false, OpType::DELETE, transaction);
 
             int curSize = CurPage->RemoveAndDeleteRecord(key, comparator_);
@@ -476,6 +591,12 @@ namespace scudb {
                                                              OpType op,
                                                              Transaction *transaction) {
         bool exclusive = (op != OpType::READ);
+        if (blink_) {
+            Page *page = BLinkDescend(key, leftMost, 0, exclusive, nullptr);
+            if (page == nullptr)
+                return nullptr;
+            return reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+        }
         LockRootPageId(exclusive);
         if (IsEmpty()) {
             TryUnlockRootPageId(exclusive);
@@ -543,6 +664,209 @@ namespace scudb {
         transaction->GetPageSet()->clear();
     }
 
+/*****************************************************************************
+ * B-LINK
+ *****************************************************************************/
+/*
+ * Descend to the page of the given level (0 for the leaves) that covers key,
+ * holding one latch at a time. A page whose high key key reached was split
+ * after its parent was read, the descent follows its right link. Levels never
+ * change, so the latch mode is chosen before latching.
+ * @return : the page latched (exclusive or shared) and pinned, nullptr if the
+ * tree is empty. The internal pages passed on the way down are added to path
+ * with their level.
+ */
+    INDEX_TEMPLATE_ARGUMENTS
+    Page *BPLUSTREE_TYPE::BLinkDescend(const KeyType &key, bool leftMost,
+                                       int level, bool exclusive,
+                                       std::vector<std::pair<page_id_t, int>> *path) {
+        this->mutex_.RLock();
+        page_id_t pageId = this->root_page_id_;
+        this->mutex_.RUnlock();
+        if (pageId == INVALID_PAGE_ID)
+            return nullptr;
+        for (;;) {
+            Page *page = this->buffer_pool_manager_->FetchPage(pageId);
+            auto node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+            int pageLevel = node->IsLeafPage()
+                            ? 0
+                            : static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node)->GetLevel();
+            assert(pageLevel >= level);
+            bool latchMode = exclusive && pageLevel == level;
+            Lock(latchMode, page);
+            // the left most page of a level is never split away from
+            if (!leftMost)
+                page = this->MoveRight(page, key, latchMode);
+            if (pageLevel == level)
+                return page;
+            if (path != nullptr)
+                path->emplace_back(page->GetPageId(), pageLevel);
+            auto internal = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(page->GetData());
+            pageId = leftMost ? internal->ValueAt(0) : internal->Lookup(key, comparator_);
+            Unlock(false, page);
+            this->buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+        }
+    }
+
+/*
+ * Follow the right links from a latched page until the page covering key,
+ * the right page is latched before the left one is released
+ */
+    INDEX_TEMPLATE_ARGUMENTS
+    Page *BPLUSTREE_TYPE::MoveRight(Page *page, const KeyType &key,
+                                    bool exclusive) {
+        for (;;) {
+            auto node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+            page_id_t rightId = node->IsLeafPage()
+                    ? reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(node)->RightLinkFor(key, comparator_)
+                    : reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node)->RightLinkFor(key, comparator_);
+            if (rightId == INVALID_PAGE_ID)
+                return page;
+            Page *right = this->buffer_pool_manager_->FetchPage(rightId);
+            Lock(exclusive, right);
+            Unlock(exclusive, page);
+            this->buffer_pool_manager_->UnpinPage(page->GetPageId(), exclusive);
+            page = right;
+        }
+    }
+
+/*
+ * Lehman and Yao insertion: the leaf is latched alone. A full page is split
+ * into a new right sibling that is reachable through the right link before
+ * the parent knows it, then the parent is latched and the two pages released.
+ * Only one level is latched at a time besides the split pair.
+ */
+    INDEX_TEMPLATE_ARGUMENTS
+    bool BPLUSTREE_TYPE::BLinkInsert(const KeyType &key, const ValueType &value) {
+        std::vector<std::pair<page_id_t, int>> path;
+        Page *page = this->BLinkDescend(key, false, 0, true, &path);
+        if (page == nullptr) {
+            this->mutex_.WLock();
+            if (this->IsEmpty()) {
+                this->StartNewTree(key, value);
+                this->mutex_.WUnlock();
+                return true;
+            }
+            this->mutex_.WUnlock();
+            page = this->BLinkDescend(key, false, 0, true, &path);
+        }
+        auto leaf = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+        ValueType existing;
+        if (leaf->Lookup(key, existing, comparator_)) {
+            page->WUnlatch();
+            this->buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+            return false;
+        }
+        leaf->Insert(key, value, comparator_);
+        int level = 0;
+        auto node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+        while (node->GetSize() > node->GetMaxSize()) {
+            KeyType separator;
+            Page *sibling = this->BLinkSplit(page, separator);
+            Page *parentPage = this->BLinkParent(page, sibling, separator, level, path);
+            if (parentPage != nullptr) {
+                auto parent = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(parentPage->GetData());
+                parent->InsertNodeAfter(page->GetPageId(), separator, sibling->GetPageId());
+                reinterpret_cast<BPlusTreePage *>(sibling->GetData())
+                        ->SetParentPageId(parentPage->GetPageId());
+            }
+            sibling->WUnlatch();
+            this->buffer_pool_manager_->UnpinPage(sibling->GetPageId(), true);
+            page->WUnlatch();
+            this->buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+            // a new root took both halves
+            if (parentPage == nullptr)
+                return true;
+            page = parentPage;
+            node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+            level++;
+        }
+        page->WUnlatch();
+        this->buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+        return true;
+    }
+
+/*
+ * Move the upper half of a latched page into a new right sibling. The
+ * sibling takes over the high key and right link of the page, the page keeps
+ * the keys below the separator.
+ * @return : the sibling, latched exclusively and pinned
+ */
+    INDEX_TEMPLATE_ARGUMENTS
+    Page *BPLUSTREE_TYPE::BLinkSplit(Page *page, KeyType &separator) {
+        page_id_t siblingId;
+        Page *siblingPage = this->buffer_pool_manager_->NewPage(siblingId);
+        if (siblingPage == nullptr) {
+            throw Exception(EXCEPTION_TYPE_INDEX, "out of memory");
+        }
+        siblingPage->WLatch();
+        auto node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+        if (node->IsLeafPage()) {
+            auto leaf = static_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(node);
+            auto sibling = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(siblingPage->GetData());
+            sibling->Init(siblingId, leaf->GetParentPageId());
+            leaf->MoveHalfTo(sibling, this->buffer_pool_manager_);
+            separator = sibling->KeyAt(0);
+            sibling->SetHighKey(leaf->GetHighKey());
+            leaf->SetHighKey(separator);
+        } else {
+            auto internal = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node);
+            auto sibling = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(siblingPage->GetData());
+            sibling->Init(siblingId, internal->GetParentPageId());
+            sibling->SetLevel(internal->GetLevel());
+            internal->MoveHalfTo(sibling, this->buffer_pool_manager_);
+            separator = sibling->KeyAt(0);
+            sibling->SetHighKey(internal->GetHighKey());
+            sibling->SetRightPageId(internal->GetRightPageId());
+            internal->SetHighKey(separator);
+            internal->SetRightPageId(siblingId);
+        }
+        return siblingPage;
+    }
+
+/*
+ * Latch the parent of a page just split, the one covering the separator at
+ * the level above. It is the page passed on the way down or one to its right.
+ * If the page was the root a new root is made above it instead, a root added
+ * since the descent is searched from the top.
+ * @return : the parent latched exclusively and pinned, nullptr if a new root
+ * was made
+ */
+    INDEX_TEMPLATE_ARGUMENTS
+    Page *BPLUSTREE_TYPE::BLinkParent(Page *page, Page *sibling,
+                                      const KeyType &separator, int level,
+                                      const std::vector<std::pair<page_id_t, int>> &path) {
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            if (it->second == level + 1) {
+                Page *parent = this->buffer_pool_manager_->FetchPage(it->first);
+                parent->WLatch();
+                return this->MoveRight(parent, separator, true);
+            }
+        }
+        this->mutex_.WLock();
+        if (this->root_page_id_ == page->GetPageId()) {
+            page_id_t rootId;
+            Page *rootPage = this->buffer_pool_manager_->NewPage(rootId);
+            if (rootPage == nullptr) {
+                this->mutex_.WUnlock();
+                throw Exception(EXCEPTION_TYPE_INDEX, "out of memory");
+            }
+            auto root = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(rootPage->GetData());
+            root->Init(rootId);
+            root->SetLevel(level + 1);
+            root->PopulateNewRoot(page->GetPageId(), separator, sibling->GetPageId());
+            reinterpret_cast<BPlusTreePage *>(page->GetData())->SetParentPageId(rootId);
+            reinterpret_cast<BPlusTreePage *>(sibling->GetData())->SetParentPageId(rootId);
+            this->root_page_id_ = rootId;
+            this->UpdateRootPageId();
+            this->buffer_pool_manager_->UnpinPage(rootId, true);
+            this->mutex_.WUnlock();
+            return nullptr;
+        }
+        this->mutex_.WUnlock();
+        return this->BLinkDescend(separator, false, level + 1, true, nullptr);
+    }
+
 /*
  * Update/Insert root page id in header page(where page_id = 0, header_page is
  * defined under include/page/header_page.h)
@@ -0,0 +1,131 @@
+/**
+ * checkpoint_manager.cpp
+ */
+
+#include "logging/checkpoint_manager.h"
+#include "page/header_page.h"
+
+namespace scudb {
+
+/*
+ * A checkpoint never waits for the running transactions:
+ * 1. pages dirty since before the previous checkpoint are written back, so
+ * the redo of the next recovery starts no earlier than that checkpoint
+ * 2. BEGIN_CHECKPOINT is appended
+ * 3. the active transaction table and the dirty page table are copied, they
+ * may already be stale, analysis corrects them from the records that follow
+ * BEGIN_CHECKPOINT
+ * 4. END_CHECKPOINT carries both tables and the scan offset: the log offset
+ * of the oldest record recovery needs, the smallest of the BEGIN_CHECKPOINT,
+ * the recLSNs and the BEGIN records of the active transactions. Tables that
+ * don't fit one record are split, only the last record has the scan offset
+ * 5. once END_CHECKPOINT is on disk and the db file is synced, so that pages
+ * evicted without a sync are durable too, the header page points to the
+ * checkpoint. Once it is synced as well the log before the scan offset is
+ * recycled. A checkpoint that fails on the way is abandoned.
+ */
+lsn_t CheckpointManager::Checkpoint() {
+  if (!ENABLE_LOGGING)
+    return INVALID_LSN;
+  std::lock_guard<std::mutex> guard(checkpoint_latch_);
+
+  if (last_checkpoint_lsn_ != INVALID_LSN) {
+    std::vector<page_id_t> old_pages;
+    for (auto &dirty_page : buffer_pool_manager_->GetDirtyPageTable()) {
+      if (dirty_page.second < last_checkpoint_lsn_)
+        old_pages.push_back(dirty_page.first);
+    }
+    if (!buffer_pool_manager_->FlushPages(old_pages))
+      return INVALID_LSN;
+  }
+
+  LogRecord begin_record(INVALID_TXN_ID, INVALID_LSN,
+                         LogRecordType::BEGIN_CHECKPOINT);
+  lsn_t begin_lsn = log_manager_->AppendLogRecord(begin_record);
+
+  lsn_t scan_lsn;
+  auto active_txns = transaction_manager_->GetActiveTransactions(scan_lsn);
+  if (scan_lsn == INVALID_LSN || begin_lsn < scan_lsn)
+    scan_lsn = begin_lsn;
+  auto dirty_pages = buffer_pool_manager_->GetDirtyPageTable();
+  for (auto &dirty_page : dirty_pages)
+    scan_lsn = std::min(scan_lsn, dirty_page.second);
+  int64_t scan_offset = log_manager_->GetOffsetLowerBound(scan_lsn);
+
+  lsn_t end_lsn;
+  size_t txn_pos = 0, page_pos = 0;
+  while (true) {
+    size_t txn_end = std::min(active_txns.size(),
+                              txn_pos + LogRecord::CHECKPOINT_ENTRIES);
+    size_t page_end =
+        std::min(dirty_pages.size(), page_pos + LogRecord::CHECKPOINT_ENTRIES -
+                                         (txn_end - txn_pos));
+    bool last = txn_end == active_txns.size() && page_end == dirty_pages.size();
+    LogRecord end_record(
+        begin_lsn, last ? scan_offset : -1,
+        std::vector<std::pair<txn_id_t, lsn_t>>(
+            active_txns.begin() + txn_pos, active_txns.begin() + txn_end),
+        std::vector<std::pair<page_id_t, lsn_t>>(
+            dirty_pages.begin() + page_pos, dirty_pages.begin() + page_end));
+    end_lsn = log_manager_->AppendLogRecord(end_record);
+    if (last)
+      break;
+    txn_pos = txn_end;
+    page_pos = page_end;
+  }
+  if (!log_manager_->ForceFlush(end_lsn) || !disk_manager_->SyncPages())
+    return INVALID_LSN;
+  // exact, every BEGIN_CHECKPOINT written is indexed
+  int64_t checkpoint_offset = log_manager_->GetOffsetLowerBound(begin_lsn);
+
+  Page *page = buffer_pool_manager_->FetchPage(HEADER_PAGE_ID);
+  if (page == nullptr)
+    return INVALID_LSN;
+  page->WLatch();
+  static_cast<HeaderPage *>(page)->SetCheckpoint(begin_lsn, checkpoint_offset);
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, true);
+  if (!buffer_pool_manager_->FlushPage(HEADER_PAGE_ID) ||
+      !disk_manager_->SyncPages())
+    return INVALID_LSN;
+
+  log_manager_->RecycleLog(scan_lsn);
+  last_checkpoint_lsn_ = begin_lsn;
+  num_checkpoints_++;
+  return begin_lsn;
+}
+
+void CheckpointManager::StartCheckpointThread(
+    std::chrono::milliseconds interval) {
+  if (checkpoint_thread_ != nullptr)
+    return;
+  running_ = true;
+  checkpoint_thread_ =
+      new std::thread(&CheckpointManager::CheckpointThread, this, interval);
+}
+
+void CheckpointManager::StopCheckpointThread() {
+  if (checkpoint_thread_ == nullptr)
+    return;
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    running_ = false;
+  }
+  cv_.notify_all();
+  checkpoint_thread_->join();
+  delete checkpoint_thread_;
+  checkpoint_thread_ = nullptr;
+}
+
+void CheckpointManager::CheckpointThread(std::chrono::milliseconds interval) {
+  std::unique_lock<std::mutex> lock(latch_);
+  while (running_) {
+    if (cv_.wait_for(lock, interval, [&] { return !running_; }))
+      break;
+    lock.unlock();
+    Checkpoint();
+    lock.lock();
+  }
+}
+
+} // namespace scudb
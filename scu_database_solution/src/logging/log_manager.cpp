@@ -2,6 +2,8 @@
  * log_manager.cpp
  */
 
+#include <limits>
+
 #include "logging/log_manager.h"
 
 namespace scudb {
@@ -12,35 +14,616 @@ namespace scudb {
  * manager wants to force flush (it only happens when the flushed page has a
  * larger LSN than persistent LSN)
  */
-void LogManager::RunFlushThread() {}
+void LogManager::RunFlushThread() {
+  if (!stripes_.empty()) {
+    for (auto stripe : stripes_)
+      stripe->RunFlushThread();
+    return;
+  }
+  std::lock_guard<std::mutex> guard(latch_);
+  if (running_)
+    return;
+  running_ = true;
+  ENABLE_LOGGING = true;
+  // records of this run are appended after whatever the log already has
+  log_offset_ = disk_manager_->GetLogEndOffset(stripe_);
+  next_index_offset_ = log_offset_;
+  {
+    std::lock_guard<std::mutex> index_guard(index_latch_);
+    offset_index_.clear();
+  }
+  flush_thread_ = new std::thread(&LogManager::FlushThread, this);
+}
+
 /*
  * Stop and join the flush thread, set ENABLE_LOGGING = false
+ * Whatever is left in the log buffer is flushed before the thread exits
+ */
+void LogManager::StopFlushThread() {
+  if (!stripes_.empty()) {
+    for (auto stripe : stripes_)
+      stripe->StopFlushThread();
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    if (!running_)
+      return;
+    running_ = false;
+    ENABLE_LOGGING = false;
+  }
+  cv_.notify_one();
+  flush_thread_->join();
+  delete flush_thread_;
+  flush_thread_ = nullptr;
+  // nobody is going to write what the waiters left are waiting for
+  std::lock_guard<std::mutex> guard(latch_);
+  flushed_cv_.notify_all();
+}
+
+/*
+ * Body of the flush thread. Wake up on LOG_TIMEOUT, when a log buffer is
+ * sealed or when someone forces a flush, then write out whatever appenders
+ * have completed. A forced flush keeps draining while records it may be
+ * waiting for are still being serialized.
+ */
+void LogManager::FlushThread() {
+  while (true) {
+    bool forced, stop;
+    {
+      std::unique_lock<std::mutex> lock(latch_);
+      // sleep until LOG_TIMEOUT or the deadline of a pending async commit
+      std::chrono::steady_clock::time_point timeout =
+          std::chrono::steady_clock::now() +
+          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              LOG_TIMEOUT);
+      while (!flush_requested_ && !commit_requested_ && running_) {
+        auto deadline = std::min(timeout, async_deadline_);
+        if (std::chrono::steady_clock::now() >= deadline)
+          break;
+        cv_.wait_until(lock, deadline);
+      }
+      if (commit_requested_ && !flush_requested_ && running_ &&
+          commit_delay_.count() > 0) {
+        // give other committers a chance to join this group
+        cv_.wait_for(lock, commit_delay_, [this] {
+          return flush_requested_ || !running_ ||
+                 waiting_commits_ >= commit_batch_size_;
+        });
+      }
+      forced = flush_requested_ || commit_requested_;
+      stop = !running_;
+      flush_requested_ = false;
+      commit_requested_ = false;
+      async_deadline_ = std::chrono::steady_clock::time_point::max();
+    }
+    while (DrainLogBuffers() && (forced || stop)) {
+      std::this_thread::yield();
+    }
+    if (stop)
+      break;
+  }
+}
+
+/*
+ * Write the contiguous completed prefix of the buffer being drained. A record
+ * is complete once its size field is non zero, appenders store it last. When
+ * the buffer is sealed, wait for the stragglers, zero it and hand it back to
+ * the appenders, then go on with the next buffer. The prefix also ends before
+ * a record that waits for another stripe. A failed write leaves the records
+ * in the buffer and the persistent lsn where it was, the next flush retries.
+ * Once the log has failed for good its records are dropped instead, so that
+ * appenders never wait for a buffer forever, and the waiters are woken up.
+ * @return: true if some reserved records were not complete yet
+ */
+bool LogManager::DrainLogBuffers() {
+  while (true) {
+    char *buffer = buffers_[flush_gen_ & 1];
+    uint64_t word = reserve_.load();
+    int sealed = sealed_size_[flush_gen_ & 1].load();
+    bool current = sealed < 0 && Generation(word) == (flush_gen_ & 0xFF);
+    int limit = sealed >= 0 ? sealed : std::min(Offset(word), LOG_BUFFER_SIZE);
+
+    int pos = flushed_offset_;
+    int64_t next_index_offset = next_index_offset_;
+    lsn_t durable = INVALID_LSN;
+    std::vector<std::pair<lsn_t, int64_t>> index;
+    while (pos + LogRecord::HEADER_SIZE <= limit) {
+      int32_t size = __atomic_load_n(reinterpret_cast<int32_t *>(buffer + pos),
+                                     __ATOMIC_ACQUIRE);
+      if (size == 0)
+        break;
+      lsn_t lsn = *reinterpret_cast<lsn_t *>(buffer + pos + sizeof(int32_t));
+      if (num_deps_ > 0 && !DependencyDurable(lsn))
+        break;
+      durable = lsn;
+      // sample the offsets of records, and keep those of every checkpoint
+      int64_t offset = log_offset_ + pos - flushed_offset_;
+      auto type = static_cast<LogRecordType>(
+          buffer[pos + sizeof(int32_t) + sizeof(lsn_t)]);
+      if (offset >= next_index_offset_ ||
+          type == LogRecordType::BEGIN_CHECKPOINT) {
+        index.emplace_back(durable, offset);
+        next_index_offset_ = offset + LOG_INDEX_INTERVAL;
+      }
+      pos += size;
+    }
+    if (pos > flushed_offset_) {
+      if (disk_manager_->WriteLog(buffer + flushed_offset_,
+                                  pos - flushed_offset_, stripe_)) {
+        log_offset_ += pos - flushed_offset_;
+      } else if (!disk_manager_->IsLogFailed()) {
+        next_index_offset_ = next_index_offset;
+        return false;
+      }
+      flushed_offset_ = pos;
+    }
+    bool failed = disk_manager_->IsLogFailed();
+    if (!index.empty() && !failed) {
+      std::lock_guard<std::mutex> guard(index_latch_);
+      offset_index_.insert(index.begin(), index.end());
+    }
+    if (current && pos == Offset(word)) {
+      // nothing in flight, lsns skipped by failed reservations are covered too
+      durable = NextLSN(word) - 1;
+    }
+    if (failed) {
+      std::lock_guard<std::mutex> guard(latch_);
+      flushed_cv_.notify_all();
+    } else if (durable > persistent_lsn_) {
+      std::lock_guard<std::mutex> guard(latch_);
+      persistent_lsn_ = durable;
+      flushed_cv_.notify_all();
+    }
+    if (sealed < 0)
+      return pos < limit;
+    if (pos < sealed) {
+      // stragglers are still copying their records
+      std::this_thread::yield();
+      continue;
+    }
+    memset(buffer, 0, sealed);
+    sealed_size_[flush_gen_ & 1] = -1;
+    flushed_offset_ = 0;
+    {
+      std::lock_guard<std::mutex> guard(latch_);
+      buffer_free_[flush_gen_ & 1] = true;
+      append_cv_.notify_all();
+    }
+    flush_gen_++;
+  }
+}
+
+/*
+ * Called by the appender that sealed the buffer of generation: move the
+ * reservation word to the other buffer. Only waits for disk when the other
+ * buffer is still being written out.
+ */
+void LogManager::SwitchBuffer(uint32_t generation) {
+  int next = (generation + 1) & 1;
+  std::unique_lock<std::mutex> lock(latch_);
+  flush_requested_ = true;
+  cv_.notify_one();
+  append_cv_.wait(lock, [&] { return buffer_free_[next].load(); });
+  buffer_free_[next] = false;
+  // keep the lsn counter, failed reservations may still be bumping it
+  uint64_t word = reserve_.load();
+  uint64_t fresh;
+  do {
+    fresh = (word & ~(LSN_ONE - 1)) |
+            (static_cast<uint64_t>((generation + 1) & 0xFF) << OFFSET_BITS);
+  } while (!reserve_.compare_exchange_weak(word, fresh));
+  append_cv_.notify_all();
+}
+
+/*
+ * Move the clock forward so that the next lsn of this stripe is past lsn
+ */
+void LogManager::Advance(lsn_t lsn) {
+  uint64_t clock = ClockAt(lsn + 1);
+  uint64_t word = reserve_.load();
+  while ((word >> 32) < clock &&
+         !reserve_.compare_exchange_weak(
+             word, (clock << 32) | (word & (LSN_ONE - 1)))) {
+  }
+}
+
+/*
+ * The record at lsn changes a page last logged at dependency by another
+ * stripe: unless that one is on disk already, the record must not be
+ * written before it
  */
-void LogManager::StopFlushThread() {}
+void LogManager::AddDependency(lsn_t lsn, lsn_t dependency) {
+  LogManager *owner = router_->Owner(dependency);
+  if (owner == this || owner->persistent_lsn_ >= dependency)
+    return;
+  std::lock_guard<std::mutex> guard(deps_latch_);
+  deps_[lsn] = dependency;
+  num_deps_++;
+}
+
+/*
+ * Called by the flush thread before it writes the record at lsn. Records are
+ * written in lsn order and a dependency is always smaller than the record,
+ * so the stripes never wait for each other in a cycle.
+ * @return: false if the record has to wait, the other stripe is asked to flush
+ */
+bool LogManager::DependencyDurable(lsn_t lsn) {
+  std::lock_guard<std::mutex> guard(deps_latch_);
+  auto it = deps_.find(lsn);
+  if (it == deps_.end())
+    return true;
+  LogManager *owner = router_->Owner(it->second);
+  if (owner->persistent_lsn_ < it->second) {
+    owner->RequestFlush();
+    return false;
+  }
+  deps_.erase(it);
+  num_deps_--;
+  return true;
+}
 
 /*
  * append a log record into log buffer
  * you MUST set the log record's lsn within this method
  * @return: lsn that is assigned to this log record
- *
- *
- * example below
- * // First, serialize the must have fields(20 bytes in total)
- * log_record.lsn_ = next_lsn_++;
- * memcpy(log_buffer_ + offset_, &log_record, 20);
- * int pos = offset_ + 20;
- *
- * if (log_record.log_record_type_ == LogRecordType::INSERT) {
- *    memcpy(log_buffer_ + pos, &log_record.insert_rid_, sizeof(RID));
- *    pos += sizeof(RID);
- *    // we have provided serialize function for tuple class
- *    log_record.insert_tuple_.SerializeTo(log_buffer_ + pos);
- *  }
- *
- */
-lsn_t LogManager::AppendLogRecord(LogRecord &log_record) {
-
-  return INVALID_LSN;
+ * Space and lsn are reserved with a single fetch_add, so appenders serialize
+ * their records in parallel without any latch. The first reservation that
+ * does not fit seals the buffer and switches to the other one, later ones
+ * wait for the switch and retry. The lsns of failed reservations are skipped,
+ * lsns are increasing but not dense.
+ * A striped log appends to the stripe of the transaction. Every stripe moves
+ * its clock past a checkpoint, so records appended after BEGIN_CHECKPOINT
+ * have a larger lsn wherever they go.
+ */
+lsn_t LogManager::AppendLogRecord(LogRecord &log_record, lsn_t min_lsn) {
+  if (!stripes_.empty()) {
+    lsn_t lsn =
+        Route(log_record.txn_id_)->AppendLogRecord(log_record, min_lsn);
+    if (log_record.log_record_type_ == LogRecordType::BEGIN_CHECKPOINT) {
+      for (auto stripe : stripes_)
+        stripe->Advance(lsn);
+    }
+    return lsn;
+  }
+  int size = log_record.size_;
+  assert(size <= LOG_BUFFER_SIZE);
+  // would never fit a buffer
+  if (size > LOG_BUFFER_SIZE)
+    return INVALID_LSN;
+  if (min_lsn != INVALID_LSN)
+    Advance(min_lsn);
+  while (true) {
+    uint64_t word = reserve_.fetch_add(LSN_ONE + size);
+    uint32_t generation = Generation(word);
+    int offset = Offset(word);
+    if (offset + size <= LOG_BUFFER_SIZE) {
+      log_record.lsn_ = NextLSN(word);
+      // registered before the record is published to the flush thread
+      if (router_ != nullptr && min_lsn != INVALID_LSN)
+        AddDependency(log_record.lsn_, min_lsn);
+      char *dest = buffers_[generation & 1] + offset;
+      SerializeLogRecord(dest, log_record);
+      // publish the record, the flush thread stops at a zero size
+      __atomic_store_n(reinterpret_cast<int32_t *>(dest), size,
+                       __ATOMIC_RELEASE);
+      return log_record.lsn_;
+    }
+    if (offset <= LOG_BUFFER_SIZE) {
+      sealed_size_[generation & 1] = offset;
+      SwitchBuffer(generation);
+    } else {
+      std::unique_lock<std::mutex> lock(latch_);
+      append_cv_.wait(
+          lock, [&] { return Generation(reserve_.load()) != generation; });
+    }
+  }
+}
+
+/*
+ * Wake up the flush thread and wait until lsn is persistent. Used by buffer
+ * pool manager before it writes out a page whose LSN is not on disk yet.
+ * @return: false if lsn will not become persistent, the log failed or the
+ * flush thread is not running
+ */
+bool LogManager::ForceFlush(lsn_t lsn) {
+  if (!stripes_.empty()) {
+    // let the stripes write in parallel, then wait for each
+    for (auto stripe : stripes_)
+      stripe->RequestFlush();
+    bool flushed = true;
+    for (auto stripe : stripes_)
+      flushed = stripe->ForceFlush(lsn) && flushed;
+    return flushed;
+  }
+  std::unique_lock<std::mutex> lock(latch_);
+  // never wait for a record that was not appended
+  lsn = std::min(lsn, NextLSN(reserve_.load()) - 1);
+  while (persistent_lsn_ < lsn) {
+    if (Stalled())
+      return false;
+    flush_requested_ = true;
+    cv_.notify_one();
+    flushed_cv_.wait(lock);
+  }
+  return true;
+}
+
+/*
+ * Ask the flush thread to write the log now instead of at the next timeout.
+ * Used by buffer pool manager when its next victims wait for the log.
+ */
+void LogManager::RequestFlush() {
+  if (!stripes_.empty()) {
+    for (auto stripe : stripes_)
+      stripe->RequestFlush();
+    return;
+  }
+  std::lock_guard<std::mutex> lock(latch_);
+  if (running_ && !flush_requested_) {
+    flush_requested_ = true;
+    cv_.notify_one();
+  }
+}
+
+/*
+ * Group commit: wait until the COMMIT record at lsn is persistent. Unlike
+ * ForceFlush the flush thread may hold the write back for the commit delay,
+ * so that all the committers waiting meanwhile are made durable by a single
+ * log write and sync.
+ * @return: false if the COMMIT record will not become persistent
+ */
+bool LogManager::WaitForCommit(lsn_t lsn) {
+  // the commit only waits for its own stripe, the records it depends on in
+  // other stripes are written first
+  if (!stripes_.empty())
+    return Owner(lsn)->WaitForCommit(lsn);
+  std::unique_lock<std::mutex> lock(latch_);
+  if (persistent_lsn_ >= lsn)
+    return true;
+  if (Stalled())
+    return false;
+  waiting_commits_++;
+  commit_requested_ = true;
+  cv_.notify_one();
+  flushed_cv_.wait(lock, [&] { return Stalled() || persistent_lsn_ >= lsn; });
+  waiting_commits_--;
+  if (persistent_lsn_ < lsn)
+    return false;
+  num_commits_++;
+  // the first committer released by a log write opens a new group
+  if (persistent_lsn_ != last_group_lsn_) {
+    last_group_lsn_ = persistent_lsn_;
+    num_commit_groups_++;
+  }
+  return true;
+}
+
+/*
+ * Asynchronous commit: return at once, the flush thread is woken up no later
+ * than async_window_ after the first pending async commit. Commits within
+ * the window are lost on a crash.
+ */
+void LogManager::AsyncCommit(lsn_t lsn) {
+  if (!stripes_.empty())
+    return Owner(lsn)->AsyncCommit(lsn);
+  std::lock_guard<std::mutex> guard(latch_);
+  if (!running_ || persistent_lsn_ >= lsn)
+    return;
+  if (async_deadline_ == std::chrono::steady_clock::time_point::max()) {
+    async_deadline_ = std::chrono::steady_clock::now() + async_window_;
+    cv_.notify_one();
+  }
+}
+
+/*
+ * Wait until lsn is persistent. The flush is not forced, a record committed
+ * asynchronously is durable within the async commit window anyway.
+ * @return: false if lsn will not become persistent
+ */
+bool LogManager::WaitForDurable(lsn_t lsn) {
+  if (!stripes_.empty()) {
+    bool durable = true;
+    for (auto stripe : stripes_)
+      durable = stripe->WaitForDurable(lsn) && durable;
+    return durable;
+  }
+  std::unique_lock<std::mutex> lock(latch_);
+  lsn = std::min(lsn, NextLSN(reserve_.load()) - 1);
+  flushed_cv_.wait(lock, [&] { return Stalled() || persistent_lsn_ >= lsn; });
+  return persistent_lsn_ >= lsn;
+}
+
+void LogManager::SetAsyncCommitWindow(std::chrono::microseconds window) {
+  for (auto stripe : stripes_)
+    stripe->SetAsyncCommitWindow(window);
+  std::lock_guard<std::mutex> guard(latch_);
+  async_window_ = window;
+}
+
+/*
+ * Return a log offset at or before the record at lsn, from the sampled
+ * offsets of the records written so far. The offset of a BEGIN_CHECKPOINT
+ * record is exact.
+ */
+int64_t LogManager::GetOffsetLowerBound(lsn_t lsn) {
+  if (!stripes_.empty())
+    return stripes_[0]->GetOffsetLowerBound(lsn);
+  std::lock_guard<std::mutex> guard(index_latch_);
+  auto it = offset_index_.upper_bound(lsn);
+  if (it == offset_index_.begin())
+    return disk_manager_->GetLogStartOffset(stripe_);
+  return (--it)->second;
+}
+
+/*
+ * Forget the sampled offsets that are no longer needed to look up lsn
+ */
+void LogManager::TruncateOffsetIndex(lsn_t lsn) {
+  for (auto stripe : stripes_)
+    stripe->TruncateOffsetIndex(lsn);
+  std::lock_guard<std::mutex> guard(index_latch_);
+  auto it = offset_index_.upper_bound(lsn);
+  if (it != offset_index_.begin())
+    offset_index_.erase(offset_index_.begin(), --it);
+}
+
+/*
+ * Recycle the log segments that only hold records below lsn. Every stripe
+ * looks up its own offset, then forgets the offsets below lsn.
+ */
+void LogManager::RecycleLog(lsn_t lsn) {
+  if (!stripes_.empty()) {
+    for (auto stripe : stripes_)
+      stripe->RecycleLog(lsn);
+    return;
+  }
+  disk_manager_->RecycleLog(GetOffsetLowerBound(lsn), stripe_);
+  TruncateOffsetIndex(lsn);
+}
+
+void LogManager::SetGroupCommit(std::chrono::microseconds delay,
+                                int batch_size) {
+  for (auto stripe : stripes_)
+    stripe->SetGroupCommit(delay, batch_size);
+  std::lock_guard<std::mutex> guard(latch_);
+  commit_delay_ = delay;
+  commit_batch_size_ = std::max(batch_size, 1);
+}
+
+double LogManager::GetAverageGroupSize() {
+  int commits = num_commits_;
+  int groups = num_commit_groups_;
+  for (auto stripe : stripes_) {
+    commits += stripe->num_commits_;
+    groups += stripe->num_commit_groups_;
+  }
+  return groups == 0 ? 0 : static_cast<double>(commits) / groups;
+}
+
+/*
+ * Every record up to the persistent lsn is on disk. A stripe that wrote all
+ * its records holds nothing back, no matter how far behind its clock is.
+ */
+lsn_t LogManager::GetPersistentLSN() {
+  if (stripes_.empty())
+    return persistent_lsn_;
+  lsn_t persistent = INVALID_LSN;
+  lsn_t pending = std::numeric_limits<lsn_t>::max();
+  for (auto stripe : stripes_) {
+    lsn_t lsn = stripe->persistent_lsn_;
+    if (lsn < stripe->GetNextLSN() - 1)
+      pending = std::min(pending, lsn);
+    persistent = std::max(persistent, lsn);
+  }
+  return std::min(persistent, pending);
+}
+
+void LogManager::SetPersistentLSN(lsn_t lsn) {
+  for (auto stripe : stripes_)
+    stripe->SetPersistentLSN(lsn);
+  persistent_lsn_ = lsn;
+}
+
+lsn_t LogManager::GetNextLSN() {
+  if (stripes_.empty())
+    return NextLSN(reserve_.load());
+  lsn_t next = std::numeric_limits<lsn_t>::max();
+  for (auto stripe : stripes_)
+    next = std::min(next, stripe->GetNextLSN());
+  return next;
+}
+
+void LogManager::SetNextLSN(lsn_t lsn) {
+  for (auto stripe : stripes_)
+    stripe->SetNextLSN(lsn);
+  reserve_ = static_cast<uint64_t>(ClockAt(lsn)) << 32;
+  persistent_lsn_ = NextLSN(reserve_) - 1;
+}
+
+/*
+ * Serialize log_record into dest, log_record.size_ bytes in total, in the
+ * compact format described in log_record.h. First, serialize the must have
+ * fields. The size field is left to the caller, which publishes the record
+ * by storing it.
+ */
+void LogManager::SerializeLogRecord(char *dest, LogRecord &log_record) {
+  memcpy(dest + sizeof(int32_t), &log_record.lsn_, sizeof(lsn_t));
+  dest[sizeof(int32_t) + sizeof(lsn_t)] = static_cast<char>(
+      static_cast<int>(log_record.log_record_type_) |
+      (log_record.compensation_ ? LogRecord::COMPENSATION_FLAG : 0));
+  int pos = LogRecord::HEADER_SIZE;
+  pos += LogRecord::PutVarint(dest + pos, log_record.txn_id_ + 1);
+  pos += LogRecord::PutVarint(dest + pos, log_record.prev_lsn_ + 1);
+  if (log_record.compensation_)
+    pos += LogRecord::PutVarint(dest + pos, log_record.undo_next_lsn_ + 1);
+
+  auto put_rid = [&](const RID &rid) {
+    pos += LogRecord::PutVarint(dest + pos, rid.GetPageId() + 1);
+    pos += LogRecord::PutVarint(dest + pos, rid.GetSlotNum());
+  };
+  auto put_bytes = [&](const char *data, int32_t size) {
+    pos += LogRecord::PutVarint(dest + pos, size);
+    memcpy(dest + pos, data, size);
+    pos += size;
+  };
+
+  switch (log_record.log_record_type_) {
+  case LogRecordType::INSERT:
+    put_rid(log_record.insert_rid_);
+    put_bytes(log_record.insert_tuple_.GetData(),
+              log_record.insert_tuple_.GetLength());
+    break;
+  case LogRecordType::MARKDELETE:
+  case LogRecordType::APPLYDELETE:
+  case LogRecordType::ROLLBACKDELETE:
+    put_rid(log_record.delete_rid_);
+    put_bytes(log_record.delete_tuple_.GetData(),
+              log_record.delete_tuple_.GetLength());
+    break;
+  case LogRecordType::UPDATE: {
+    int32_t prefix = log_record.update_prefix_;
+    int32_t shared = prefix + log_record.update_suffix_;
+    put_rid(log_record.update_rid_);
+    pos += LogRecord::PutVarint(dest + pos, prefix);
+    pos += LogRecord::PutVarint(dest + pos, log_record.update_suffix_);
+    put_bytes(log_record.old_tuple_.GetData() + prefix,
+              log_record.old_tuple_.GetLength() - shared);
+    put_bytes(log_record.new_tuple_.GetData() + prefix,
+              log_record.new_tuple_.GetLength() - shared);
+    break;
+  }
+  case LogRecordType::NEWPAGE:
+    pos += LogRecord::PutVarint(dest + pos, log_record.page_id_ + 1);
+    pos += LogRecord::PutVarint(
+        dest + pos,
+        LogRecord::ZigZag(log_record.page_id_ - log_record.prev_page_id_));
+    break;
+  case LogRecordType::END_CHECKPOINT: {
+    memcpy(dest + pos, &log_record.scan_offset_, sizeof(int64_t));
+    pos += sizeof(int64_t);
+    int32_t count = log_record.active_txns_.size();
+    memcpy(dest + pos, &count, sizeof(int32_t));
+    pos += sizeof(int32_t);
+    for (auto &txn : log_record.active_txns_) {
+      memcpy(dest + pos, &txn.first, sizeof(txn_id_t));
+      memcpy(dest + pos + sizeof(txn_id_t), &txn.second, sizeof(lsn_t));
+      pos += sizeof(txn_id_t) + sizeof(lsn_t);
+    }
+    count = log_record.dirty_pages_.size();
+    memcpy(dest + pos, &count, sizeof(int32_t));
+    pos += sizeof(int32_t);
+    for (auto &page : log_record.dirty_pages_) {
+      memcpy(dest + pos, &page.first, sizeof(page_id_t));
+      memcpy(dest + pos + sizeof(page_id_t), &page.second, sizeof(lsn_t));
+      pos += sizeof(page_id_t) + sizeof(lsn_t);
+    }
+    break;
+  }
+  default:
+    // BEGIN/COMMIT/ABORT/BEGIN_CHECKPOINT only have the header
+    break;
+  }
 }
 
 } // namespace scudb
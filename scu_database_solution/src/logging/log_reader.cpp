@@ -0,0 +1,149 @@
+/**
+ * log_reader.cpp
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "logging/log_reader.h"
+#include "logging/log_record.h"
+
+namespace scudb {
+
+LogReader::LogReader(DiskManager *disk_manager, int64_t offset,
+                     int chunk_size, int stripe)
+    : disk_manager_(disk_manager), stripe_(stripe), chunk_size_(chunk_size),
+      end_offset_(disk_manager->GetLogEndOffset(stripe)), current_(0),
+      chunk_offset_(0), chunk_length_(0), pos_(0) {
+  // a record straddles at most two chunks
+  assert(chunk_size_ >= LOG_BUFFER_SIZE);
+  chunks_[0] = new char[chunk_size_];
+  chunks_[1] = new char[chunk_size_];
+  straddle_ = new char[LOG_BUFFER_SIZE];
+  Seek(offset);
+}
+
+LogReader::~LogReader() {
+  if (prefetch_.valid())
+    prefetch_.wait();
+  delete[] chunks_[0];
+  delete[] chunks_[1];
+  delete[] straddle_;
+}
+
+/*
+ * Records are laid out back to back. A zero size is the unused tail of a
+ * segment, the log goes on at the next segment boundary.
+ */
+bool LogReader::Next(const char *&record, int64_t &offset) {
+  const int size_bytes = sizeof(int32_t);
+  while (true) {
+    offset = chunk_offset_ + pos_;
+    if (offset >= end_offset_)
+      return false;
+    if (pos_ == chunk_length_) {
+      if (!NextChunk())
+        return false;
+      continue;
+    }
+    int available = chunk_length_ - pos_;
+    const char *data = chunks_[current_] + pos_;
+    int32_t size;
+    if (available >= size_bytes) {
+      memcpy(&size, data, size_bytes);
+    } else {
+      // even the size continues in the next chunk
+      memcpy(straddle_, data, available);
+      if (!NextChunk() || chunk_length_ < size_bytes - available)
+        return false;
+      memcpy(straddle_ + available, chunks_[current_], size_bytes - available);
+      memcpy(&size, straddle_, size_bytes);
+      data = nullptr;
+    }
+    if (size == 0) {
+      Seek((offset / LOG_SEGMENT_SIZE + 1) * LOG_SEGMENT_SIZE);
+      continue;
+    }
+    if (size < LogRecord::HEADER_SIZE || size > LOG_BUFFER_SIZE ||
+        offset + size > end_offset_)
+      return false;
+    if (data != nullptr && size <= available) {
+      record = data;
+      pos_ += size;
+      return true;
+    }
+
+    // the record continues in the next chunk
+    if (data != nullptr) {
+      memcpy(straddle_, data, available);
+      if (!NextChunk())
+        return false;
+    }
+    if (size - available > chunk_length_)
+      return false;
+    memcpy(straddle_ + available, chunks_[current_], size - available);
+    pos_ = size - available;
+    record = straddle_;
+    return true;
+  }
+}
+
+/*
+ * Move to offset: within the current chunk only the position changes,
+ * otherwise the chunk around it is read and the next one prefetched
+ */
+void LogReader::Seek(int64_t offset) {
+  if (chunk_length_ > 0 && offset >= chunk_offset_ &&
+      offset <= chunk_offset_ + chunk_length_) {
+    pos_ = static_cast<int>(offset - chunk_offset_);
+    return;
+  }
+  if (prefetch_.valid())
+    prefetch_.wait();
+  chunk_offset_ = offset / chunk_size_ * chunk_size_;
+  chunk_length_ = ReadChunk(chunks_[current_], chunk_offset_);
+  pos_ = static_cast<int>(std::min<int64_t>(offset - chunk_offset_,
+                                            chunk_length_));
+  Prefetch();
+}
+
+/*
+ * Switch to the prefetched chunk and start prefetching the one after it
+ */
+bool LogReader::NextChunk() {
+  if (!prefetch_.valid())
+    return false;
+  int length = prefetch_.get();
+  if (length <= 0)
+    return false;
+  current_ ^= 1;
+  chunk_offset_ += chunk_size_;
+  chunk_length_ = length;
+  pos_ = 0;
+  Prefetch();
+  return true;
+}
+
+void LogReader::Prefetch() {
+  int64_t chunk_offset = chunk_offset_ + chunk_size_;
+  if (chunk_offset >= end_offset_)
+    return;
+  char *chunk = chunks_[current_ ^ 1];
+  prefetch_ = std::async(std::launch::async, &LogReader::ReadChunk, this,
+                         chunk, chunk_offset);
+}
+
+/*
+ * @return: valid bytes read, up to the end of the log
+ */
+int LogReader::ReadChunk(char *chunk, int64_t chunk_offset) {
+  int length = static_cast<int>(
+      std::min<int64_t>(chunk_size_, end_offset_ - chunk_offset));
+  if (length <= 0 ||
+      !disk_manager_->ReadLog(chunk, length, chunk_offset, stripe_))
+    return 0;
+  return length;
+}
+
+} // namespace scudb
@@ -2,7 +2,11 @@
  * log_recovey.cpp
  */
 
+#include <memory>
+#include <queue>
+
 #include "logging/log_recovery.h"
+#include "page/header_page.h"
 #include "page/table_page.h"
 
 namespace scudb {
@@ -13,7 +17,263 @@ namespace scudb {
  */
 bool LogRecovery::DeserializeLogRecord(const char *data,
                                              LogRecord &log_record) {
-  return false;
+  int32_t size;
+  memcpy(&size, data, sizeof(int32_t));
+  if (size < LogRecord::HEADER_SIZE || size > LOG_BUFFER_SIZE)
+    return false;
+  int type_byte = static_cast<unsigned char>(data[sizeof(int32_t) +
+                                                 sizeof(lsn_t)]);
+  auto type = static_cast<LogRecordType>(type_byte &
+                                         ~LogRecord::COMPENSATION_FLAG);
+  if (type <= LogRecordType::INVALID || type > LogRecordType::END_CHECKPOINT)
+    return false;
+  log_record.size_ = size;
+  log_record.log_record_type_ = type;
+  log_record.compensation_ = (type_byte & LogRecord::COMPENSATION_FLAG) != 0;
+  log_record.undo_next_lsn_ = INVALID_LSN;
+  memcpy(&log_record.lsn_, data + sizeof(int32_t), sizeof(lsn_t));
+
+  int pos = LogRecord::HEADER_SIZE;
+  // every field must end inside the record
+  auto read_varint = [&](uint32_t &value) {
+    int length = LogRecord::GetVarint(data + pos, size - pos, value);
+    pos += length;
+    return length > 0;
+  };
+  auto read_id = [&](int32_t &id) {
+    uint32_t value;
+    if (!read_varint(value))
+      return false;
+    id = static_cast<int32_t>(value - 1);
+    return true;
+  };
+  auto read_rid = [&](RID &rid) {
+    page_id_t page_id;
+    uint32_t slot_num;
+    if (!read_id(page_id) || !read_varint(slot_num))
+      return false;
+    rid.Set(page_id, slot_num);
+    return true;
+  };
+  // a size followed by that many bytes
+  auto read_bytes = [&](const char *&bytes, int32_t &length) {
+    uint32_t value;
+    if (!read_varint(value) || value > static_cast<uint32_t>(size - pos))
+      return false;
+    bytes = data + pos;
+    length = value;
+    pos += length;
+    return true;
+  };
+  auto read_tuple = [&](Tuple &tuple) {
+    const char *bytes;
+    int32_t length;
+    if (!read_bytes(bytes, length))
+      return false;
+    tuple.DeserializeFrom(bytes, length);
+    return true;
+  };
+  auto read_range = [&](std::string &range) {
+    const char *bytes;
+    int32_t length;
+    if (!read_bytes(bytes, length))
+      return false;
+    range.assign(bytes, length);
+    return true;
+  };
+  if (!read_id(log_record.txn_id_) || !read_id(log_record.prev_lsn_) ||
+      (log_record.compensation_ && !read_id(log_record.undo_next_lsn_)))
+    return false;
+
+  switch (type) {
+  case LogRecordType::INSERT:
+    return read_rid(log_record.insert_rid_) &&
+           read_tuple(log_record.insert_tuple_);
+  case LogRecordType::MARKDELETE:
+  case LogRecordType::APPLYDELETE:
+  case LogRecordType::ROLLBACKDELETE:
+    return read_rid(log_record.delete_rid_) &&
+           read_tuple(log_record.delete_tuple_);
+  case LogRecordType::UPDATE: {
+    uint32_t prefix, suffix;
+    if (!read_rid(log_record.update_rid_) || !read_varint(prefix) ||
+        !read_varint(suffix) || prefix > PAGE_SIZE || suffix > PAGE_SIZE)
+      return false;
+    log_record.update_prefix_ = prefix;
+    log_record.update_suffix_ = suffix;
+    return read_range(log_record.old_range_) &&
+           read_range(log_record.new_range_);
+  }
+  case LogRecordType::NEWPAGE: {
+    uint32_t delta;
+    if (!read_id(log_record.page_id_) || !read_varint(delta))
+      return false;
+    log_record.prev_page_id_ =
+        log_record.page_id_ - LogRecord::UnZigZag(delta);
+    return true;
+  }
+  case LogRecordType::END_CHECKPOINT: {
+    // scan offset, then two tables of (id, lsn) pairs with their counts
+    const int entry = sizeof(int32_t) + sizeof(lsn_t);
+    int32_t count;
+    if (pos + static_cast<int>(sizeof(int64_t) + sizeof(int32_t)) > size)
+      return false;
+    memcpy(&log_record.scan_offset_, data + pos, sizeof(int64_t));
+    pos += sizeof(int64_t);
+    memcpy(&count, data + pos, sizeof(int32_t));
+    pos += sizeof(int32_t);
+    if (count < 0 || count > (size - pos) / entry)
+      return false;
+    log_record.active_txns_.resize(count);
+    for (auto &txn : log_record.active_txns_) {
+      memcpy(&txn.first, data + pos, sizeof(txn_id_t));
+      memcpy(&txn.second, data + pos + sizeof(txn_id_t), sizeof(lsn_t));
+      pos += entry;
+    }
+    if (pos + static_cast<int>(sizeof(int32_t)) > size)
+      return false;
+    memcpy(&count, data + pos, sizeof(int32_t));
+    pos += sizeof(int32_t);
+    if (count < 0 || count > (size - pos) / entry)
+      return false;
+    log_record.dirty_pages_.resize(count);
+    for (auto &page : log_record.dirty_pages_) {
+      memcpy(&page.first, data + pos, sizeof(page_id_t));
+      memcpy(&page.second, data + pos + sizeof(page_id_t), sizeof(lsn_t));
+      pos += entry;
+    }
+    return true;
+  }
+  default:
+    // BEGIN/COMMIT/ABORT/BEGIN_CHECKPOINT only have the header
+    return true;
+  }
+}
+
+/*
+ * Read the log from offset to its end and hand every complete record, its
+ * stripe and its offset to handler, until it returns false. The log reader
+ * streams large chunks ahead and records are deserialized in place. A torn
+ * record ends the log. The other stripes of a striped log are read from
+ * their start, the record with the smallest lsn goes first. If ends is given,
+ * it gets the offset right behind the last record read from each stripe.
+ */
+void LogRecovery::ScanLog(
+    int64_t offset,
+    const std::function<bool(LogRecord &, int, int64_t)> &handler,
+    std::vector<int64_t> *ends) {
+  int num_stripes = disk_manager_->GetNumLogStripes();
+  std::vector<std::unique_ptr<LogReader>> readers;
+  std::vector<LogRecord> heads(num_stripes);
+  std::vector<int64_t> offsets(num_stripes);
+  std::vector<bool> valid(num_stripes);
+  if (ends != nullptr)
+    ends->resize(num_stripes);
+  auto next = [&](int stripe) {
+    const char *data;
+    heads[stripe] = LogRecord();
+    valid[stripe] = readers[stripe]->Next(data, offsets[stripe]) &&
+                    DeserializeLogRecord(data, heads[stripe]);
+    if (valid[stripe] && ends != nullptr)
+      (*ends)[stripe] = offsets[stripe] + heads[stripe].GetSize();
+  };
+  for (int stripe = 0; stripe < num_stripes; stripe++) {
+    int64_t start =
+        stripe == 0 ? offset : disk_manager_->GetLogStartOffset(stripe);
+    if (ends != nullptr)
+      (*ends)[stripe] = start;
+    readers.emplace_back(
+        new LogReader(disk_manager_, start, chunk_size_, stripe));
+    next(stripe);
+  }
+  while (true) {
+    int stripe = -1;
+    for (int i = 0; i < num_stripes; i++) {
+      if (valid[i] && (stripe < 0 || heads[i].lsn_ < heads[stripe].lsn_))
+        stripe = i;
+    }
+    if (stripe < 0 || !handler(heads[stripe], stripe, offsets[stripe]))
+      return;
+    next(stripe);
+  }
+}
+
+/*
+ * Analysis pass: find the loser transactions, the last lsn of each, the
+ * offset of every record and the dirty page table. With a checkpoint in the
+ * header page, the tables are seeded from its END_CHECKPOINT record and the
+ * log is read from the scan offset it recorded: the oldest recLSN or the
+ * begin of the oldest active transaction, whichever comes first. The log is
+ * truncated behind the last valid record: a torn record left by the crash
+ * would otherwise end the log before anything appended after the restart.
+ */
+void LogRecovery::Analysis() {
+  active_txn_.clear();
+  lsn_mapping_.clear();
+  dirty_page_table_.clear();
+  scan_offset_ = disk_manager_->GetLogStartOffset();
+  // the checkpoint offsets only cover the first stripe
+  bool striped = disk_manager_->GetNumLogStripes() > 1;
+
+  lsn_t checkpoint_lsn = INVALID_LSN;
+  int64_t checkpoint_offset = scan_offset_;
+  auto header_page =
+      static_cast<HeaderPage *>(buffer_pool_manager_->FetchPage(HEADER_PAGE_ID));
+  if (header_page != nullptr && !striped) {
+    if (!header_page->GetCheckpoint(checkpoint_lsn, checkpoint_offset) ||
+        checkpoint_offset < scan_offset_) {
+      checkpoint_lsn = INVALID_LSN;
+      checkpoint_offset = scan_offset_;
+    }
+    buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, false);
+  }
+  if (checkpoint_lsn != INVALID_LSN) {
+    ScanLog(checkpoint_offset, [&](LogRecord &log_record, int, int64_t) {
+      if (log_record.GetLogRecordType() != LogRecordType::END_CHECKPOINT ||
+          log_record.GetPrevLSN() != checkpoint_lsn)
+        return true;
+      for (auto &txn : log_record.GetActiveTxns())
+        active_txn_[txn.first] = txn.second;
+      for (auto &page : log_record.GetDirtyPages())
+        dirty_page_table_[page.first] = page.second;
+      // more of the tables follow
+      if (log_record.GetScanOffset() < 0)
+        return true;
+      scan_offset_ = std::max(scan_offset_, log_record.GetScanOffset());
+      return false;
+    });
+  }
+
+  std::vector<int64_t> ends;
+  ScanLog(scan_offset_, [&](LogRecord &log_record, int stripe,
+                            int64_t offset) {
+    lsn_t lsn = log_record.GetLSN();
+    max_lsn_ = std::max(max_lsn_, lsn);
+    lsn_mapping_[lsn] = std::make_pair(stripe, offset);
+    switch (log_record.GetLogRecordType()) {
+    case LogRecordType::COMMIT:
+    case LogRecordType::ABORT:
+      active_txn_.erase(log_record.GetTxnId());
+      return true;
+    case LogRecordType::BEGIN_CHECKPOINT:
+    case LogRecordType::END_CHECKPOINT:
+      return true;
+    case LogRecordType::NEWPAGE:
+      disk_manager_->ReservePage(log_record.GetNewPageId());
+      break;
+    default:
+      break;
+    }
+    active_txn_[log_record.GetTxnId()] = lsn;
+    // pages dirtied before the checkpoint are in its dirty page table
+    page_id_t page_id = GetRecordPageId(log_record);
+    if (page_id != INVALID_PAGE_ID &&
+        (checkpoint_lsn == INVALID_LSN || offset >= checkpoint_offset))
+      dirty_page_table_.emplace(page_id, lsn);
+    return true;
+  }, &ends);
+  for (int stripe = 0; stripe < static_cast<int>(ends.size()); stripe++)
+    disk_manager_->TruncateLog(ends[stripe], stripe);
 }
 
 /*
@@ -22,13 +282,356 @@ bool LogRecovery::DeserializeLogRecord(const char *data,
  *log buffer to reduce unnecessary I/O operations), remember to compare page's
  *LSN with log_record's sequence number, and also build active_txn_ table &
  *lsn_mapping_ table
+ *Records are partitioned by page id and each partition is replayed by its own
+ *worker, in log order.
+ */
+void LogRecovery::Redo() {
+  assert(!ENABLE_LOGGING);
+  Analysis();
+
+  std::vector<std::vector<LogRecord>> partitions(num_redo_threads_);
+  ScanLog(scan_offset_,
+          [this, &partitions](LogRecord &log_record, int, int64_t) {
+            page_id_t page_id = GetRecordPageId(log_record);
+            auto dirty = dirty_page_table_.find(page_id);
+            if (dirty == dirty_page_table_.end() ||
+                log_record.GetLSN() < dirty->second)
+              return true;
+            partitions[page_id % num_redo_threads_].push_back(log_record);
+            // the link from the previous page is redone by the worker of
+            // that page, after the page itself was initialized
+            page_id_t prev_page_id = log_record.prev_page_id_;
+            if (log_record.GetLogRecordType() == LogRecordType::NEWPAGE &&
+                prev_page_id != INVALID_PAGE_ID &&
+                prev_page_id % num_redo_threads_ !=
+                    page_id % num_redo_threads_)
+              partitions[prev_page_id % num_redo_threads_].push_back(
+                  log_record);
+            return true;
+          });
+
+  std::vector<std::thread> workers;
+  for (int i = 1; i < num_redo_threads_; i++) {
+    workers.emplace_back(&LogRecovery::RedoPartition, this,
+                         std::ref(partitions[i]), i);
+  }
+  RedoPartition(partitions[0], 0);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void LogRecovery::RedoPartition(std::vector<LogRecord> &log_records,
+                                int partition) {
+  for (auto &log_record : log_records) {
+    page_id_t page_id = GetRecordPageId(log_record);
+    if (page_id % num_redo_threads_ == partition) {
+      RedoRecord(log_record);
+    } else {
+      LinkPage(log_record.prev_page_id_, page_id);
+    }
+  }
+}
+
+/*
+ * Apply a record to its page unless the page already has it. A NEWPAGE
+ * record also initializes a page that never made it to disk, and links it
+ * from the previous page when both belong to this worker.
+ */
+void LogRecovery::RedoRecord(LogRecord &log_record) {
+  page_id_t page_id = GetRecordPageId(log_record);
+  auto page = static_cast<TablePage *>(FetchPage(page_id));
+  page->WLatch();
+  lsn_t lsn = log_record.GetLSN();
+  bool is_new_page = log_record.GetLogRecordType() == LogRecordType::NEWPAGE;
+  bool apply = page->GetLSN() < lsn ||
+               (is_new_page && page->GetPageId() != page_id);
+  RID rid;
+  Tuple old_tuple;
+  switch (apply ? log_record.GetLogRecordType() : LogRecordType::INVALID) {
+  case LogRecordType::INSERT:
+    // the compensation of a delete puts the tuple back into its own slot
+    if (log_record.IsCompensation()) {
+      page->RestoreTuple(log_record.insert_tuple_, log_record.insert_rid_);
+      break;
+    }
+    page->InsertTuple(log_record.insert_tuple_, rid, nullptr, nullptr,
+                      nullptr);
+    assert(rid == log_record.insert_rid_);
+    break;
+  case LogRecordType::MARKDELETE:
+    page->MarkDelete(log_record.delete_rid_, nullptr, nullptr, nullptr);
+    break;
+  case LogRecordType::APPLYDELETE:
+    page->ApplyDelete(log_record.delete_rid_, nullptr, nullptr);
+    break;
+  case LogRecordType::ROLLBACKDELETE:
+    page->RollbackDelete(log_record.delete_rid_, nullptr, nullptr);
+    break;
+  case LogRecordType::UPDATE: {
+    Tuple new_tuple;
+    if (PatchTuple(page, log_record, false, new_tuple))
+      page->UpdateTuple(new_tuple, old_tuple, log_record.update_rid_, nullptr,
+                        nullptr, nullptr);
+    break;
+  }
+  case LogRecordType::NEWPAGE:
+    page->Init(page_id, PAGE_SIZE, log_record.prev_page_id_, nullptr,
+               nullptr);
+    break;
+  default:
+    break;
+  }
+  if (apply)
+    page->SetLSN(lsn);
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, apply);
+
+  // the link from the previous page is not logged on its own
+  page_id_t prev_page_id = log_record.prev_page_id_;
+  if (is_new_page && prev_page_id != INVALID_PAGE_ID &&
+      prev_page_id % num_redo_threads_ == page_id % num_redo_threads_)
+    LinkPage(prev_page_id, page_id);
+}
+
+/*
+ * help function to redo the link from prev_page_id to its next page
  */
-void LogRecovery::Redo() {}
+void LogRecovery::LinkPage(page_id_t prev_page_id, page_id_t page_id) {
+  auto prev_page = static_cast<TablePage *>(FetchPage(prev_page_id));
+  prev_page->WLatch();
+  bool linked = prev_page->GetNextPageId() == page_id;
+  prev_page->SetNextPageId(page_id);
+  prev_page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(prev_page_id, !linked);
+}
 
 /*
  *undo phase on TABLE PAGE level(table/table_page.h)
  *iterate through active txn map and undo each operation
+ *Records of all the losers are undone together, latest lsn first. Without a
+ *log manager nothing is logged, the losers are ended once logging runs
+ *again, see GetLosers. With a running one every undone record gets a CLR and
+ *every loser an ABORT record: a crash during recovery then redoes the undo
+ *so far and the next recovery goes on from where it stopped. The pages
+ *undone stay pinned until their CLRs are on disk.
+ *@return: false if the CLRs can't be made durable, undo stops then
  */
-void LogRecovery::Undo() {}
+bool LogRecovery::Undo(LogManager *log_manager) {
+  assert(!ENABLE_LOGGING || log_manager != nullptr);
+  // the page methods must not log, undo logs the CLRs itself
+  bool logging = ENABLE_LOGGING.exchange(false);
+  log_manager_ = log_manager;
+  std::priority_queue<lsn_t> to_undo;
+  losers_.clear();
+  for (auto &txn : active_txn_) {
+    to_undo.push(txn.second);
+    losers_.push_back(txn);
+  }
+  bool durable = true;
+  LogRecord log_record;
+  while (!to_undo.empty() && durable) {
+    lsn_t lsn = to_undo.top();
+    to_undo.pop();
+    if (!ReadLogRecord(lsn, log_record)) {
+      LOG_DEBUG("log record %d to undo is missing", lsn);
+      continue;
+    }
+    // a CLR is never undone, what it compensated is undone already
+    lsn_t next_lsn = log_record.IsCompensation() ? log_record.GetUndoNextLSN()
+                                                 : log_record.GetPrevLSN();
+    if (!log_record.IsCompensation())
+      durable = UndoRecord(log_record);
+    if (next_lsn != INVALID_LSN)
+      to_undo.push(next_lsn);
+  }
+  if (log_manager_ != nullptr && durable) {
+    for (auto &loser : losers_) {
+      LogRecord abort_record(loser.first, active_txn_[loser.first],
+                             LogRecordType::ABORT);
+      loser.second = log_manager_->AppendLogRecord(abort_record);
+      last_lsn_ = std::max(last_lsn_, loser.second);
+    }
+    durable = ReleasePages();
+  }
+  // pages left pinned are written back, if ever, through the log again
+  ENABLE_LOGGING = logging;
+  for (page_id_t page_id : held_pages_)
+    buffer_pool_manager_->UnpinPage(page_id, true);
+  held_pages_.clear();
+  active_txn_.clear();
+  log_manager_ = nullptr;
+  return durable;
+}
+
+/*
+ * undo a record on its page and log its CLR, if there is a log manager
+ * @return: false if the CLRs of pages undone before can't be made durable
+ */
+bool LogRecovery::UndoRecord(LogRecord &log_record) {
+  page_id_t page_id = GetRecordPageId(log_record);
+  if (page_id == INVALID_PAGE_ID ||
+      log_record.GetLogRecordType() == LogRecordType::NEWPAGE)
+    return true;
+  bool held = std::find(held_pages_.begin(), held_pages_.end(), page_id) !=
+              held_pages_.end();
+  // keep a frame free for the page to undo
+  if (log_manager_ != nullptr && !held &&
+      held_pages_.size() >=
+          std::max<size_t>(1, buffer_pool_manager_->GetPoolSize() / 2) &&
+      !ReleasePages())
+    return false;
+  auto page = static_cast<TablePage *>(FetchPage(page_id));
+  page->WLatch();
+  txn_id_t txn_id = log_record.GetTxnId();
+  Tuple old_tuple;
+  // the CLR, of the type that redoes the undo
+  std::unique_ptr<LogRecord> clr;
+  switch (log_record.GetLogRecordType()) {
+  case LogRecordType::INSERT:
+    page->ApplyDelete(log_record.insert_rid_, nullptr, nullptr);
+    clr.reset(new LogRecord(txn_id, active_txn_[txn_id],
+                            LogRecordType::APPLYDELETE, log_record.insert_rid_,
+                            log_record.insert_tuple_));
+    break;
+  case LogRecordType::MARKDELETE:
+    page->RollbackDelete(log_record.delete_rid_, nullptr, nullptr);
+    clr.reset(new LogRecord(txn_id, active_txn_[txn_id],
+                            LogRecordType::ROLLBACKDELETE,
+                            log_record.delete_rid_, log_record.delete_tuple_));
+    break;
+  case LogRecordType::APPLYDELETE:
+    if (page->RestoreTuple(log_record.delete_tuple_, log_record.delete_rid_))
+      clr.reset(new LogRecord(txn_id, active_txn_[txn_id],
+                              LogRecordType::INSERT, log_record.delete_rid_,
+                              log_record.delete_tuple_));
+    break;
+  case LogRecordType::ROLLBACKDELETE:
+    page->MarkDelete(log_record.delete_rid_, nullptr, nullptr, nullptr);
+    clr.reset(new LogRecord(txn_id, active_txn_[txn_id],
+                            LogRecordType::MARKDELETE, log_record.delete_rid_,
+                            log_record.delete_tuple_));
+    break;
+  case LogRecordType::UPDATE: {
+    Tuple undo_tuple;
+    if (PatchTuple(page, log_record, true, undo_tuple) &&
+        page->UpdateTuple(undo_tuple, old_tuple, log_record.update_rid_,
+                          nullptr, nullptr, nullptr))
+      clr.reset(new LogRecord(txn_id, active_txn_[txn_id],
+                              LogRecordType::UPDATE, log_record.update_rid_,
+                              old_tuple, undo_tuple));
+    break;
+  }
+  default:
+    break;
+  }
+  bool durable = true;
+  if (log_manager_ != nullptr && clr != nullptr) {
+    clr->SetUndoNextLSN(log_record.GetPrevLSN());
+    lsn_t lsn = log_manager_->AppendLogRecord(*clr, page->GetLSN());
+    durable = lsn != INVALID_LSN;
+    if (durable) {
+      active_txn_[txn_id] = lsn;
+      last_lsn_ = std::max(last_lsn_, lsn);
+      page->SetLSN(lsn);
+    }
+  }
+  page->WUnlatch();
+  // write ahead logging: the page is held until its CLR is on disk
+  if (log_manager_ != nullptr && !held)
+    held_pages_.push_back(page_id);
+  else
+    buffer_pool_manager_->UnpinPage(page_id, true);
+  return durable;
+}
+
+/*
+ * help function to flush the CLRs logged so far and let go of the pages they
+ * undid
+ * @return: false if the log can't be made durable, the pages stay pinned
+ */
+bool LogRecovery::ReleasePages() {
+  if (last_lsn_ != INVALID_LSN && !log_manager_->ForceFlush(last_lsn_))
+    return false;
+  for (page_id_t page_id : held_pages_)
+    buffer_pool_manager_->UnpinPage(page_id, true);
+  held_pages_.clear();
+  return true;
+}
+
+/*
+ * help function to rebuild a full tuple from an UPDATE record, which only
+ * logs the byte range that changed. The tuple on the page is the old one
+ * when redoing and the new one when undoing, the bytes before and after the
+ * range are shared by both.
+ * @return: false if the page does not hold the expected image
+ */
+bool LogRecovery::PatchTuple(TablePage *page, LogRecord &log_record, bool undo,
+                             Tuple &tuple) {
+  Tuple image;
+  if (!page->GetTuple(log_record.update_rid_, image, nullptr, nullptr))
+    return false;
+  const std::string &from =
+      undo ? log_record.new_range_ : log_record.old_range_;
+  const std::string &to = undo ? log_record.old_range_ : log_record.new_range_;
+  int32_t prefix = log_record.update_prefix_;
+  int32_t suffix = log_record.update_suffix_;
+  int32_t size = image.GetLength();
+  if (size != prefix + static_cast<int32_t>(from.size()) + suffix ||
+      from.compare(0, from.size(), image.GetData() + prefix, from.size()) != 0)
+    return false;
+  std::string data(image.GetData(), prefix);
+  data.append(to);
+  data.append(image.GetData() + size - suffix, suffix);
+  tuple.DeserializeFrom(data.data(), data.size());
+  return true;
+}
+
+/*
+ * help function to read the record at lsn, found through lsn_mapping_
+ */
+bool LogRecovery::ReadLogRecord(lsn_t lsn, LogRecord &log_record) {
+  auto it = lsn_mapping_.find(lsn);
+  if (it == lsn_mapping_.end())
+    return false;
+  int stripe = it->second.first;
+  int64_t offset = it->second.second;
+  int32_t size;
+  if (!disk_manager_->ReadLog(reinterpret_cast<char *>(&size), sizeof(size),
+                              offset, stripe) ||
+      size < LogRecord::HEADER_SIZE || size > LOG_BUFFER_SIZE ||
+      !disk_manager_->ReadLog(log_buffer_, size, offset, stripe))
+    return false;
+  return DeserializeLogRecord(log_buffer_, log_record);
+}
+
+/*
+ * help function to fetch a page, waiting for a frame when all of them are
+ * pinned by other workers
+ */
+Page *LogRecovery::FetchPage(page_id_t page_id) {
+  Page *page;
+  while ((page = buffer_pool_manager_->FetchPage(page_id)) == nullptr) {
+    std::this_thread::yield();
+  }
+  return page;
+}
+
+page_id_t LogRecovery::GetRecordPageId(LogRecord &log_record) {
+  switch (log_record.GetLogRecordType()) {
+  case LogRecordType::INSERT:
+    return log_record.insert_rid_.GetPageId();
+  case LogRecordType::MARKDELETE:
+  case LogRecordType::APPLYDELETE:
+  case LogRecordType::ROLLBACKDELETE:
+    return log_record.delete_rid_.GetPageId();
+  case LogRecordType::UPDATE:
+    return log_record.update_rid_.GetPageId();
+  case LogRecordType::NEWPAGE:
+    return log_record.page_id_;
+  default:
+    return INVALID_PAGE_ID;
+  }
+}
 
 } // namespace scudb
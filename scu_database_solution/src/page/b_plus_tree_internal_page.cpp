@@ -28,6 +28,9 @@ namespace scudb {
         this->SetPageId(page_id);
         // parent id
         this->SetParentPageId(parent_id);
+        // no right sibling yet, right above the leaves
+        this->SetRightPageId(INVALID_PAGE_ID);
+        this->SetLevel(1);
         // max page size
         int size = (PAGE_SIZE - sizeof(BPlusTreeInternalPage)) / sizeof(MappingType) - 1;
         //      except for the the first invalid key
@@ -30,7 +30,7 @@ namespace scudb {
         this->SetParentPageId(parent_id);
         this->SetNextPageId(INVALID_PAGE_ID);
         //  with first invalid
-        int size = (PAGE_SIZE - sizeof(BPlusTreePage)) / sizeof(MappingType) - 1;
+        int size = (PAGE_SIZE - sizeof(BPlusTreeLeafPage)) / sizeof(MappingType) - 1;
         this->SetMaxSize(size);
     }
 
@@ -148,7 +148,7 @@ namespace scudb {
 
         //set size
         this->SetSize(recipient_index);
-        recipient->SetSize(recipient_index);
+        recipient->SetSize(this->GetMaxSize() + 1 - recipient_index);
 
 
     }
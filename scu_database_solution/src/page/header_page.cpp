@@ -18,6 +18,9 @@ bool HeaderPage::InsertRecord(const std::string &name,
 
   int record_num = GetRecordCount();
   int offset = 4 + record_num * 36;
+  // records end before the checkpoint
+  if (offset + 36 > CHECKPOINT_LSN_OFFSET)
+    return false;
   // check for duplicate name
   if (FindRecord(name) != -1)
     return false;
@@ -73,6 +76,27 @@ bool HeaderPage::GetRootId(const std::string &name, page_id_t &root_id) {
   return true;
 }
 
+/**
+ * Checkpoint related
+ */
+void HeaderPage::SetCheckpoint(lsn_t lsn, int64_t offset) {
+  assert(lsn >= 0 && offset >= 0);
+  uint32_t magic = CHECKPOINT_MAGIC;
+  memcpy(GetData() + CHECKPOINT_LSN_OFFSET, &lsn, sizeof(lsn_t));
+  memcpy(GetData() + CHECKPOINT_LOG_OFFSET, &offset, sizeof(int64_t));
+  memcpy(GetData() + CHECKPOINT_MAGIC_OFFSET, &magic, sizeof(uint32_t));
+}
+
+bool HeaderPage::GetCheckpoint(lsn_t &lsn, int64_t &offset) {
+  uint32_t magic;
+  memcpy(&magic, GetData() + CHECKPOINT_MAGIC_OFFSET, sizeof(uint32_t));
+  if (magic != CHECKPOINT_MAGIC)
+    return false;
+  memcpy(&lsn, GetData() + CHECKPOINT_LSN_OFFSET, sizeof(lsn_t));
+  memcpy(&offset, GetData() + CHECKPOINT_LOG_OFFSET, sizeof(int64_t));
+  return true;
+}
+
 /**
  * helper functions
  */
@@ -15,7 +15,11 @@ void TablePage::Init(page_id_t page_id, size_t page_size,
                      Transaction *txn) {
   memcpy(GetData(), &page_id, 4); // set page_id
   if (ENABLE_LOGGING) {
-    // TODO: add your logging logic here
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(),
+                         LogRecordType::NEWPAGE, prev_page_id, page_id);
+    lsn_t lsn = log_manager->AppendLogRecord(log_record);
+    txn->SetPrevLSN(lsn);
+    SetLSN(lsn);
   }
   SetPrevPageId(prev_page_id);
   SetNextPageId(INVALID_PAGE_ID);
@@ -48,7 +52,7 @@ void TablePage::SetNextPageId(page_id_t next_page_id) {
  */
 bool TablePage::InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn,
                             LockManager *lock_manager,
-                            LogManager *log_manager) {
+                            LogManager *log_manager, page_id_t table_id) {
   assert(tuple.size_ > 0);
   if (GetFreeSpaceSize() < tuple.size_) {
     return false; // not enough space
@@ -73,6 +77,14 @@ bool TablePage::InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn,
   if (i == GetTupleCount() && GetFreeSpaceSize() < tuple.size_ + 8) {
     return false; // not enough space
   }
+  rid.Set(GetPageId(), i);
+  // acquire the exclusive lock before the slot is taken, an optimistic
+  // transaction passes no lock manager. A conflicting table lock aborts the
+  // transaction, the caller must not try other pages then
+  if (ENABLE_LOGGING && lock_manager != nullptr &&
+      !lock_manager->LockExclusive(txn, rid.Get(), table_id)) {
+    return false;
+  }
 
   SetFreeSpacePointer(GetFreeSpacePointer() -
                       tuple.size_); // update free space pointer first
@@ -80,14 +92,15 @@ bool TablePage::InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn,
   SetTupleOffset(i, GetFreeSpacePointer());
   SetTupleSize(i, tuple.size_);
   if (i == GetTupleCount()) {
-    rid.Set(GetPageId(), i);
     SetTupleCount(GetTupleCount() + 1);
   }
   // write the log after set rid
   if (ENABLE_LOGGING) {
-    // acquire the exclusive lock
-    assert(lock_manager->LockExclusive(txn, rid.Get()));
-    // TODO: add your logging logic here
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(),
+                         LogRecordType::INSERT, rid, tuple);
+    lsn_t lsn = log_manager->AppendLogRecord(log_record, GetLSN());
+    txn->SetPrevLSN(lsn);
+    SetLSN(lsn);
   }
   // LOG_DEBUG("Tuple inserted");
   return true;
@@ -100,7 +113,8 @@ bool TablePage::InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn,
  *
  */
 bool TablePage::MarkDelete(const RID &rid, Transaction *txn,
-                           LockManager *lock_manager, LogManager *log_manager) {
+                           LockManager *lock_manager, LogManager *log_manager,
+                           page_id_t table_id) {
   int slot_num = rid.GetSlotNum();
   if (slot_num >= GetTupleCount()) {
     if (ENABLE_LOGGING) {
@@ -118,17 +132,26 @@ bool TablePage::MarkDelete(const RID &rid, Transaction *txn,
   }
 
   if (ENABLE_LOGGING) {
-    // acquire exclusive lock
+    // acquire exclusive lock, unless optimistic without a lock manager
     // if has shared lock
-    if (txn->GetSharedLockSet()->find(rid) != txn->GetSharedLockSet()->end()) {
-      if (!lock_manager->LockUpgrade(txn, rid))
+    if (lock_manager == nullptr) {
+      assert(txn->IsOptimistic());
+    } else if (txn->GetSharedLockSet()->find(rid) !=
+               txn->GetSharedLockSet()->end()) {
+      if (!lock_manager->LockUpgrade(txn, rid, table_id))
         return false;
     } else if (txn->GetExclusiveLockSet()->find(rid) ==
                    txn->GetExclusiveLockSet()->end() &&
-               !lock_manager->LockExclusive(txn, rid)) { // no shared lock
+               !lock_manager->LockExclusive(txn, rid,
+                                            table_id)) { // no shared lock
       return false;
     }
-    // TODO: add your logging logic here
+    Tuple delete_tuple = CopyTuple(rid, tuple_size);
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(),
+                         LogRecordType::MARKDELETE, rid, delete_tuple);
+    lsn_t lsn = log_manager->AppendLogRecord(log_record, GetLSN());
+    txn->SetPrevLSN(lsn);
+    SetLSN(lsn);
   }
 
   // set tuple size to negative value
@@ -140,7 +163,7 @@ bool TablePage::MarkDelete(const RID &rid, Transaction *txn,
 bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple &old_tuple,
                             const RID &rid, Transaction *txn,
                             LockManager *lock_manager,
-                            LogManager *log_manager) {
+                            LogManager *log_manager, page_id_t table_id) {
   int slot_num = rid.GetSlotNum();
   if (slot_num >= GetTupleCount()) {
     if (ENABLE_LOGGING) {
@@ -172,17 +195,25 @@ bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple &old_tuple,
   old_tuple.allocated_ = true;
 
   if (ENABLE_LOGGING) {
-    // acquire exclusive lock
+    // acquire exclusive lock, unless optimistic without a lock manager
     // if has shared lock
-    if (txn->GetSharedLockSet()->find(rid) != txn->GetSharedLockSet()->end()) {
-      if (!lock_manager->LockUpgrade(txn, rid))
+    if (lock_manager == nullptr) {
+      assert(txn->IsOptimistic());
+    } else if (txn->GetSharedLockSet()->find(rid) !=
+               txn->GetSharedLockSet()->end()) {
+      if (!lock_manager->LockUpgrade(txn, rid, table_id))
         return false;
     } else if (txn->GetExclusiveLockSet()->find(rid) ==
                    txn->GetExclusiveLockSet()->end() &&
-               !lock_manager->LockExclusive(txn, rid)) { // no shared lock
+               !lock_manager->LockExclusive(txn, rid,
+                                            table_id)) { // no shared lock
       return false;
     }
-    // TODO: add your logging logic here
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(),
+                         LogRecordType::UPDATE, rid, old_tuple, new_tuple);
+    lsn_t lsn = log_manager->AppendLogRecord(log_record, GetLSN());
+    txn->SetPrevLSN(lsn);
+    SetLSN(lsn);
   }
 
   // update
@@ -212,7 +243,7 @@ bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple &old_tuple,
  * This function is called when a transaction commits or when you undo insert
  */
 void TablePage::ApplyDelete(const RID &rid, Transaction *txn,
-                            LogManager *log_manager) {
+                            LogManager *log_manager, page_id_t table_id) {
   int slot_num = rid.GetSlotNum();
   assert(slot_num < GetTupleCount());
   // the tuple offset of the deleted tuple
@@ -232,9 +263,12 @@ void TablePage::ApplyDelete(const RID &rid, Transaction *txn,
 
   if (ENABLE_LOGGING) {
     // must already grab the exclusive lock
-    assert(txn->GetExclusiveLockSet()->find(rid) !=
-           txn->GetExclusiveLockSet()->end());
-    // TODO: add your logging logic here
+    assert(txn->IsOptimistic() || txn->IsExclusiveLocked(rid, table_id));
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(),
+                         LogRecordType::APPLYDELETE, rid, delete_tuple);
+    lsn_t lsn = log_manager->AppendLogRecord(log_record, GetLSN());
+    txn->SetPrevLSN(lsn);
+    SetLSN(lsn);
   }
 
   int32_t free_space_pointer =
@@ -260,26 +294,50 @@ void TablePage::ApplyDelete(const RID &rid, Transaction *txn,
  * This function is called when abort a transaction
  */
 void TablePage::RollbackDelete(const RID &rid, Transaction *txn,
-                               LogManager *log_manager) {
+                               LogManager *log_manager, page_id_t table_id) {
   if (ENABLE_LOGGING) {
     // must have already grab the exclusive lock
-    assert(txn->GetExclusiveLockSet()->find(rid) !=
-           txn->GetExclusiveLockSet()->end());
-
-    // TODO: add your logging logic here
+    assert(txn->IsOptimistic() || txn->IsExclusiveLocked(rid, table_id));
   }
 
   int slot_num = rid.GetSlotNum();
   assert(slot_num < GetTupleCount());
   int32_t tuple_size = GetTupleSize(slot_num);
 
+  if (ENABLE_LOGGING) {
+    Tuple delete_tuple = CopyTuple(rid, tuple_size < 0 ? -tuple_size
+                                                       : tuple_size);
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(),
+                         LogRecordType::ROLLBACKDELETE, rid, delete_tuple);
+    lsn_t lsn = log_manager->AppendLogRecord(log_record, GetLSN());
+    txn->SetPrevLSN(lsn);
+    SetLSN(lsn);
+  }
+
   // set tuple size to positive value
   if (tuple_size < 0)
     SetTupleSize(slot_num, -tuple_size);
 }
 
+/*
+ * RestoreTuple is the inverse of ApplyDelete: unlike InsertTuple, the tuple
+ * goes back into the slot it was deleted from, so that the records logged
+ * before the delete still find it there. Nothing is logged.
+ */
+bool TablePage::RestoreTuple(const Tuple &tuple, const RID &rid) {
+  int slot_num = rid.GetSlotNum();
+  if (slot_num >= GetTupleCount() || GetTupleSize(slot_num) != 0 ||
+      GetFreeSpaceSize() < tuple.size_)
+    return false;
+  SetFreeSpacePointer(GetFreeSpacePointer() - tuple.size_);
+  memcpy(GetData() + GetFreeSpacePointer(), tuple.data_, tuple.size_);
+  SetTupleOffset(slot_num, GetFreeSpacePointer());
+  SetTupleSize(slot_num, tuple.size_);
+  return true;
+}
+
 bool TablePage::GetTuple(const RID &rid, Tuple &tuple, Transaction *txn,
-                         LockManager *lock_manager) {
+                         LockManager *lock_manager, page_id_t table_id) {
   int slot_num = rid.GetSlotNum();
   if (slot_num >= GetTupleCount()) {
     if (ENABLE_LOGGING)
@@ -298,7 +356,7 @@ bool TablePage::GetTuple(const RID &rid, Tuple &tuple, Transaction *txn,
     if (txn->GetExclusiveLockSet()->find(rid) ==
             txn->GetExclusiveLockSet()->end() &&
         txn->GetSharedLockSet()->find(rid) == txn->GetSharedLockSet()->end() &&
-        !lock_manager->LockShared(txn, rid)) {
+        !lock_manager->LockShared(txn, rid, table_id)) {
       return false;
     }
   }
@@ -314,12 +372,22 @@ bool TablePage::GetTuple(const RID &rid, Tuple &tuple, Transaction *txn,
   return true;
 }
 
+bool TablePage::ReadTuple(const RID &rid, Tuple &tuple) {
+  int slot_num = rid.GetSlotNum();
+  if (slot_num >= GetTupleCount() || GetTupleSize(slot_num) <= 0)
+    return false;
+  tuple.DeserializeFrom(GetData() + GetTupleOffset(slot_num),
+                        GetTupleSize(slot_num));
+  tuple.rid_ = rid;
+  return true;
+}
+
 /**
  * Tuple iterator
  */
-bool TablePage::GetFirstTupleRid(RID &first_rid) {
+bool TablePage::GetFirstTupleRid(RID &first_rid, bool all_slots) {
   for (int i = 0; i < GetTupleCount(); ++i) {
-    if (GetTupleSize(i) > 0) { // valid tuple
+    if (all_slots || GetTupleSize(i) > 0) { // valid tuple
       first_rid.Set(GetPageId(), i);
       return true;
     }
@@ -329,10 +397,11 @@ bool TablePage::GetFirstTupleRid(RID &first_rid) {
   return false;
 }
 
-bool TablePage::GetNextTupleRid(const RID &cur_rid, RID &next_rid) {
+bool TablePage::GetNextTupleRid(const RID &cur_rid, RID &next_rid,
+                                bool all_slots) {
   assert(cur_rid.GetPageId() == GetPageId());
   for (auto i = cur_rid.GetSlotNum() + 1; i < GetTupleCount(); ++i) {
-    if (GetTupleSize(i) > 0) { // valid tuple
+    if (all_slots || GetTupleSize(i) > 0) { // valid tuple
       next_rid.Set(GetPageId(), i);
       return true;
     }
@@ -353,6 +422,16 @@ int32_t TablePage::GetTupleSize(int slot_num) {
   return *reinterpret_cast<int32_t *>(GetData() + 28 + 8 * slot_num);
 }
 
+Tuple TablePage::CopyTuple(const RID &rid, int32_t tuple_size) {
+  Tuple tuple;
+  tuple.size_ = tuple_size;
+  tuple.data_ = new char[tuple_size];
+  memcpy(tuple.data_, GetData() + GetTupleOffset(rid.GetSlotNum()), tuple_size);
+  tuple.rid_ = rid;
+  tuple.allocated_ = true;
+  return tuple;
+}
+
 void TablePage::SetTupleOffset(int slot_num, int32_t offset) {
   memcpy(GetData() + 24 + 8 * slot_num, &offset, 4);
 }
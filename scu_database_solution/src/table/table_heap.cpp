@@ -5,6 +5,8 @@
 #include <cassert>
 
 #include "common/logger.h"
+#include "concurrency/tuple_version_table.h"
+#include "concurrency/version_store.h"
 #include "table/table_heap.h"
 
 namespace scudb {
@@ -34,7 +36,8 @@ TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager,
 }
 
 bool TableHeap::InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn) {
-  if (tuple.size_ + 32 > PAGE_SIZE) { // larger than one page size
+  if (tuple.size_ + 32 > PAGE_SIZE || // larger than one page size
+      buffer_pool_manager_->IsReadOnly() || txn->IsReadOnly()) {
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
@@ -48,8 +51,13 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn) {
 
   cur_page->WLatch();
   while (!cur_page->InsertTuple(
-      tuple, rid, txn, lock_manager_,
-      log_manager_)) { // fail to insert due to not enough space
+      tuple, rid, txn, GetLockManager(txn), log_manager_,
+      first_page_id_)) { // fail to insert due to not enough space
+    if (txn->GetState() == TransactionState::ABORTED) { // or to lock the slot
+      cur_page->WUnlatch();
+      buffer_pool_manager_->UnpinPage(cur_page->GetPageId(), false);
+      return false;
+    }
     auto next_page_id = cur_page->GetNextPageId();
     if (next_page_id != INVALID_PAGE_ID) { // valid next page
       cur_page->WUnlatch();
@@ -77,14 +85,30 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn) {
       cur_page = new_page;
     }
   }
+  // a reused slot may still have versions, an insert never conflicts
+  if (txn->GetVersionStore() != nullptr)
+    txn->GetVersionStore()->AddVersion(txn, rid, nullptr);
+  // an optimistic reader of the new tuple fails validation until it commits
+  bool locked = !txn->IsOptimistic() ||
+                txn->GetTupleVersionTable()->Lock(txn, {rid});
   cur_page->WUnlatch();
   buffer_pool_manager_->UnpinPage(cur_page->GetPageId(), true);
   txn->GetWriteSet()->emplace_back(rid, WType::INSERT, Tuple{}, this);
+  if (!locked) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
   return true;
 }
 
 bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
   // todo: remove empty page
+  if (buffer_pool_manager_->IsReadOnly() || txn->IsReadOnly()) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  if (txn->IsOptimistic() && txn->GetState() == TransactionState::GROWING)
+    return BufferWrite(rid, WType::DELETE, Tuple{}, txn);
   auto page = reinterpret_cast<TablePage *>(
       buffer_pool_manager_->FetchPage(rid.GetPageId()));
   if (page == nullptr) {
@@ -92,15 +116,31 @@ bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
     return false;
   }
   page->WLatch();
-  page->MarkDelete(rid, txn, lock_manager_, log_manager_);
+  VersionStore *versions = txn->GetVersionStore();
+  Tuple old_tuple;
+  bool exists = versions != nullptr && page->ReadTuple(rid, old_tuple);
+  bool is_deleted = page->MarkDelete(rid, txn, GetLockManager(txn),
+                                     log_manager_, first_page_id_);
+  bool conflict = exists && is_deleted &&
+                  !versions->AddVersion(txn, rid, &old_tuple);
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
   txn->GetWriteSet()->emplace_back(rid, WType::DELETE, Tuple{}, this);
+  if (conflict) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
   return true;
 }
 
 bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid,
                             Transaction *txn) {
+  if (buffer_pool_manager_->IsReadOnly() || txn->IsReadOnly()) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  if (txn->IsOptimistic() && txn->GetState() == TransactionState::GROWING)
+    return BufferWrite(rid, WType::UPDATE, tuple, txn);
   auto page = reinterpret_cast<TablePage *>(
       buffer_pool_manager_->FetchPage(rid.GetPageId()));
   if (page == nullptr) {
@@ -109,12 +149,21 @@ bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid,
   }
   Tuple old_tuple;
   page->WLatch();
-  bool is_updated = page->UpdateTuple(tuple, old_tuple, rid, txn, lock_manager_,
-                                      log_manager_);
+  bool is_updated = page->UpdateTuple(tuple, old_tuple, rid, txn,
+                                      GetLockManager(txn), log_manager_,
+                                      first_page_id_);
+  // rolling back an update leaves the saved versions to the abort
+  bool conflict = is_updated && txn->GetState() != TransactionState::ABORTED &&
+                  txn->GetVersionStore() != nullptr &&
+                  !txn->GetVersionStore()->AddVersion(txn, rid, &old_tuple);
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetPageId(), is_updated);
   if (is_updated && txn->GetState() != TransactionState::ABORTED)
     txn->GetWriteSet()->emplace_back(rid, WType::UPDATE, old_tuple, this);
+  if (conflict) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
   return is_updated;
 }
 
@@ -123,8 +172,9 @@ void TableHeap::ApplyDelete(const RID &rid, Transaction *txn) {
       buffer_pool_manager_->FetchPage(rid.GetPageId()));
   assert(page != nullptr);
   page->WLatch();
-  page->ApplyDelete(rid, txn, log_manager_);
-  lock_manager_->Unlock(txn, rid);
+  page->ApplyDelete(rid, txn, log_manager_, first_page_id_);
+  if (!txn->IsOptimistic())
+    lock_manager_->Unlock(txn, rid, first_page_id_);
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
 }
@@ -134,12 +184,13 @@ void TableHeap::RollbackDelete(const RID &rid, Transaction *txn) {
       buffer_pool_manager_->FetchPage(rid.GetPageId()));
   assert(page != nullptr);
   page->WLatch();
-  page->RollbackDelete(rid, txn, log_manager_);
+  page->RollbackDelete(rid, txn, log_manager_, first_page_id_);
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
 }
 
-// called by tuple iterator
+// called by tuple iterator, a snapshot, optimistic or read-only read takes no
+// lock and fails without aborting when it sees no tuple at rid
 bool TableHeap::GetTuple(const RID &rid, Tuple &tuple, Transaction *txn) {
   auto page = static_cast<TablePage *>(
       buffer_pool_manager_->FetchPage(rid.GetPageId()));
@@ -148,12 +199,63 @@ bool TableHeap::GetTuple(const RID &rid, Tuple &tuple, Transaction *txn) {
     return false;
   }
   page->RLatch();
-  bool res = page->GetTuple(rid, tuple, txn, lock_manager_);
+  bool res;
+  if (txn->GetVersionStore() != nullptr)
+    res = GetSnapshotTuple(page, rid, tuple, txn);
+  else if (txn->IsOptimistic())
+    res = GetOptimisticTuple(page, rid, tuple, txn);
+  else if (txn->IsReadOnly())
+    res = page->ReadTuple(rid, tuple);
+  else
+    res = page->GetTuple(rid, tuple, txn, lock_manager_, first_page_id_);
   page->RUnlatch();
   buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
   return res;
 }
 
+// page is latched
+bool TableHeap::GetSnapshotTuple(TablePage *page, const RID &rid, Tuple &tuple,
+                                 Transaction *txn) {
+  bool exists = page->ReadTuple(rid, tuple);
+  tuple.rid_ = rid;
+  return txn->GetVersionStore()->GetVisibleVersion(txn, rid, exists, tuple);
+}
+
+// page is latched, so the version word matches the tuple unless a committing
+// writer holds the word. An optimistic transaction reads its own buffered
+// writes.
+bool TableHeap::GetOptimisticTuple(TablePage *page, const RID &rid,
+                                   Tuple &tuple, Transaction *txn) {
+  auto write_set = txn->GetWriteSet();
+  for (auto it = write_set->rbegin(); it != write_set->rend(); ++it) {
+    if (it->table_ != this || !(it->rid_ == rid))
+      continue;
+    if (it->wtype_ == WType::DELETE)
+      return false;
+    if (it->wtype_ == WType::UPDATE) {
+      tuple = it->tuple_;
+      tuple.rid_ = rid;
+      return true;
+    }
+    break;
+  }
+  txn->GetReadSet()->emplace_back(rid,
+                                  txn->GetTupleVersionTable()->Read(rid));
+  bool exists = page->ReadTuple(rid, tuple);
+  tuple.rid_ = rid;
+  return exists;
+}
+
+// the tuple an optimistic transaction writes must not change before it
+// commits either, its version is validated like a read
+bool TableHeap::BufferWrite(const RID &rid, WType wtype, const Tuple &tuple,
+                            Transaction *txn) {
+  txn->GetReadSet()->emplace_back(rid,
+                                  txn->GetTupleVersionTable()->Read(rid));
+  txn->GetWriteSet()->emplace_back(rid, wtype, tuple, this);
+  return true;
+}
+
 bool TableHeap::DeleteTableHeap() {
   // todo: real delete
   return true;
@@ -165,8 +267,8 @@ TableIterator TableHeap::begin(Transaction *txn) {
   page->RLatch();
   RID rid;
   // if failed (no tuple), rid will be the result of default
-  // constructor, which means eof
-  page->GetFirstTupleRid(rid);
+  // constructor, which means eof. A snapshot may see tuples deleted since.
+  page->GetFirstTupleRid(rid, txn->GetVersionStore() != nullptr);
   page->RUnlatch();
   buffer_pool_manager_->UnpinPage(first_page_id_, false);
   return TableIterator(this, rid, txn);
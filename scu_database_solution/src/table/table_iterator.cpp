@@ -11,7 +11,12 @@ namespace scudb {
 TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn)
     : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn) {
   if (rid.GetPageId() != INVALID_PAGE_ID) {
-    table_heap_->GetTuple(tuple_->rid_, *tuple_, txn_);
+    // a snapshot, optimistic or read-only read skips the tuples it does not
+    // see
+    if (!table_heap_->GetTuple(tuple_->rid_, *tuple_, txn_) &&
+        (txn_->GetVersionStore() != nullptr || txn_->IsOptimistic() ||
+         txn_->IsReadOnly()))
+      ++(*this);
   }
 };
 
@@ -32,24 +37,42 @@ TableIterator &TableIterator::operator++() {
   cur_page->RLatch();
   assert(cur_page != nullptr); // all pages are pinned
 
-  RID next_tuple_rid;
-  if (!cur_page->GetNextTupleRid(tuple_->rid_,
-                                 next_tuple_rid)) { // end of this page
-    while (cur_page->GetNextPageId() != INVALID_PAGE_ID) {
-      auto next_page = static_cast<TablePage *>(
-          buffer_pool_manager->FetchPage(cur_page->GetNextPageId()));
-      cur_page->RUnlatch();
-      buffer_pool_manager->UnpinPage(cur_page->GetPageId(), false);
-      cur_page = next_page;
-      cur_page->RLatch();
-      if (cur_page->GetFirstTupleRid(next_tuple_rid))
-        break;
+  // a snapshot visits every slot, it may see tuples that were deleted since
+  // it began, and skips the ones it does not see
+  bool snapshot = txn_ != nullptr && txn_->GetVersionStore() != nullptr;
+  bool visible = false;
+  while (!visible) {
+    RID next_tuple_rid;
+    if (!cur_page->GetNextTupleRid(tuple_->rid_, next_tuple_rid,
+                                   snapshot)) { // end of this page
+      while (cur_page->GetNextPageId() != INVALID_PAGE_ID) {
+        auto next_page = static_cast<TablePage *>(
+            buffer_pool_manager->FetchPage(cur_page->GetNextPageId()));
+        cur_page->RUnlatch();
+        buffer_pool_manager->UnpinPage(cur_page->GetPageId(), false);
+        cur_page = next_page;
+        cur_page->RLatch();
+        if (cur_page->GetFirstTupleRid(next_tuple_rid, snapshot))
+          break;
+      }
+    }
+    tuple_->rid_ = next_tuple_rid;
+    if (*this == table_heap_->end())
+      break;
+    if (snapshot) {
+      visible =
+          table_heap_->GetSnapshotTuple(cur_page, tuple_->rid_, *tuple_, txn_);
+    } else if (txn_ != nullptr && txn_->IsOptimistic()) {
+      // its own buffered deletes are gone
+      visible = table_heap_->GetOptimisticTuple(cur_page, tuple_->rid_,
+                                                *tuple_, txn_);
+    } else if (txn_ != nullptr && txn_->IsReadOnly()) {
+      // the page is latched already, a read-only read needs nothing else
+      visible = cur_page->ReadTuple(tuple_->rid_, *tuple_);
+    } else {
+      table_heap_->GetTuple(tuple_->rid_, *tuple_, txn_);
+      visible = true;
     }
-  }
-  tuple_->rid_ = next_tuple_rid;
-
-  if (*this != table_heap_->end()) {
-    table_heap_->GetTuple(tuple_->rid_, *tuple_, txn_);
   }
   // release until copy the tuple
   cur_page->RUnlatch();
@@ -127,12 +127,16 @@ void Tuple::SerializeTo(char *storage) const {
 
 void Tuple::DeserializeFrom(const char *storage) {
   uint32_t size = *reinterpret_cast<const int32_t *>(storage);
+  DeserializeFrom(storage + sizeof(int32_t), size);
+}
+
+void Tuple::DeserializeFrom(const char *data, int32_t size) {
   // construct a tuple
   this->size_ = size;
   if (this->allocated_)
     delete[] this->data_;
   this->data_ = new char[this->size_];
-  memcpy(this->data_, storage + sizeof(int32_t), this->size_);
+  memcpy(this->data_, data, this->size_);
   this->allocated_ = true;
 }
 
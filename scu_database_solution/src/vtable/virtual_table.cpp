@@ -5,11 +5,13 @@
 #include <cstring>
 #include <iostream>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <vector>
 
 #include "common/exception.h"
 #include "common/logger.h"
 #include "common/string_utility.h"
+#include "logging/log_recovery.h"
 #include "page/header_page.h"
 #include "vtable/virtual_table.h"
 
@@ -25,6 +27,12 @@ int VtabCreate(sqlite3 *db, void *pAux, int argc, const char *const *argv,
   LockManager *lock_manager = storage_engine_->lock_manager_;
   LogManager *log_manager = storage_engine_->log_manager_;
 
+  // no table can be created in a read only database
+  if (buffer_pool_manager->IsReadOnly()) {
+    *pzErr = sqlite3_mprintf("read only database");
+    return SQLITE_READONLY;
+  }
+
   // fetch header page from buffer pool
   HeaderPage *header_page =
       static_cast<HeaderPage *>(buffer_pool_manager->FetchPage(HEADER_PAGE_ID));
@@ -158,9 +166,11 @@ int VtabDisconnect(sqlite3_vtab *pVtab) {
 
 int VtabOpen(sqlite3_vtab *pVtab, sqlite3_vtab_cursor **ppCursor) {
   // LOG_DEBUG("VtabOpen");
-  // if read operation, begin transaction here
+  // if read operation, begin a read-only transaction here, writes begin
+  // theirs in VtabBegin first
   if (global_transaction_ == nullptr) {
-    VtabBegin(pVtab);
+    global_transaction_ =
+        storage_engine_->transaction_manager_->BeginReadOnly();
   }
   VirtualTable *virtual_table = reinterpret_cast<VirtualTable *>(pVtab);
   Cursor *cursor = new Cursor(virtual_table);
@@ -258,6 +268,8 @@ int VtabUpdate(sqlite3_vtab *pVTab, int argc, sqlite3_value **argv,
                sqlite_int64 *pRowid) {
   // LOG_DEBUG("VtabUpdate");
   VirtualTable *table = reinterpret_cast<VirtualTable *>(pVTab);
+  if (storage_engine_->buffer_pool_manager_->IsReadOnly())
+    return SQLITE_READONLY;
   // The single row with rowid equal to argv[0] is deleted
   if (argc == 1) {
     const RID rid(sqlite3_value_int64(argv[0]));
@@ -313,13 +325,18 @@ int VtabCommit(sqlite3_vtab *pVTab) {
     return SQLITE_OK;
   // get global txn manager
   auto transaction_manager = storage_engine_->transaction_manager_;
-  // invoke transaction manager to commit(this txn can't fail)
-  transaction_manager->Commit(transaction);
-  // when commit, delete transaction pointer and set to null
-  delete transaction;
+  // invoke transaction manager to commit, it fails when validation aborts
+  // the txn or when its commit can't be logged
+  int rc = SQLITE_OK;
+  if (!transaction_manager->Commit(transaction)) {
+    rc = transaction->GetState() == TransactionState::ABORTED ? SQLITE_ABORT
+                                                             : SQLITE_IOERR;
+  }
+  // when commit, give the transaction back for reuse and set to null
+  transaction_manager->Release(transaction);
   global_transaction_ = nullptr;
 
-  return SQLITE_OK;
+  return rc;
 }
 
 sqlite3_module VtableModule = {
@@ -357,11 +374,41 @@ __declspec(dllexport)
   std::string db_file_name = "vtable.db";
   struct stat buffer;
   bool is_file_exist = (stat(db_file_name.c_str(), &buffer) == 0);
+  // replicas ship a db file we are not allowed to write, serve it read only
+  bool read_only = is_file_exist && access(db_file_name.c_str(), W_OK) != 0;
 
   // init storage engine
-  storage_engine_ = new StorageEngine(db_file_name);
-  // start the logging
-  storage_engine_->log_manager_->RunFlushThread();
+  storage_engine_ =
+      new StorageEngine(db_file_name, DurabilityLevel::GROUP, read_only);
+  // bring an existing db back to a consistent state before logging again,
+  // undo logs its CLRs and ends the losers once the log runs
+  if (is_file_exist && !read_only) {
+    LogRecovery log_recovery(storage_engine_->disk_manager_,
+                             storage_engine_->buffer_pool_manager_);
+    log_recovery.Redo();
+    storage_engine_->log_manager_->SetNextLSN(log_recovery.GetNextLSN());
+    storage_engine_->log_manager_->RunFlushThread();
+    if (!log_recovery.Undo(storage_engine_->log_manager_)) {
+      LOG_DEBUG("recovery could not log the undo of %d losers",
+                static_cast<int>(log_recovery.GetLosers().size()));
+    }
+    // the recovered pages are not covered by any checkpoint yet
+    storage_engine_->buffer_pool_manager_->FlushAllPages();
+  }
+  // start the logging, nothing is ever logged in read only mode
+  if (!read_only) {
+    storage_engine_->log_manager_->RunFlushThread();
+    // checkpoint before any transaction runs, so that the next recovery does
+    // not read the old log
+    if (is_file_exist)
+      storage_engine_->checkpoint_manager_->Checkpoint();
+    storage_engine_->checkpoint_manager_->StartCheckpointThread(
+        std::chrono::milliseconds(CHECKPOINT_INTERVAL));
+  }
+  // cursors read a snapshot and never wait for writers
+  storage_engine_->transaction_manager_->SetSnapshotIsolation(true);
+  storage_engine_->transaction_manager_->StartVacuumThread(
+      std::chrono::milliseconds(VACUUM_INTERVAL));
   // create header page from BufferPoolManager if necessary
   if (!is_file_exist) {
     page_id_t header_page_id;
@@ -99,4 +99,145 @@ namespace scudb {
         remove("test.db");
     }
 
+    TEST(BufferPoolManagerTest, FlushAllPagesTest) {
+        page_id_t temp_page_id;
+
+        DiskManager *disk_manager = new DiskManager("test.db");
+        BufferPoolManager bpm(10, disk_manager);
+
+        // ten adjacent dirty pages
+        for (int i = 0; i < 10; ++i) {
+            Page *page = bpm.NewPage(temp_page_id);
+            ASSERT_NE(nullptr, page);
+            EXPECT_EQ(i, temp_page_id);
+            snprintf(page->GetData(), PAGE_SIZE, "page %d", i);
+            EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+        }
+        // a clean unpin must not drop the dirty flag
+        bpm.FetchPage(3);
+        EXPECT_EQ(true, bpm.UnpinPage(3, false));
+
+        int writes = disk_manager->GetNumPageWrites();
+        bpm.FlushAllPages();
+        // all pages are adjacent, so they are merged into a single write
+        EXPECT_EQ(writes + 1, disk_manager->GetNumPageWrites());
+
+        char buffer[PAGE_SIZE];
+        char expected[PAGE_SIZE];
+        for (int i = 0; i < 10; ++i) {
+            disk_manager->ReadPage(i, buffer);
+            snprintf(expected, PAGE_SIZE, "page %d", i);
+            EXPECT_EQ(0, strcmp(buffer, expected));
+        }
+
+        // nothing is dirty any more
+        bpm.FlushAllPages();
+        EXPECT_EQ(writes + 1, disk_manager->GetNumPageWrites());
+
+        // two separate runs: {2, 3} and {7}
+        for (page_id_t page_id : {2, 3, 7}) {
+            bpm.FetchPage(page_id);
+            EXPECT_EQ(true, bpm.UnpinPage(page_id, true));
+        }
+        bpm.FlushPages({7, 3, 2, 42});
+        EXPECT_EQ(writes + 3, disk_manager->GetNumPageWrites());
+
+        delete disk_manager;
+        remove("test.db");
+    }
+
+    TEST(BufferPoolManagerTest, ReadOnlyTest) {
+        page_id_t temp_page_id;
+
+        DiskManager *disk_manager = new DiskManager("test.db");
+        BufferPoolManager *bpm = new BufferPoolManager(10, disk_manager);
+        for (int i = 0; i < 5; ++i) {
+            Page *page = bpm->NewPage(temp_page_id);
+            ASSERT_NE(nullptr, page);
+            snprintf(page->GetData(), PAGE_SIZE, "page %d", i);
+            EXPECT_EQ(true, bpm->UnpinPage(temp_page_id, true));
+        }
+        bpm->FlushAllPages();
+        delete bpm;
+        delete disk_manager;
+
+        disk_manager = new DiskManager("test.db", DurabilityLevel::GROUP, true);
+        bpm = new BufferPoolManager(2, disk_manager);
+        EXPECT_EQ(true, bpm->IsReadOnly());
+        EXPECT_EQ(5, disk_manager->GetNumMappedPages());
+
+        // more pages than frames can be held at the same time, nothing is pinned
+        char expected[PAGE_SIZE];
+        for (int i = 0; i < 5; ++i) {
+            Page *page = bpm->FetchPage(i);
+            ASSERT_NE(nullptr, page);
+            EXPECT_EQ(i, page->GetPageId());
+            // served straight from the mapping
+            EXPECT_EQ(disk_manager->GetMappedPage(i), page->GetData());
+            snprintf(expected, PAGE_SIZE, "page %d", i);
+            EXPECT_EQ(0, strcmp(page->GetData(), expected));
+        }
+        // the same descriptor is handed out again
+        EXPECT_EQ(bpm->FetchPage(3), bpm->FetchPage(3));
+        EXPECT_EQ(true, bpm->UnpinPage(3, false));
+        EXPECT_EQ(nullptr, bpm->FetchPage(5));
+
+        // writers are rejected
+        EXPECT_EQ(nullptr, bpm->NewPage(temp_page_id));
+        EXPECT_EQ(false, bpm->DeletePage(0));
+        EXPECT_EQ(false, bpm->UnpinPage(0, true));
+        int writes = disk_manager->GetNumPageWrites();
+        disk_manager->WritePage(0, expected);
+        EXPECT_EQ(writes, disk_manager->GetNumPageWrites());
+
+        delete bpm;
+        delete disk_manager;
+        remove("test.db");
+        remove("test.log");
+    }
+
+    TEST(BufferPoolManagerTest, WalAwareEvictionTest) {
+        page_id_t temp_page_id;
+
+        DiskManager *disk_manager = new DiskManager("test.db");
+        LogManager *log_manager = new LogManager(disk_manager);
+        BufferPoolManager bpm(3, disk_manager, log_manager);
+        // the flush thread is not running, durability is set by hand
+        ENABLE_LOGGING = true;
+        log_manager->SetPersistentLSN(3);
+
+        // page 0 stays pinned, pages 1 and 2 are dirty
+        ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+        Page *page_one = bpm.NewPage(temp_page_id);
+        Page *page_two = bpm.NewPage(temp_page_id);
+        ASSERT_NE(nullptr, page_one);
+        ASSERT_NE(nullptr, page_two);
+        page_one->SetLSN(5);
+        page_two->SetLSN(2);
+        EXPECT_EQ(true, bpm.UnpinPage(1, true));
+        EXPECT_EQ(true, bpm.UnpinPage(2, true));
+
+        // page 1 is least recently used, but its log is not on disk yet
+        int writes = disk_manager->GetNumPageWrites();
+        Page *page_three = bpm.NewPage(temp_page_id);
+        ASSERT_NE(nullptr, page_three);
+        EXPECT_EQ(page_two, page_three);
+        EXPECT_EQ(writes + 1, disk_manager->GetNumPageWrites());
+        EXPECT_EQ(1u, bpm.GetNumEvictions());
+        EXPECT_EQ(0u, bpm.GetNumLogWaits());
+
+        // no durable victim is left, the eviction waits for the log
+        page_three->SetLSN(7);
+        EXPECT_EQ(true, bpm.UnpinPage(3, true));
+        EXPECT_NE(nullptr, bpm.NewPage(temp_page_id));
+        EXPECT_EQ(2u, bpm.GetNumEvictions());
+        EXPECT_EQ(1u, bpm.GetNumLogWaits());
+
+        ENABLE_LOGGING = false;
+        delete log_manager;
+        delete disk_manager;
+        remove("test.db");
+        SegmentedLogFile::Remove("test.log");
+    }
+
 } // namespace scudb
@@ -96,4 +96,32 @@ namespace scudb {
             value = -1;
         }
     }
+
+    TEST(LRUReplacerTest, VictimIfTest) {
+        LRUReplacer<int> lru_replacer;
+        for (int i = 0; i < 10; ++i) {
+            lru_replacer.Insert(i);
+        }
+        auto even = [](const int &value) { return value % 2 == 0; };
+        auto large = [](const int &value) { return value > 5; };
+
+        // the least recently used of the members that qualify
+        int value = -1;
+        EXPECT_EQ(true, lru_replacer.VictimIf(value, even, 10));
+        EXPECT_EQ(0, value);
+        lru_replacer.Insert(1);
+        EXPECT_EQ(true, lru_replacer.VictimIf(value, even, 10));
+        EXPECT_EQ(2, value);
+        // only the depth oldest members are looked at
+        EXPECT_EQ(false, lru_replacer.VictimIf(value, large, 3));
+        EXPECT_EQ(true, lru_replacer.VictimIf(value, large, 4));
+        EXPECT_EQ(6, value);
+
+        // the others keep their order
+        EXPECT_EQ(7, lru_replacer.Size());
+        for (int expected : {3, 4, 5, 7, 8, 9, 1}) {
+            EXPECT_EQ(true, lru_replacer.Victim(value));
+            EXPECT_EQ(expected, value);
+        }
+    }
 } // namespace scudb
@@ -2,14 +2,17 @@
  * rwmutex_test.cpp
  */
 
+#include <chrono>
+#include <cstdio>
 #include <thread>
+#include <vector>
 
 #include "common/rwmutex.h"
 #include "gtest/gtest.h"
 
 namespace scudb {
 
-class Counter {
+template <typename Mutex> class Counter {
 public:
   Counter() : count_(0), mutex{} {}
   void Add(int num) {
@@ -26,12 +29,12 @@ public:
   }
 private:
   int count_;
-  RWMutex mutex;
+  Mutex mutex;
 };
 
 TEST(RWMutexTest, BasicTest) {
   int num_threads = 100;
-  Counter counter{};
+  Counter<RWMutex> counter{};
   counter.Add(5);
   std::vector<std::thread> threads;
   for (int tid = 0; tid < num_threads; tid++) {
@@ -50,4 +53,57 @@ TEST(RWMutexTest, BasicTest) {
   }
   EXPECT_EQ(counter.Read(), 55);
 }
+
+// writers keep out readers and each other under contention
+template <typename Mutex> static void ContendedCount() {
+  const int num_threads = 8;
+  const int num_adds = 2000;
+  Counter<Mutex> counter{};
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.push_back(std::thread([tid, &counter]() {
+      for (int i = 0; i < num_adds; i++) {
+        if (tid % 2 == 0)
+          counter.Read();
+        else
+          counter.Add(1);
+      }
+    }));
+  }
+  for (auto &thread : threads)
+    thread.join();
+  EXPECT_EQ(num_threads / 2 * num_adds, counter.Read());
+}
+
+TEST(RWMutexTest, ContendedTest) {
+  ContendedCount<RWMutex>();
+  ContendedCount<DistributedRWMutex>();
+}
+
+// cost of an uncontended shared and exclusive latch
+template <typename Mutex> static void LatchCost(const char *name) {
+  const int rounds = 1000000;
+  Mutex mutex;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++) {
+    mutex.RLock();
+    mutex.RUnlock();
+  }
+  auto middle = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++) {
+    mutex.WLock();
+    mutex.WUnlock();
+  }
+  auto end = std::chrono::steady_clock::now();
+  printf("%s: %.1f ns shared, %.1f ns exclusive\n", name,
+         std::chrono::duration<double, std::nano>(middle - start).count() /
+             rounds,
+         std::chrono::duration<double, std::nano>(end - middle).count() /
+             rounds);
+}
+
+TEST(RWMutexTest, DISABLED_LatchCostBenchmark) {
+  LatchCost<RWMutex>("RWMutex");
+  LatchCost<DistributedRWMutex>("DistributedRWMutex");
 }
+} // namespace scudb
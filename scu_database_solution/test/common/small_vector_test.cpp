@@ -0,0 +1,55 @@
+/**
+ * small_vector_test.cpp
+ */
+
+#include <string>
+
+#include "common/small_vector.h"
+#include "gtest/gtest.h"
+
+namespace scudb {
+
+TEST(SmallVectorTest, BasicTest) {
+  SmallVector<std::string, 2> vector;
+  EXPECT_TRUE(vector.empty());
+  EXPECT_EQ(2, vector.capacity());
+  // past the inline elements, the strings move to the heap
+  for (int i = 0; i < 10; i++)
+    vector.emplace_back(std::to_string(i));
+  EXPECT_EQ(10, vector.size());
+  EXPECT_LE(10, vector.capacity());
+  for (int i = 0; i < 10; i++)
+    EXPECT_EQ(std::to_string(i), vector[i]);
+  EXPECT_EQ("9", vector.back());
+  vector.pop_back();
+  EXPECT_EQ("8", *vector.rbegin());
+
+  // cleared, the storage stays
+  size_t capacity = vector.capacity();
+  vector.clear();
+  EXPECT_TRUE(vector.empty());
+  EXPECT_EQ(capacity, vector.capacity());
+  vector.push_back("a");
+  EXPECT_EQ("a", vector[0]);
+}
+
+TEST(SmallVectorTest, SwapTest) {
+  SmallVector<std::string, 2> inline_vector, heap_vector;
+  inline_vector.push_back("a");
+  for (int i = 0; i < 5; i++)
+    heap_vector.push_back(std::to_string(i));
+
+  inline_vector.swap(heap_vector);
+  EXPECT_EQ(5, inline_vector.size());
+  EXPECT_EQ("4", inline_vector.back());
+  EXPECT_EQ(1, heap_vector.size());
+  EXPECT_EQ("a", heap_vector.back());
+
+  // the empty side gets the elements, the other one is left empty
+  SmallVector<std::string, 2> empty;
+  empty.swap(heap_vector);
+  EXPECT_TRUE(heap_vector.empty());
+  EXPECT_EQ("a", empty[0]);
+}
+
+} // namespace scudb
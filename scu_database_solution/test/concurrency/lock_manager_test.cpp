@@ -2,7 +2,13 @@
  * lock_manager_test.cpp
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
 #include <thread>
+#include <vector>
 
 #include "concurrency/transaction_manager.h"
 #include "gtest/gtest.h"
@@ -40,4 +46,322 @@ TEST(LockManagerTest, BasicTest) {
   t0.join();
   t1.join();
 }
+
+// an older transaction waits for a younger one, never the other way round
+TEST(LockManagerTest, WaitDieTest) {
+  LockManager lock_mgr{true};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid{0, 0};
+  Transaction txn0(0), txn1(1);
+
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, rid));
+  // the younger one dies at once
+  EXPECT_FALSE(lock_mgr.LockShared(&txn1, rid));
+  EXPECT_EQ(TransactionState::ABORTED, txn1.GetState());
+  // strict 2PL keeps the lock until commit
+  txn_mgr.Commit(&txn0);
+
+  Transaction txn2(2), txn3(3);
+  std::atomic<bool> released(false);
+  EXPECT_TRUE(lock_mgr.LockShared(&txn3, rid));
+  std::thread t0([&] {
+    EXPECT_TRUE(lock_mgr.LockExclusive(&txn2, rid));
+    EXPECT_TRUE(released);
+    txn_mgr.Commit(&txn2);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  released = true;
+  txn_mgr.Commit(&txn3);
+  t0.join();
+  EXPECT_TRUE(txn3.GetSharedLockSet()->empty());
+  EXPECT_TRUE(txn2.GetExclusiveLockSet()->empty());
+}
+
+TEST(LockManagerTest, UpgradeTest) {
+  LockManager lock_mgr{true};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid{0, 0};
+  Transaction txn0(0), txn1(1), txn2(2);
+  std::atomic<int> order(0);
+
+  EXPECT_TRUE(lock_mgr.LockShared(&txn1, rid));
+  EXPECT_TRUE(lock_mgr.LockShared(&txn2, rid));
+  // the oldest transaction waits for both shared locks
+  std::thread t0([&] {
+    EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, rid));
+    EXPECT_EQ(1, order++);
+    txn_mgr.Commit(&txn0);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  // the upgrade goes ahead of the waiting exclusive request
+  std::thread t1([&] {
+    EXPECT_TRUE(lock_mgr.LockUpgrade(&txn1, rid));
+    EXPECT_EQ(0, order++);
+    EXPECT_EQ(1U, txn1.GetExclusiveLockSet()->count(rid));
+    EXPECT_EQ(0U, txn1.GetSharedLockSet()->count(rid));
+    txn_mgr.Commit(&txn1);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  // a second upgrade of the younger holder dies
+  EXPECT_FALSE(lock_mgr.LockUpgrade(&txn2, rid));
+  EXPECT_EQ(TransactionState::ABORTED, txn2.GetState());
+  EXPECT_EQ(0, order);
+  txn_mgr.Abort(&txn2);
+  t1.join();
+  t0.join();
+  EXPECT_EQ(2, order);
+}
+
+TEST(LockManagerTest, DISABLED_ShardScalingBenchmark) {
+  const int num_threads = 8, num_txns = 200, locks_per_txn = 50;
+  for (int num_shards = 1; num_shards <= 64; num_shards *= 64) {
+    LockManager lock_mgr{true, num_shards};
+    TransactionManager txn_mgr{&lock_mgr};
+    EXPECT_EQ(num_shards, lock_mgr.GetNumShards());
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int tid = 0; tid < num_threads; tid++) {
+      threads.push_back(std::thread([&, tid] {
+        for (int i = 0; i < num_txns; i++) {
+          Transaction *txn = txn_mgr.Begin();
+          // every thread locks tuples of its own, only the latches meet
+          for (int j = 0; j < locks_per_txn; j++) {
+            EXPECT_TRUE(lock_mgr.LockExclusive(txn, RID(tid, 2 * j)));
+            EXPECT_TRUE(lock_mgr.LockShared(txn, RID(tid, 2 * j + 1)));
+          }
+          txn_mgr.Commit(txn);
+          delete txn;
+        }
+      }));
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    printf("%d shards: %.0f locks/s\n", num_shards,
+           2.0 * num_threads * num_txns * locks_per_txn / seconds);
+  }
+}
+
+TEST(LockManagerTest, DeadlockDetectionTest) {
+  LockManager lock_mgr{true};
+  TransactionManager txn_mgr{&lock_mgr};
+  // detection rounds are run by hand below
+  lock_mgr.StartDeadlockDetection(std::chrono::hours(1));
+  RID a{0, 0}, b{0, 1};
+  Transaction txn0(0), txn1(1);
+
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, a));
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn1, b));
+  // without wait-die the older transaction waits, and so does the younger
+  std::thread t0([&] {
+    EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, b));
+    txn_mgr.Commit(&txn0);
+  });
+  std::thread t1([&] {
+    EXPECT_FALSE(lock_mgr.LockExclusive(&txn1, a));
+    EXPECT_EQ(TransactionState::ABORTED, txn1.GetState());
+    txn_mgr.Abort(&txn1);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(0, lock_mgr.GetNumAborts());
+  // the youngest transaction of the cycle is the victim
+  EXPECT_EQ(1, lock_mgr.DetectDeadlocks());
+  t1.join();
+  t0.join();
+  EXPECT_EQ(TransactionState::COMMITTED, txn0.GetState());
+  EXPECT_EQ(0, lock_mgr.DetectDeadlocks());
+  EXPECT_EQ(1, lock_mgr.GetNumDeadlocks());
+  EXPECT_EQ(1, lock_mgr.GetNumAborts());
+  EXPECT_LT(0, lock_mgr.GetAverageDetectionLatency());
+  lock_mgr.StopDeadlockDetection();
+}
+
+TEST(LockManagerTest, AbortedUpgradeTest) {
+  LockManager lock_mgr{true};
+  TransactionManager txn_mgr{&lock_mgr};
+  lock_mgr.StartDeadlockDetection(std::chrono::hours(1));
+  RID a{0, 0}, b{0, 1};
+  Transaction txn0(0), txn1(1);
+
+  EXPECT_TRUE(lock_mgr.LockShared(&txn0, a));
+  EXPECT_TRUE(lock_mgr.LockShared(&txn1, a));
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn1, b));
+  // the upgrade of txn1 waits for txn0, which waits for txn1
+  std::thread t1([&] {
+    EXPECT_FALSE(lock_mgr.LockUpgrade(&txn1, a));
+    EXPECT_EQ(TransactionState::ABORTED, txn1.GetState());
+    // the shared lock is still held, as the lock set says
+    EXPECT_EQ(1U, txn1.GetSharedLockSet()->count(a));
+    EXPECT_EQ(0U, txn1.GetExclusiveLockSet()->count(a));
+    EXPECT_TRUE(lock_mgr.Unlock(&txn1, a));
+    txn_mgr.Abort(&txn1);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  std::thread t0([&] {
+    EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, b));
+    EXPECT_TRUE(lock_mgr.LockUpgrade(&txn0, a));
+    txn_mgr.Commit(&txn0);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(1, lock_mgr.DetectDeadlocks());
+  t1.join();
+  t0.join();
+  EXPECT_EQ(TransactionState::COMMITTED, txn0.GetState());
+  lock_mgr.StopDeadlockDetection();
+}
+
+// transactions lock a few tuples in random order, mostly from a small hot set
+TEST(LockManagerTest, DISABLED_DeadlockPolicyBenchmark) {
+  const int num_threads = 4, locks_per_txn = 4, num_hot = 8;
+  const auto duration = std::chrono::milliseconds(300);
+  for (int detection = 0; detection < 2; detection++) {
+    LockManager lock_mgr{true};
+    TransactionManager txn_mgr{&lock_mgr};
+    if (detection)
+      lock_mgr.StartDeadlockDetection(std::chrono::milliseconds(5));
+    std::atomic<int> commits(0);
+    auto deadline = std::chrono::steady_clock::now() + duration;
+    std::vector<std::thread> threads;
+    for (int tid = 0; tid < num_threads; tid++) {
+      threads.push_back(std::thread([&, tid] {
+        std::mt19937 rng(tid);
+        while (std::chrono::steady_clock::now() < deadline) {
+          Transaction *txn = txn_mgr.Begin();
+          bool ok = true;
+          for (int i = 0; i < locks_per_txn && ok; i++) {
+            int slot = rng() % 5 == 0 ? num_hot + rng() % 1000
+                                      : rng() % num_hot;
+            RID rid(0, slot);
+            if (txn->GetExclusiveLockSet()->count(rid) == 0)
+              ok = lock_mgr.LockExclusive(txn, rid);
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+          }
+          if (ok) {
+            txn_mgr.Commit(txn);
+            commits++;
+          } else {
+            txn_mgr.Abort(txn);
+          }
+          delete txn;
+        }
+      }));
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    lock_mgr.StopDeadlockDetection();
+    int aborts = lock_mgr.GetNumAborts();
+    printf("%s: %d commits, abort rate %.1f%%, %d deadlocks, detection "
+           "latency %.0f us\n",
+           detection ? "deadlock detection" : "wait-die", commits.load(),
+           100.0 * aborts / std::max(1, aborts + commits.load()),
+           lock_mgr.GetNumDeadlocks(), lock_mgr.GetAverageDetectionLatency());
+    EXPECT_LT(0, commits.load());
+  }
+}
+
+TEST(LockManagerTest, TableLockTest) {
+  LockManager lock_mgr{true};
+  TransactionManager txn_mgr{&lock_mgr};
+  const page_id_t table_id = 1;
+  Transaction txn0(0), txn1(1), txn2(2);
+  std::atomic<bool> locked(false);
+
+  // tuple locks announce themselves on the table
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn1, RID(1, 0), table_id));
+  EXPECT_EQ(LockMode::INTENTION_EXCLUSIVE,
+            txn1.GetTableLockSet()->at(table_id));
+  EXPECT_TRUE(lock_mgr.LockShared(&txn2, RID(1, 1), table_id));
+  EXPECT_EQ(LockMode::INTENTION_SHARED, txn2.GetTableLockSet()->at(table_id));
+  // S conflicts with IX: the younger transaction dies, the older one waits
+  EXPECT_FALSE(lock_mgr.LockTable(&txn2, table_id, LockMode::SHARED));
+  txn_mgr.Abort(&txn2);
+  EXPECT_TRUE(txn2.GetTableLockSet()->empty());
+  std::thread t0([&] {
+    EXPECT_TRUE(lock_mgr.LockTable(&txn0, table_id, LockMode::SHARED));
+    locked = true;
+    // the table lock covers every shared tuple lock
+    EXPECT_TRUE(lock_mgr.LockShared(&txn0, RID(1, 0), table_id));
+    EXPECT_TRUE(txn0.GetSharedLockSet()->empty());
+    // S and IX convert to SIX
+    EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, RID(1, 2), table_id));
+    EXPECT_EQ(LockMode::SHARED_INTENTION_EXCLUSIVE,
+              txn0.GetTableLockSet()->at(table_id));
+    txn_mgr.Commit(&txn0);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(locked);
+  txn_mgr.Commit(&txn1);
+  t0.join();
+  EXPECT_TRUE(locked);
+  EXPECT_TRUE(txn0.GetTableLockSet()->empty());
+}
+
+TEST(LockManagerTest, EscalationTest) {
+  LockManager lock_mgr{true};
+  TransactionManager txn_mgr{&lock_mgr};
+  lock_mgr.SetEscalationThreshold(10);
+  const page_id_t table_id = 1;
+  Transaction txn0(0), txn1(1);
+
+  // a conflicting table lock keeps the tuple locks from escalating
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn1, RID(2, 0), table_id));
+  for (int i = 0; i < 10; i++)
+    EXPECT_TRUE(lock_mgr.LockShared(&txn0, RID(1, i), table_id));
+  EXPECT_EQ(0, lock_mgr.GetNumEscalations());
+  EXPECT_EQ(10U, txn0.GetSharedLockSet()->size());
+  txn_mgr.Commit(&txn1);
+
+  // the next tuple lock escalates IS to S and drops the tuple locks
+  EXPECT_TRUE(lock_mgr.LockShared(&txn0, RID(1, 10), table_id));
+  EXPECT_EQ(1, lock_mgr.GetNumEscalations());
+  EXPECT_EQ(LockMode::SHARED, txn0.GetTableLockSet()->at(table_id));
+  EXPECT_TRUE(txn0.GetSharedLockSet()->empty());
+  EXPECT_TRUE(txn0.GetTableTupleLockSet()->at(table_id).empty());
+
+  // exclusive tuple locks escalate SIX to X
+  for (int i = 0; i < 10; i++)
+    EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, RID(1, i), table_id));
+  EXPECT_EQ(2, lock_mgr.GetNumEscalations());
+  EXPECT_EQ(LockMode::EXCLUSIVE, txn0.GetTableLockSet()->at(table_id));
+  EXPECT_TRUE(txn0.GetExclusiveLockSet()->empty());
+  EXPECT_TRUE(txn0.IsExclusiveLocked(RID(1, 5), table_id));
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, RID(1, 20), table_id));
+  EXPECT_TRUE(txn0.GetExclusiveLockSet()->empty());
+  txn_mgr.Commit(&txn0);
+  EXPECT_TRUE(txn0.GetTableLockSet()->empty());
+
+  // the escalated locks are gone, a younger transaction locks the table
+  Transaction txn2(2);
+  EXPECT_TRUE(lock_mgr.LockTable(&txn2, table_id, LockMode::EXCLUSIVE));
+  txn_mgr.Commit(&txn2);
+}
+
+// one transaction reads every tuple of a large table, with and without lock
+// escalation
+TEST(LockManagerTest, DISABLED_ScanEscalationBenchmark) {
+  const int num_tuples = 200000;
+  const page_id_t table_id = 1;
+  for (int threshold : {num_tuples + 1, LOCK_ESCALATION_THRESHOLD}) {
+    LockManager lock_mgr{true};
+    TransactionManager txn_mgr{&lock_mgr};
+    lock_mgr.SetEscalationThreshold(threshold);
+    auto start = std::chrono::steady_clock::now();
+    Transaction *txn = txn_mgr.Begin();
+    for (int i = 0; i < num_tuples; i++)
+      EXPECT_TRUE(lock_mgr.LockShared(txn, RID(i / 64, i % 64), table_id));
+    size_t tuple_locks = txn->GetSharedLockSet()->size();
+    txn_mgr.Commit(txn);
+    delete txn;
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    printf("threshold %d: %zu tuple locks held, %d escalations, %.0f ms\n",
+           threshold, tuple_locks, lock_mgr.GetNumEscalations(),
+           seconds * 1000);
+  }
+}
 } // namespace scudb
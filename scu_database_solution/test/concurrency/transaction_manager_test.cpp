@@ -0,0 +1,219 @@
+/**
+ * transaction_manager_test.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "concurrency/transaction_manager.h"
+#include "vtable/virtual_table.h"
+#include "gtest/gtest.h"
+
+namespace scudb {
+
+// a released transaction comes back reset from the next Begin
+TEST(TransactionManagerTest, PoolTest) {
+  bool enable_logging = ENABLE_LOGGING;
+  ENABLE_LOGGING = false;
+  LockManager lock_mgr{false};
+  TransactionManager txn_mgr{&lock_mgr};
+
+  Transaction *txn = txn_mgr.Begin();
+  txn_id_t txn_id = txn->GetTransactionId();
+  EXPECT_TRUE(lock_mgr.LockShared(txn, RID(0, 0)));
+  txn->AddIntoPageSet(nullptr);
+  txn->SetAsyncCommit(true);
+  txn_mgr.Commit(txn);
+  txn_mgr.Release(txn);
+
+  Transaction *reused = txn_mgr.Begin();
+  EXPECT_EQ(txn, reused);
+  EXPECT_EQ(txn_id + 1, reused->GetTransactionId());
+  EXPECT_EQ(TransactionState::GROWING, reused->GetState());
+  EXPECT_TRUE(reused->GetSharedLockSet()->empty());
+  EXPECT_TRUE(reused->GetPageSet()->empty());
+  EXPECT_FALSE(reused->IsAsyncCommit());
+  EXPECT_EQ(INVALID_LSN, reused->GetPrevLSN());
+  // a transaction of another manager reuses it as well
+  txn_mgr.Commit(reused);
+  txn_mgr.Release(reused);
+  TransactionManager other_txn_mgr{&lock_mgr};
+  EXPECT_EQ(txn, other_txn_mgr.Begin());
+  other_txn_mgr.Commit(txn);
+  delete txn;
+  ENABLE_LOGGING = enable_logging;
+}
+
+// empty transactions, allocated each time and taken from the pool
+TEST(TransactionManagerTest, DISABLED_BeginBenchmark) {
+  bool enable_logging = ENABLE_LOGGING;
+  ENABLE_LOGGING = false;
+  LockManager lock_mgr{false};
+  TransactionManager txn_mgr{&lock_mgr};
+  const int num_txns = 200000;
+  for (int pooled = 0; pooled < 2; pooled++) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_txns; i++) {
+      Transaction *txn = txn_mgr.Begin();
+      txn_mgr.Commit(txn);
+      if (pooled)
+        txn_mgr.Release(txn);
+      else
+        delete txn;
+    }
+    double ns = std::chrono::duration<double, std::nano>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    printf("%s: %.0f ns per transaction\n", pooled ? "pooled" : "allocated",
+           ns / num_txns);
+  }
+  ENABLE_LOGGING = enable_logging;
+}
+
+// a tuple of 16 times the same character
+static Tuple MakeTuple(char c) {
+  std::string data(16, c);
+  Tuple tuple;
+  tuple.DeserializeFrom(data.data(), data.size());
+  return tuple;
+}
+
+// a read-only transaction neither locks, logs nor writes
+TEST(TransactionManagerTest, ReadOnlyTest) {
+  StorageEngine *storage_engine = new StorageEngine("test.db");
+  storage_engine->log_manager_->RunFlushThread();
+  TransactionManager *txn_mgr = storage_engine->transaction_manager_;
+  Transaction *txn = txn_mgr->Begin();
+  TableHeap table(storage_engine->buffer_pool_manager_,
+                  storage_engine->lock_manager_, storage_engine->log_manager_,
+                  txn);
+  RID a, b;
+  EXPECT_TRUE(table.InsertTuple(MakeTuple('a'), a, txn));
+  EXPECT_TRUE(table.InsertTuple(MakeTuple('b'), b, txn));
+  EXPECT_TRUE(txn_mgr->Commit(txn));
+  txn_mgr->Release(txn);
+
+  // a writer holds a exclusively, the reader does not wait for it
+  Transaction *writer = txn_mgr->Begin();
+  EXPECT_TRUE(table.MarkDelete(a, writer));
+  Transaction *reader = txn_mgr->BeginReadOnly();
+  EXPECT_TRUE(reader->IsReadOnly());
+  Tuple tuple;
+  EXPECT_TRUE(table.GetTuple(b, tuple, reader));
+  EXPECT_EQ('b', tuple.GetData()[0]);
+  // a is marked deleted, the scan passes over it
+  int count = 0;
+  for (auto it = table.begin(reader); it != table.end(); ++it)
+    count++;
+  EXPECT_EQ(1, count);
+  EXPECT_TRUE(reader->GetSharedLockSet()->empty());
+  EXPECT_FALSE(table.UpdateTuple(MakeTuple('c'), b, reader));
+  EXPECT_EQ(TransactionState::ABORTED, reader->GetState());
+  txn_mgr->Abort(reader);
+  EXPECT_EQ(INVALID_LSN, reader->GetPrevLSN());
+  txn_mgr->Release(reader);
+  EXPECT_TRUE(txn_mgr->Commit(writer));
+  txn_mgr->Release(writer);
+
+  // under snapshot isolation it reads its snapshot
+  txn_mgr->SetSnapshotIsolation(true);
+  reader = txn_mgr->BeginReadOnly();
+  writer = txn_mgr->Begin();
+  EXPECT_TRUE(table.UpdateTuple(MakeTuple('c'), b, writer));
+  EXPECT_TRUE(txn_mgr->Commit(writer));
+  EXPECT_TRUE(table.GetTuple(b, tuple, reader));
+  EXPECT_EQ('b', tuple.GetData()[0]);
+  EXPECT_TRUE(txn_mgr->Commit(reader));
+  txn_mgr->Release(reader);
+  txn_mgr->Release(writer);
+
+  delete storage_engine;
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+}
+
+// an insert that conflicts with a table lock aborts before it takes a slot
+TEST(TransactionManagerTest, InsertConflictTest) {
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+  StorageEngine *storage_engine = new StorageEngine("test.db");
+  storage_engine->log_manager_->RunFlushThread();
+  TransactionManager *txn_mgr = storage_engine->transaction_manager_;
+  Transaction *txn = txn_mgr->Begin();
+  TableHeap table(storage_engine->buffer_pool_manager_,
+                  storage_engine->lock_manager_, storage_engine->log_manager_,
+                  txn);
+  EXPECT_TRUE(txn_mgr->Commit(txn));
+  txn_mgr->Release(txn);
+
+  // the older transaction reads the whole table, the younger one dies
+  Transaction *older = txn_mgr->Begin();
+  Transaction *younger = txn_mgr->Begin();
+  EXPECT_TRUE(storage_engine->lock_manager_->LockTable(
+      older, table.GetFirstPageId(), LockMode::SHARED));
+  lsn_t begin_lsn = younger->GetPrevLSN();
+  RID rid;
+  EXPECT_FALSE(table.InsertTuple(MakeTuple('a'), rid, younger));
+  EXPECT_EQ(TransactionState::ABORTED, younger->GetState());
+  EXPECT_TRUE(younger->GetWriteSet()->empty());
+  // nothing was logged
+  EXPECT_EQ(begin_lsn, younger->GetPrevLSN());
+  txn_mgr->Abort(younger);
+  txn_mgr->Release(younger);
+  int count = 0;
+  for (auto it = table.begin(older); it != table.end(); ++it)
+    count++;
+  EXPECT_EQ(0, count);
+
+  // the slot was never taken, the next insert gets it
+  EXPECT_TRUE(table.InsertTuple(MakeTuple('b'), rid, older));
+  EXPECT_EQ(RID(table.GetFirstPageId(), 0), rid);
+  EXPECT_TRUE(txn_mgr->Commit(older));
+  txn_mgr->Release(older);
+
+  delete storage_engine;
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+}
+
+// a SELECT of ten tuples in a full transaction and in a read-only one
+TEST(TransactionManagerTest, DISABLED_SelectBenchmark) {
+  StorageEngine *storage_engine = new StorageEngine("test.db");
+  storage_engine->log_manager_->RunFlushThread();
+  TransactionManager *txn_mgr = storage_engine->transaction_manager_;
+  Transaction *txn = txn_mgr->Begin();
+  TableHeap table(storage_engine->buffer_pool_manager_,
+                  storage_engine->lock_manager_, storage_engine->log_manager_,
+                  txn);
+  std::vector<RID> rids(10);
+  for (auto &rid : rids)
+    EXPECT_TRUE(table.InsertTuple(MakeTuple('a'), rid, txn));
+  EXPECT_TRUE(txn_mgr->Commit(txn));
+  txn_mgr->Release(txn);
+
+  const int num_selects = 5000;
+  for (int read_only = 0; read_only < 2; read_only++) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_selects; i++) {
+      txn = read_only ? txn_mgr->BeginReadOnly() : txn_mgr->Begin();
+      Tuple tuple;
+      for (auto &rid : rids)
+        EXPECT_TRUE(table.GetTuple(rid, tuple, txn));
+      EXPECT_TRUE(txn_mgr->Commit(txn));
+      txn_mgr->Release(txn);
+    }
+    double us = std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    printf("%s: %.1f us per select\n", read_only ? "read-only" : "full",
+           us / num_selects);
+  }
+
+  delete storage_engine;
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+}
+
+} // namespace scudb
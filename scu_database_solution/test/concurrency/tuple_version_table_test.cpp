@@ -0,0 +1,157 @@
+/**
+ * tuple_version_table_test.cpp
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "vtable/virtual_table.h"
+#include "gtest/gtest.h"
+
+namespace scudb {
+
+// a tuple of 16 times the same character
+static Tuple MakeTuple(char c) {
+  std::string data(16, c);
+  Tuple tuple;
+  tuple.DeserializeFrom(data.data(), data.size());
+  return tuple;
+}
+
+// first character of the tuple at rid as txn reads it, '-' if there is none
+static char Read(TableHeap &table, const RID &rid, Transaction *txn) {
+  Tuple tuple;
+  return table.GetTuple(rid, tuple, txn) ? tuple.GetData()[0] : '-';
+}
+
+TEST(TupleVersionTableTest, ValidationTest) {
+  StorageEngine *storage_engine = new StorageEngine("test.db");
+  storage_engine->log_manager_->RunFlushThread();
+  TransactionManager *txn_mgr = storage_engine->transaction_manager_;
+  txn_mgr->SetOptimistic(true);
+  Transaction *txn = txn_mgr->Begin();
+  TableHeap table(storage_engine->buffer_pool_manager_,
+                  storage_engine->lock_manager_, storage_engine->log_manager_,
+                  txn);
+  RID a, b;
+  EXPECT_TRUE(table.InsertTuple(MakeTuple('a'), a, txn));
+  EXPECT_TRUE(table.InsertTuple(MakeTuple('x'), b, txn));
+  EXPECT_TRUE(txn_mgr->Commit(txn));
+  delete txn;
+
+  // txn1 reads a and writes b, the write stays in its write set
+  Transaction *txn0 = txn_mgr->Begin();
+  Transaction *txn1 = txn_mgr->Begin();
+  EXPECT_EQ('a', Read(table, a, txn1));
+  EXPECT_TRUE(table.UpdateTuple(MakeTuple('y'), b, txn1));
+  EXPECT_EQ('y', Read(table, b, txn1));
+  EXPECT_EQ('x', Read(table, b, txn0));
+  EXPECT_TRUE(txn1->GetExclusiveLockSet()->empty());
+  // txn0 commits a write to a first, txn1 read a stale version of it
+  EXPECT_TRUE(table.UpdateTuple(MakeTuple('b'), a, txn0));
+  EXPECT_TRUE(txn_mgr->Commit(txn0));
+  EXPECT_FALSE(txn_mgr->Commit(txn1));
+  EXPECT_EQ(TransactionState::ABORTED, txn1->GetState());
+  delete txn0;
+  delete txn1;
+
+  // a buffered delete hides the tuple from its own scan only
+  txn0 = txn_mgr->Begin();
+  txn1 = txn_mgr->Begin();
+  EXPECT_TRUE(table.MarkDelete(a, txn1));
+  EXPECT_EQ('-', Read(table, a, txn1));
+  EXPECT_EQ('x', table.begin(txn1)->GetData()[0]);
+  EXPECT_EQ('b', table.begin(txn0)->GetData()[0]);
+  EXPECT_TRUE(txn_mgr->Commit(txn1));
+  // txn0 read a before the delete
+  EXPECT_FALSE(txn_mgr->Commit(txn0));
+  delete txn0;
+  delete txn1;
+
+  // an uncommitted insert fails the validation of its readers
+  txn0 = txn_mgr->Begin();
+  txn1 = txn_mgr->Begin();
+  RID c;
+  EXPECT_TRUE(table.InsertTuple(MakeTuple('c'), c, txn1));
+  EXPECT_EQ('c', Read(table, c, txn0));
+  txn_mgr->Abort(txn1);
+  EXPECT_FALSE(txn_mgr->Commit(txn0));
+  txn = txn_mgr->Begin();
+  EXPECT_EQ('-', Read(table, a, txn));
+  EXPECT_EQ('x', Read(table, b, txn));
+  EXPECT_EQ('-', Read(table, c, txn));
+  EXPECT_TRUE(txn_mgr->Commit(txn));
+  delete txn;
+  delete txn0;
+  delete txn1;
+
+  delete storage_engine;
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+}
+
+// threads update their own tuples, each transaction reads four of them and
+// writes two, under strict 2PL and under optimistic concurrency control
+TEST(TupleVersionTableTest, DISABLED_LowConflictBenchmark) {
+  const int num_threads = 4;
+  const int tuples_per_thread = 16;
+  const auto duration = std::chrono::milliseconds(300);
+  for (int optimistic = 0; optimistic < 2; optimistic++) {
+    StorageEngine *storage_engine = new StorageEngine("test.db");
+    storage_engine->log_manager_->RunFlushThread();
+    TransactionManager *txn_mgr = storage_engine->transaction_manager_;
+    txn_mgr->SetOptimistic(optimistic);
+    Transaction *txn = txn_mgr->Begin();
+    TableHeap table(storage_engine->buffer_pool_manager_,
+                    storage_engine->lock_manager_,
+                    storage_engine->log_manager_, txn);
+    std::vector<RID> rids(num_threads * tuples_per_thread);
+    for (auto &rid : rids)
+      EXPECT_TRUE(table.InsertTuple(MakeTuple('a'), rid, txn));
+    EXPECT_TRUE(txn_mgr->Commit(txn));
+    delete txn;
+
+    auto deadline = std::chrono::steady_clock::now() + duration;
+    std::atomic<int> commits(0), aborts(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+      threads.emplace_back([&, i] {
+        std::mt19937 rng(i);
+        while (std::chrono::steady_clock::now() < deadline) {
+          Transaction *txn = txn_mgr->Begin();
+          bool ok = true;
+          for (int j = 0; j < 4 && ok; j++) {
+            Tuple tuple;
+            RID rid = rids[i * tuples_per_thread + rng() % tuples_per_thread];
+            ok = table.GetTuple(rid, tuple, txn);
+            if (ok && j < 2)
+              ok = table.UpdateTuple(MakeTuple('b' + j), rid, txn);
+          }
+          if (!ok)
+            txn_mgr->Abort(txn);
+          if (ok && txn_mgr->Commit(txn))
+            commits++;
+          else
+            aborts++;
+          delete txn;
+        }
+      });
+    }
+    for (auto &thread : threads)
+      thread.join();
+    printf("%s: %d commits %d aborts in %d ms\n",
+           optimistic ? "optimistic" : "strict 2PL", commits.load(),
+           aborts.load(), static_cast<int>(duration.count()));
+    EXPECT_LT(0, commits.load());
+    delete storage_engine;
+    remove("test.db");
+    SegmentedLogFile::Remove("test.log");
+  }
+}
+
+} // namespace scudb
@@ -0,0 +1,195 @@
+/**
+ * version_store_test.cpp
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "vtable/virtual_table.h"
+#include "gtest/gtest.h"
+
+namespace scudb {
+
+// a tuple of 16 times the same character
+static Tuple MakeTuple(char c) {
+  std::string data(16, c);
+  Tuple tuple;
+  tuple.DeserializeFrom(data.data(), data.size());
+  return tuple;
+}
+
+// tuples a snapshot scan of table returns, by their first character
+static std::string Scan(TableHeap &table, Transaction *txn) {
+  std::string result;
+  for (auto it = table.begin(txn); it != table.end(); ++it)
+    result += it->GetData()[0];
+  return result;
+}
+
+TEST(VersionStoreTest, SnapshotReadTest) {
+  StorageEngine *storage_engine = new StorageEngine("test.db");
+  storage_engine->log_manager_->RunFlushThread();
+  TransactionManager *txn_mgr = storage_engine->transaction_manager_;
+  txn_mgr->SetSnapshotIsolation(true);
+  Transaction *txn = txn_mgr->Begin();
+  TableHeap table(storage_engine->buffer_pool_manager_,
+                  storage_engine->lock_manager_, storage_engine->log_manager_,
+                  txn);
+  RID a, b;
+  EXPECT_TRUE(table.InsertTuple(MakeTuple('a'), a, txn));
+  txn_mgr->Commit(txn);
+  delete txn;
+
+  Transaction *reader = txn_mgr->Begin();
+  Transaction *writer = txn_mgr->Begin();
+  EXPECT_TRUE(table.UpdateTuple(MakeTuple('b'), a, writer));
+  EXPECT_TRUE(table.InsertTuple(MakeTuple('c'), b, writer));
+  // the reader neither waits for the writer nor sees its changes
+  Tuple tuple;
+  EXPECT_TRUE(table.GetTuple(a, tuple, reader));
+  EXPECT_EQ('a', tuple.GetData()[0]);
+  EXPECT_FALSE(table.GetTuple(b, tuple, reader));
+  EXPECT_EQ(TransactionState::GROWING, reader->GetState());
+  EXPECT_EQ("bc", Scan(table, writer));
+  txn_mgr->Commit(writer);
+  delete writer;
+  EXPECT_EQ("a", Scan(table, reader));
+
+  // the slot of a deleted tuple is freed at commit, an older snapshot still
+  // sees the tuple
+  Transaction *deleter = txn_mgr->Begin();
+  EXPECT_EQ("bc", Scan(table, deleter));
+  EXPECT_TRUE(table.MarkDelete(a, deleter));
+  txn_mgr->Commit(deleter);
+  delete deleter;
+  EXPECT_EQ("a", Scan(table, reader));
+  EXPECT_TRUE(reader->GetSharedLockSet()->empty());
+  Transaction *reader2 = txn_mgr->Begin();
+  EXPECT_EQ("c", Scan(table, reader2));
+
+  // only the version before the first insert is older than every snapshot,
+  // the others stay until the reader is gone
+  EXPECT_EQ(4, txn_mgr->GetVersionStore()->GetNumVersions());
+  EXPECT_EQ(1, txn_mgr->Vacuum());
+  txn_mgr->Commit(reader);
+  txn_mgr->Commit(reader2);
+  delete reader;
+  delete reader2;
+  EXPECT_EQ(3, txn_mgr->Vacuum());
+  EXPECT_EQ(0, txn_mgr->GetVersionStore()->GetNumVersions());
+
+  delete storage_engine;
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+}
+
+TEST(VersionStoreTest, WriteConflictTest) {
+  StorageEngine *storage_engine = new StorageEngine("test.db");
+  storage_engine->log_manager_->RunFlushThread();
+  TransactionManager *txn_mgr = storage_engine->transaction_manager_;
+  txn_mgr->SetSnapshotIsolation(true);
+  Transaction *txn = txn_mgr->Begin();
+  TableHeap table(storage_engine->buffer_pool_manager_,
+                  storage_engine->lock_manager_, storage_engine->log_manager_,
+                  txn);
+  RID rid;
+  EXPECT_TRUE(table.InsertTuple(MakeTuple('a'), rid, txn));
+  txn_mgr->Commit(txn);
+  delete txn;
+
+  Transaction *txn0 = txn_mgr->Begin();
+  Transaction *txn1 = txn_mgr->Begin();
+  EXPECT_TRUE(table.UpdateTuple(MakeTuple('b'), rid, txn1));
+  txn_mgr->Commit(txn1);
+  // first updater wins, the version txn0 would overwrite is newer than its
+  // snapshot
+  EXPECT_FALSE(table.UpdateTuple(MakeTuple('c'), rid, txn0));
+  EXPECT_EQ(TransactionState::ABORTED, txn0->GetState());
+  txn_mgr->Abort(txn0);
+
+  txn = txn_mgr->Begin();
+  EXPECT_EQ("b", Scan(table, txn));
+  txn_mgr->Commit(txn);
+  EXPECT_EQ(2, txn_mgr->Vacuum());
+  delete txn;
+  delete txn0;
+  delete txn1;
+
+  delete storage_engine;
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+}
+
+// a reporting transaction keeps reading the whole table while a writer
+// updates random tuples, under strict 2PL and under snapshot isolation
+TEST(VersionStoreTest, DISABLED_ReportingQueryBenchmark) {
+  const int num_tuples = 64;
+  const auto duration = std::chrono::milliseconds(300);
+  for (int snapshot = 0; snapshot < 2; snapshot++) {
+    StorageEngine *storage_engine = new StorageEngine("test.db");
+    storage_engine->log_manager_->RunFlushThread();
+    TransactionManager *txn_mgr = storage_engine->transaction_manager_;
+    txn_mgr->SetSnapshotIsolation(snapshot);
+    txn_mgr->StartVacuumThread(std::chrono::milliseconds(VACUUM_INTERVAL));
+    Transaction *txn = txn_mgr->Begin();
+    TableHeap table(storage_engine->buffer_pool_manager_,
+                    storage_engine->lock_manager_,
+                    storage_engine->log_manager_, txn);
+    std::vector<RID> rids(num_tuples);
+    for (int i = 0; i < num_tuples; i++)
+      EXPECT_TRUE(table.InsertTuple(MakeTuple('a'), rids[i], txn));
+    txn_mgr->Commit(txn);
+    delete txn;
+
+    // the reader is older than every writer, a writer never waits for it
+    Transaction *reader = txn_mgr->Begin();
+    auto deadline = std::chrono::steady_clock::now() + duration;
+    int scans = 0;
+    std::atomic<int> commits(0), aborts(0);
+    std::thread writer([&] {
+      std::mt19937 rng(0);
+      while (std::chrono::steady_clock::now() < deadline) {
+        Transaction *txn = txn_mgr->Begin();
+        if (table.UpdateTuple(MakeTuple('b'), rids[rng() % num_tuples], txn)) {
+          txn_mgr->Commit(txn);
+          commits++;
+        } else {
+          txn_mgr->Abort(txn);
+          aborts++;
+        }
+        delete txn;
+      }
+    });
+    while (std::chrono::steady_clock::now() < deadline) {
+      Tuple tuple;
+      for (const RID &rid : rids) {
+        EXPECT_TRUE(table.GetTuple(rid, tuple, reader));
+        if (snapshot) {
+          EXPECT_EQ('a', tuple.GetData()[0]);
+        }
+      }
+      scans++;
+    }
+    writer.join();
+    txn_mgr->Commit(reader);
+    delete reader;
+    printf("%s: %d scans, writer %d commits %d aborts\n",
+           snapshot ? "snapshot isolation" : "strict 2PL", scans,
+           commits.load(), aborts.load());
+    if (snapshot) {
+      EXPECT_EQ(0, aborts.load());
+      txn_mgr->Vacuum();
+      EXPECT_EQ(0, txn_mgr->GetVersionStore()->GetNumVersions());
+    }
+    delete storage_engine;
+    remove("test.db");
+    SegmentedLogFile::Remove("test.log");
+  }
+}
+
+} // namespace scudb
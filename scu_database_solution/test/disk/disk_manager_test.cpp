@@ -0,0 +1,241 @@
+/**
+ * disk_manager_test.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+#include "disk/disk_manager.h"
+#include "gtest/gtest.h"
+
+namespace scudb {
+
+// each committer alternates between two log buffers, WriteLog enforces a swap
+static void Committer(DiskManager *disk_manager, int num_commits,
+                      double *total_us) {
+  char buffers[2][64];
+  memset(buffers, 'x', sizeof(buffers));
+  for (int i = 0; i < num_commits; i++) {
+    auto start = std::chrono::steady_clock::now();
+    disk_manager->WriteLog(buffers[i % 2], sizeof(buffers[0]));
+    auto end = std::chrono::steady_clock::now();
+    *total_us +=
+        std::chrono::duration<double, std::micro>(end - start).count();
+  }
+}
+
+// average commit latency in microseconds over num_threads committers
+static double CommitLatency(DiskManager *disk_manager, int num_threads,
+                            int num_commits) {
+  std::vector<double> totals(num_threads, 0);
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.push_back(std::thread(Committer, disk_manager, num_commits,
+                                  &totals[tid]));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  double sum = 0;
+  for (auto total : totals) {
+    sum += total;
+  }
+  return sum / (num_threads * num_commits);
+}
+
+TEST(DiskManagerTest, DurabilityNoneTest) {
+  DiskManager *disk_manager =
+      new DiskManager("test.db", DurabilityLevel::NONE);
+  char data[PAGE_SIZE] = "none";
+  char log[2][16] = {"a", "b"};
+
+  disk_manager->WritePage(0, data);
+  disk_manager->WriteLog(log[0], sizeof(log[0]));
+  disk_manager->WriteLog(log[1], sizeof(log[1]));
+  std::vector<std::pair<page_id_t, const char *>> pages = {{1, data}};
+  disk_manager->WritePages(pages);
+
+  // nothing is ever synced
+  EXPECT_EQ(0, disk_manager->GetNumLogSyncs());
+  EXPECT_EQ(0, disk_manager->GetNumPageSyncs());
+  EXPECT_EQ(2, disk_manager->GetNumFlushes());
+
+  char buffer[32];
+  EXPECT_TRUE(disk_manager->ReadLog(buffer, sizeof(buffer), 0));
+  EXPECT_EQ(0, strcmp(buffer, "a"));
+  EXPECT_EQ(0, strcmp(buffer + 16, "b"));
+
+  delete disk_manager;
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+}
+
+TEST(DiskManagerTest, DurabilityFullTest) {
+  DiskManager *disk_manager =
+      new DiskManager("test.db", DurabilityLevel::FULL);
+  char data[PAGE_SIZE] = "full";
+  char log[2][16] = {"a", "b"};
+
+  // every log write and every page write syncs on its own
+  disk_manager->WritePage(0, data);
+  disk_manager->WritePage(1, data);
+  disk_manager->WriteLog(log[0], sizeof(log[0]));
+  disk_manager->WriteLog(log[1], sizeof(log[1]));
+  EXPECT_EQ(2, disk_manager->GetNumLogSyncs());
+  EXPECT_EQ(2, disk_manager->GetNumPageSyncs());
+
+  char buffer[PAGE_SIZE];
+  disk_manager->ReadPage(1, buffer);
+  EXPECT_EQ(0, strcmp(buffer, "full"));
+
+  delete disk_manager;
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+}
+
+TEST(DiskManagerTest, DurabilityGroupTest) {
+  DiskManager *disk_manager =
+      new DiskManager("test.db", DurabilityLevel::GROUP);
+  char data[PAGE_SIZE] = "group";
+  char log[2][16] = {"a", "b"};
+
+  // single page writes are left to the batch sync in WritePages
+  disk_manager->WritePage(0, data);
+  EXPECT_EQ(0, disk_manager->GetNumPageSyncs());
+  std::vector<std::pair<page_id_t, const char *>> pages = {{1, data},
+                                                           {2, data}};
+  disk_manager->WritePages(pages);
+  EXPECT_EQ(1, disk_manager->GetNumPageSyncs());
+
+  // a lone committer still syncs every write
+  disk_manager->WriteLog(log[0], sizeof(log[0]));
+  disk_manager->WriteLog(log[1], sizeof(log[1]));
+  EXPECT_EQ(2, disk_manager->GetNumLogSyncs());
+
+  // concurrent committers share syncs, never more than one per write
+  const int num_threads = 8, num_commits = 50;
+  CommitLatency(disk_manager, num_threads, num_commits);
+  EXPECT_EQ(2 + num_threads * num_commits, disk_manager->GetNumFlushes());
+  EXPECT_LE(disk_manager->GetNumLogSyncs(), 2 + num_threads * num_commits);
+
+  delete disk_manager;
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+}
+
+TEST(DiskManagerTest, SegmentedLogTest) {
+  const int64_t segment_size = 4096;
+  char data[1000];
+  char buffer[1000];
+  SegmentedLogFile *log_file = new SegmentedLogFile("test.log", segment_size);
+  log_file->Open(true);
+  EXPECT_FALSE(log_file->Read(buffer, sizeof(buffer), 0));
+
+  // ten appends cross two segment boundaries
+  for (int i = 0; i < 10; i++) {
+    memset(data, 'a' + i, sizeof(data));
+    EXPECT_TRUE(log_file->Append(data, sizeof(data)));
+  }
+  EXPECT_EQ(10000, log_file->GetEndOffset());
+  // the one straddling the first boundary reads back whole
+  EXPECT_TRUE(log_file->Read(buffer, sizeof(buffer), 4000));
+  EXPECT_EQ('e', buffer[0]);
+  EXPECT_EQ('e', buffer[999]);
+  // segments are preallocated, never extended by appends
+  struct stat stat_buf;
+  ASSERT_EQ(0, stat("test.log.0", &stat_buf));
+  EXPECT_EQ(segment_size, stat_buf.st_size);
+  delete log_file;
+
+  // a restart appends to a fresh segment, the old tail reads as zeros
+  log_file = new SegmentedLogFile("test.log", segment_size);
+  log_file->Open(true);
+  EXPECT_EQ(0, log_file->GetStartOffset());
+  EXPECT_EQ(3 * segment_size, log_file->GetEndOffset());
+  EXPECT_TRUE(log_file->Read(buffer, sizeof(buffer), 9000));
+  EXPECT_EQ('j', buffer[999]);
+  EXPECT_TRUE(log_file->Read(buffer, sizeof(buffer), 10000));
+  EXPECT_EQ(0, buffer[0]);
+  memset(data, 'z', sizeof(data));
+  EXPECT_TRUE(log_file->Append(data, sizeof(data)));
+  EXPECT_TRUE(log_file->Read(buffer, sizeof(buffer), 3 * segment_size));
+  EXPECT_EQ('z', buffer[0]);
+
+  // segments below a checkpoint are recycled, two are kept as spares
+  log_file->Recycle(3 * segment_size);
+  EXPECT_EQ(3 * segment_size, log_file->GetStartOffset());
+  EXPECT_NE(0, stat("test.log.0", &stat_buf));
+  EXPECT_EQ(0, stat("test.log.spare.0", &stat_buf));
+  EXPECT_NE(0, stat("test.log.spare.2", &stat_buf));
+  // and renamed into place when the log grows
+  for (int i = 0; i < 8; i++) {
+    EXPECT_TRUE(log_file->Append(data, sizeof(data)));
+  }
+  EXPECT_LE(1, log_file->GetNumSegmentsReused());
+  delete log_file;
+
+  SegmentedLogFile::Remove("test.log");
+  EXPECT_NE(0, stat("test.log.3", &stat_buf));
+}
+
+TEST(DiskManagerTest, LogWriteFailureTest) {
+  const int64_t segment_size = 4096;
+  char data[1000];
+  char buffer[1000];
+  memset(data, 'a', sizeof(data));
+  SegmentedLogFile *log_file = new SegmentedLogFile("test.log", segment_size);
+  log_file->Open(true);
+  for (int i = 0; i < 8; i++) {
+    EXPECT_TRUE(log_file->Append(data, sizeof(data)));
+  }
+  // the third segment can't be created, the append fails half written
+  ASSERT_EQ(0, mkdir("test.log.2", 0755));
+  memset(data, 'b', sizeof(data));
+  EXPECT_FALSE(log_file->Append(data, sizeof(data)));
+  EXPECT_FALSE(log_file->Append(data, sizeof(data)));
+  // and leaves the end where it was, a retry writes the same bytes again
+  EXPECT_EQ(8000, log_file->GetEndOffset());
+  ASSERT_EQ(0, rmdir("test.log.2"));
+  memset(data, 'c', sizeof(data));
+  EXPECT_TRUE(log_file->Append(data, sizeof(data)));
+  EXPECT_EQ(9000, log_file->GetEndOffset());
+  EXPECT_TRUE(log_file->Read(buffer, sizeof(buffer), 8000));
+  EXPECT_EQ('c', buffer[0]);
+  EXPECT_EQ('c', buffer[999]);
+  delete log_file;
+  SegmentedLogFile::Remove("test.log");
+
+  // nothing is acknowledged as durable when it can't be written
+  DiskManager *disk_manager =
+      new DiskManager("test.db", DurabilityLevel::FULL, true);
+  EXPECT_FALSE(disk_manager->WriteLog(data, sizeof(data)));
+  EXPECT_TRUE(disk_manager->WriteLog(data, 0));
+  delete disk_manager;
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+}
+
+// commit latency benchmark, compare the trade-off of each durability level
+TEST(DiskManagerTest, DISABLED_CommitLatencyBenchmark) {
+  const int num_threads = 8, num_commits = 100;
+  const char *names[] = {"none", "group", "full"};
+  DurabilityLevel levels[] = {DurabilityLevel::NONE, DurabilityLevel::GROUP,
+                              DurabilityLevel::FULL};
+  for (int i = 0; i < 3; i++) {
+    DiskManager *disk_manager = new DiskManager("test.db", levels[i]);
+    double latency = CommitLatency(disk_manager, num_threads, num_commits);
+    printf("durability %-5s: %d commits, %d log syncs, %.1f us/commit\n",
+           names[i], disk_manager->GetNumFlushes(),
+           disk_manager->GetNumLogSyncs(), latency);
+    EXPECT_EQ(num_threads * num_commits, disk_manager->GetNumFlushes());
+    delete disk_manager;
+    remove("test.db");
+    SegmentedLogFile::Remove("test.log");
+  }
+}
+
+} // namespace scudb
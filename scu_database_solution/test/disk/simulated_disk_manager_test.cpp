@@ -0,0 +1,234 @@
+/**
+ * simulated_disk_manager_test.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "disk/simulated_disk_manager.h"
+#include "gtest/gtest.h"
+
+namespace scudb {
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+TEST(SimulatedDiskManagerTest, BackingTest) {
+  for (bool in_memory : {true, false}) {
+    SimulatedDiskOptions options;
+    options.in_memory = in_memory;
+    SimulatedDiskManager *disk_manager =
+        new SimulatedDiskManager("test.db", options);
+    char data[PAGE_SIZE] = "page";
+    char buffer[PAGE_SIZE];
+
+    disk_manager->WritePage(3, data);
+    disk_manager->ReadPage(3, buffer);
+    EXPECT_EQ(0, strcmp(buffer, "page"));
+    // never written pages read as zero
+    disk_manager->ReadPage(4, buffer);
+    EXPECT_EQ(0, buffer[0]);
+
+    std::vector<std::pair<page_id_t, const char *>> pages = {{5, data},
+                                                             {6, data}};
+    disk_manager->WritePages(pages);
+    disk_manager->ReadPage(6, buffer);
+    EXPECT_EQ(0, strcmp(buffer, "page"));
+    EXPECT_EQ(2, disk_manager->GetNumWrites());
+    EXPECT_EQ(3, disk_manager->GetNumReads());
+    // only the file backing issues real writes
+    EXPECT_EQ(in_memory ? 0 : 2, disk_manager->GetNumPageWrites());
+
+    delete disk_manager;
+    remove("test.db");
+    SegmentedLogFile::Remove("test.log");
+  }
+}
+
+TEST(SimulatedDiskManagerTest, LatencyTest) {
+  SimulatedDiskOptions options;
+  options.read_latency.mean_us = 1000;
+  options.write_latency.type = LatencyDistribution::Type::UNIFORM;
+  options.write_latency.mean_us = 500;
+  options.write_latency.spread_us = 100;
+  SimulatedDiskManager *disk_manager =
+      new SimulatedDiskManager("test.db", options);
+  char buffer[PAGE_SIZE] = {0};
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 5; i++) {
+    disk_manager->ReadPage(i, buffer);
+  }
+  EXPECT_GE(ElapsedMs(start), 5.0);
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 5; i++) {
+    disk_manager->WritePage(i, buffer);
+  }
+  EXPECT_GE(ElapsedMs(start), 2.0);
+  EXPECT_GE(disk_manager->GetTotalDelayUs(), 7000);
+
+  delete disk_manager;
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+}
+
+TEST(SimulatedDiskManagerTest, BandwidthAndQueueDepthTest) {
+  SimulatedDiskOptions options;
+  // one page per millisecond
+  options.write_bandwidth = PAGE_SIZE * 1000;
+  options.read_latency.mean_us = 2000;
+  options.queue_depth = 2;
+  SimulatedDiskManager *disk_manager =
+      new SimulatedDiskManager("test.db", options);
+
+  // concurrent writers share the bandwidth
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < 4; tid++) {
+    threads.push_back(std::thread([disk_manager, tid] {
+      char data[PAGE_SIZE] = {0};
+      for (int i = 0; i < 5; i++) {
+        disk_manager->WritePage(tid * 5 + i, data);
+      }
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_GE(ElapsedMs(start), 20.0);
+
+  // at most two reads are served at once: 8 reads take 4 rounds
+  threads.clear();
+  start = std::chrono::steady_clock::now();
+  for (int tid = 0; tid < 8; tid++) {
+    threads.push_back(std::thread([disk_manager, tid] {
+      char buffer[PAGE_SIZE];
+      disk_manager->ReadPage(tid, buffer);
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_GE(ElapsedMs(start), 8.0);
+  EXPECT_LE(disk_manager->GetMaxQueueDepth(), 2);
+
+  delete disk_manager;
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+}
+
+TEST(SimulatedDiskManagerTest, FaultInjectionTest) {
+  SimulatedDiskOptions options;
+  options.write_error_rate = 1;
+  SimulatedDiskManager *disk_manager =
+      new SimulatedDiskManager("test.db", options);
+  char data[PAGE_SIZE];
+  char buffer[PAGE_SIZE];
+  memset(data, 'x', PAGE_SIZE);
+
+  // every write is lost
+  disk_manager->WritePage(0, data);
+  disk_manager->ReadPage(0, buffer);
+  EXPECT_EQ(0, buffer[0]);
+  EXPECT_EQ(1, disk_manager->GetNumIOErrors());
+  // a page whose write back failed stays dirty and is written again
+  BufferPoolManager *bpm = new BufferPoolManager(4, disk_manager);
+  page_id_t page_id;
+  bpm->NewPage(page_id);
+  bpm->UnpinPage(page_id, true);
+  bpm->FlushAllPages();
+  bpm->FlushAllPages();
+  EXPECT_EQ(3, disk_manager->GetNumWrites());
+  EXPECT_EQ(3, disk_manager->GetNumIOErrors());
+  delete bpm;
+  delete disk_manager;
+
+  // every read is short, the tail of the page is zeroed
+  options.write_error_rate = 0;
+  options.short_read_rate = 1;
+  disk_manager = new SimulatedDiskManager("test.db", options);
+  disk_manager->WritePage(0, data);
+  disk_manager->ReadPage(0, buffer);
+  EXPECT_EQ(1, disk_manager->GetNumShortReads());
+  EXPECT_EQ(0, buffer[PAGE_SIZE - 1]);
+  delete disk_manager;
+
+  // the same seed reproduces the same faults
+  options.short_read_rate = 0;
+  options.read_error_rate = 0.5;
+  options.seed = 15445;
+  std::vector<int> errors;
+  for (int round = 0; round < 2; round++) {
+    disk_manager = new SimulatedDiskManager("test.db", options);
+    disk_manager->WritePage(0, data);
+    int pattern = 0;
+    for (int i = 0; i < 20; i++) {
+      disk_manager->ReadPage(0, buffer);
+      pattern = pattern * 2 + (buffer[0] == 0);
+    }
+    EXPECT_EQ(pattern > 0, disk_manager->GetNumIOErrors() > 0);
+    errors.push_back(pattern);
+    delete disk_manager;
+  }
+  EXPECT_EQ(errors[0], errors[1]);
+
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+}
+
+// random page accesses through a small buffer pool on a slow, jittery disk
+TEST(SimulatedDiskManagerTest, DISABLED_BufferPoolBenchmark) {
+  SimulatedDiskOptions options;
+  options.read_latency.type = LatencyDistribution::Type::EXPONENTIAL;
+  options.read_latency.mean_us = 100;
+  options.read_latency.tail_probability = 0.01;
+  options.read_latency.tail_us = 5000;
+  options.write_latency.mean_us = 200;
+  options.queue_depth = 4;
+  options.seed = 1;
+  SimulatedDiskManager *disk_manager =
+      new SimulatedDiskManager("test.db", options);
+  BufferPoolManager *bpm = new BufferPoolManager(10, disk_manager);
+
+  page_id_t page_id;
+  for (int i = 0; i < 50; i++) {
+    ASSERT_NE(nullptr, bpm->NewPage(page_id));
+    snprintf(bpm->FetchPage(page_id)->GetData(), PAGE_SIZE, "%d", page_id);
+    bpm->UnpinPage(page_id, true);
+    bpm->UnpinPage(page_id, true);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::mt19937 rng(1);
+  const int num_fetches = 500;
+  char expected[PAGE_SIZE];
+  for (int i = 0; i < num_fetches; i++) {
+    page_id = std::uniform_int_distribution<int>(0, 49)(rng);
+    Page *page = bpm->FetchPage(page_id);
+    ASSERT_NE(nullptr, page);
+    snprintf(expected, PAGE_SIZE, "%d", page_id);
+    EXPECT_EQ(0, strcmp(page->GetData(), expected));
+    bpm->UnpinPage(page_id, false);
+  }
+  double elapsed = ElapsedMs(start);
+  printf("%d fetches: %d reads, %d writes, %.1f ms, %.1f us/fetch\n",
+         num_fetches, disk_manager->GetNumReads(),
+         disk_manager->GetNumWrites(), elapsed,
+         elapsed * 1000 / num_fetches);
+
+  delete bpm;
+  delete disk_manager;
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+}
+
+} // namespace scudb
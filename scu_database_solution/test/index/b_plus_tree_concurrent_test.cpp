@@ -8,6 +8,7 @@
 #include <functional>
 #include <iostream>
 #include <thread>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "common/logger.h"
@@ -348,4 +349,171 @@ TEST(BPlusTreeConcurrentTest, MixTest) {
   remove("test.log");
 }
 
+// helper function to look keys up, every one of them must be found
+void LookupHelper(BPlusTree<GenericKey<8>, RID, GenericComparator<8>> &tree,
+                  const std::vector<int64_t> &keys, int rounds,
+                  __attribute__((unused)) uint64_t thread_itr = 0) {
+  GenericKey<8> index_key;
+  std::vector<RID> rids;
+  for (int round = 0; round < rounds; round++) {
+    for (auto key : keys) {
+      rids.clear();
+      index_key.SetFromInteger(key);
+      EXPECT_TRUE(tree.GetValue(index_key, rids));
+      EXPECT_EQ(1, rids.size());
+      EXPECT_EQ(key & 0xFFFFFFFF, rids[0].GetSlotNum());
+    }
+  }
+}
+
+// lookups descend optimistically while inserts split pages under them
+TEST(BPlusTreeConcurrentTest, OptimisticReadTest) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                           comparator);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(page_id);
+  (void)header_page;
+  std::vector<int64_t> keys, new_keys;
+  for (int64_t key = 1; key <= 1000; key++)
+    keys.push_back(key);
+  for (int64_t key = 1001; key <= 5000; key++)
+    new_keys.push_back(key);
+  InsertHelper(tree, keys);
+
+  std::thread readers([&] {
+    LaunchParallelTest(2, LookupHelper, std::ref(tree), keys, 5);
+  });
+  LaunchParallelTest(2, InsertHelperSplit, std::ref(tree), new_keys, 2);
+  readers.join();
+  LookupHelper(tree, new_keys, 1);
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+// read-only lookups with a growing number of threads
+TEST(BPlusTreeConcurrentTest, DISABLED_LookupBenchmark) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                           comparator);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(page_id);
+  (void)header_page;
+  std::vector<int64_t> keys;
+  for (int64_t key = 1; key <= 10000; key++)
+    keys.push_back(key);
+  InsertHelper(tree, keys);
+
+  for (int num_threads = 1; num_threads <= 4; num_threads *= 2) {
+    auto start = std::chrono::steady_clock::now();
+    LaunchParallelTest(num_threads, LookupHelper, std::ref(tree), keys, 3);
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    printf("%d threads: %.0f lookups/s\n", num_threads,
+           num_threads * keys.size() * 3 / seconds);
+  }
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+// splits in B-link mode latch one level at a time, lookups and scans follow
+// the right links
+TEST(BPlusTreeConcurrentTest, BLinkTest) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                           comparator);
+  EXPECT_TRUE(tree.SetBLinkMode(true));
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(page_id);
+  (void)header_page;
+  std::vector<int64_t> keys, new_keys, remove_keys;
+  for (int64_t key = 1; key <= 1000; key++)
+    keys.push_back(key);
+  for (int64_t key = 1001; key <= 20000; key++) {
+    new_keys.push_back(key);
+    if (key % 2 == 1)
+      remove_keys.push_back(key);
+  }
+  InsertHelper(tree, keys);
+  EXPECT_FALSE(tree.SetBLinkMode(false));
+
+  std::thread readers([&] {
+    LaunchParallelTest(2, LookupHelper, std::ref(tree), keys, 5);
+  });
+  LaunchParallelTest(4, InsertHelperSplit, std::ref(tree), new_keys, 4);
+  readers.join();
+  LookupHelper(tree, new_keys, 1);
+
+  LaunchParallelTest(2, DeleteHelperSplit, std::ref(tree), remove_keys, 2);
+  int64_t current_key = 1;
+  for (auto iterator = tree.Begin(); !iterator.isEnd(); ++iterator) {
+    EXPECT_EQ(current_key, (*iterator).second.GetSlotNum());
+    current_key += current_key < 1000 ? 1 : 2;
+  }
+  EXPECT_EQ(20002, current_key);
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+// concurrent inserts with latch crabbing and in B-link mode
+TEST(BPlusTreeConcurrentTest, DISABLED_BLinkInsertBenchmark) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  std::vector<int64_t> keys;
+  for (int64_t key = 1; key <= 20000; key++)
+    keys.push_back(key);
+  std::random_shuffle(keys.begin(), keys.end());
+
+  for (int blink = 0; blink < 2; blink++) {
+    DiskManager *disk_manager = new DiskManager("test.db");
+    BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+    EXPECT_TRUE(tree.SetBLinkMode(blink));
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+
+    auto start = std::chrono::steady_clock::now();
+    LaunchParallelTest(4, InsertHelperSplit, std::ref(tree), keys, 4);
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    printf("%s: %.0f inserts/s with 4 threads\n",
+           blink ? "B-link" : "latch crabbing", keys.size() / seconds);
+    LookupHelper(tree, keys, 1);
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete disk_manager;
+    delete bpm;
+    remove("test.db");
+    remove("test.log");
+  }
+}
+
 } // namespace scudb
@@ -0,0 +1,121 @@
+/**
+ * log_reader_test.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "logging/log_manager.h"
+#include "logging/log_reader.h"
+#include "gtest/gtest.h"
+
+namespace scudb {
+
+// append records of many sizes, returns their lsns
+static std::vector<lsn_t> AppendRecords(LogManager *log_manager, int count) {
+  std::vector<lsn_t> lsns;
+  for (int i = 0; i < count; i++) {
+    if (i % 10 == 0) {
+      // checkpoints of up to a few hundred bytes
+      std::vector<std::pair<page_id_t, lsn_t>> dirty_pages(i % 37);
+      LogRecord log_record(INVALID_LSN, i, {}, dirty_pages);
+      lsns.push_back(log_manager->AppendLogRecord(log_record));
+    } else {
+      LogRecord log_record(i, INVALID_LSN, LogRecordType::NEWPAGE,
+                           i << (i % 20), i);
+      lsns.push_back(log_manager->AppendLogRecord(log_record));
+    }
+  }
+  return lsns;
+}
+
+// every record in order, from offset
+static std::vector<lsn_t> ReadRecords(DiskManager *disk_manager,
+                                      int64_t offset, int chunk_size) {
+  std::vector<lsn_t> lsns;
+  LogReader log_reader(disk_manager, offset, chunk_size);
+  const char *record;
+  while (log_reader.Next(record, offset)) {
+    lsns.push_back(*reinterpret_cast<const lsn_t *>(record + sizeof(int32_t)));
+  }
+  return lsns;
+}
+
+TEST(LogReaderTest, StraddleTest) {
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+  DiskManager *disk_manager = new DiskManager("test.db");
+  LogManager *log_manager = new LogManager(disk_manager);
+  log_manager->RunFlushThread();
+  std::vector<lsn_t> lsns = AppendRecords(log_manager, 50000);
+  log_manager->StopFlushThread();
+  delete log_manager;
+  delete disk_manager;
+
+  // after a restart the log goes on in a fresh segment
+  disk_manager = new DiskManager("test.db");
+  log_manager = new LogManager(disk_manager);
+  log_manager->SetNextLSN(lsns.back() + 1);
+  log_manager->RunFlushThread();
+  std::vector<lsn_t> more = AppendRecords(log_manager, 1000);
+  lsns.insert(lsns.end(), more.begin(), more.end());
+  log_manager->StopFlushThread();
+  EXPECT_LT(LOG_SEGMENT_SIZE, disk_manager->GetLogEndOffset());
+
+  // small chunks split many records, and even their sizes
+  for (int chunk_size : {LOG_BUFFER_SIZE, LOG_BUFFER_SIZE + 3, 1 << 16,
+                         LOG_READ_CHUNK_SIZE}) {
+    EXPECT_EQ(lsns, ReadRecords(disk_manager, 0, chunk_size));
+  }
+
+  // start in the middle of the log, at the offset of a record
+  LogReader log_reader(disk_manager, 0, LOG_BUFFER_SIZE);
+  const char *record;
+  int64_t offset = 0;
+  for (int i = 0; i <= 1234; i++) {
+    ASSERT_TRUE(log_reader.Next(record, offset));
+  }
+  std::vector<lsn_t> tail = ReadRecords(disk_manager, offset, 1 << 16);
+  EXPECT_EQ(std::vector<lsn_t>(lsns.begin() + 1234, lsns.end()), tail);
+
+  // nothing beyond the end of the log
+  EXPECT_TRUE(ReadRecords(disk_manager, disk_manager->GetLogEndOffset(),
+                          LOG_BUFFER_SIZE)
+                  .empty());
+
+  delete log_manager;
+  delete disk_manager;
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+}
+
+TEST(LogReaderTest, DISABLED_ScanBenchmark) {
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+  DiskManager *disk_manager = new DiskManager("test.db");
+  LogManager *log_manager = new LogManager(disk_manager);
+  log_manager->RunFlushThread();
+  AppendRecords(log_manager, 400000);
+  log_manager->StopFlushThread();
+
+  // record by record reads against streamed chunks
+  int64_t end = disk_manager->GetLogEndOffset();
+  for (int chunk_size : {LOG_BUFFER_SIZE, LOG_READ_CHUNK_SIZE}) {
+    auto start = std::chrono::steady_clock::now();
+    size_t count = ReadRecords(disk_manager, 0, chunk_size).size();
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    printf("%d byte chunks: %zu records, %.1f MB/s\n", chunk_size, count,
+           end / seconds / (1 << 20));
+    EXPECT_EQ(400000u, count);
+  }
+
+  delete log_manager;
+  delete disk_manager;
+  remove("test.db");
+  SegmentedLogFile::Remove("test.log");
+}
+
+} // namespace scudb